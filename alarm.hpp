@@ -0,0 +1,151 @@
+// ----------------------------------------------------------------------------
+
+#ifndef ALARM_HPP
+#define ALARM_HPP
+
+#include <stdint.h>
+// ----------------------------------------------------------------------------
+
+/// @brief Threshold alarm of one channel with hysteresis and debounce
+///
+/// Raised when the value stays above `high` (or below `low`) for `debounce`
+/// consecutive samples, cleared when it stays `hysteresis` counts back
+/// inside the limits for as many samples.
+class Threshold {
+public:
+	enum class State: uint8_t {
+		Normal,
+		High,
+		Low
+	};
+
+	enum class Event: uint8_t {
+		None,
+		High,
+		Low,
+		Clear
+	};
+
+	Threshold():
+		high(UINT16_MAX),
+		low(0),
+		hysteresis(0),
+		debounce(1),
+		enabled(false),
+		_state(State::Normal),
+		_pending(State::Normal),
+		_count(0)				{
+	}
+
+	void
+	reset()						{
+		_state		= State::Normal;
+		_pending	= State::Normal;
+		_count		= 0;
+	}
+
+	State
+	state() const				{ return _state; }
+
+	Event
+	update(uint16_t x) {
+		if ( !enabled )	return Event::None;
+
+		State
+		next	= _state;
+		switch ( _state ) {
+		case State::Normal:
+			if ( x > high )			next	= State::High;
+			else if ( x < low )		next	= State::Low;
+			break;
+		case State::High:
+			if ( uint32_t(x) + hysteresis < high )	next = State::Normal;
+			break;
+		case State::Low:
+			if ( x > uint32_t(low) + hysteresis )	next = State::Normal;
+			break;
+		}
+
+		if ( next == _state ) {
+			_count	= 0;
+			return Event::None;
+		}
+		if ( next != _pending ) {						// new candidate, restart debounce
+			_pending	= next;
+			_count		= 0;
+		}
+		if ( ++_count < debounce )	return Event::None;
+
+		_state		= next;
+		_count		= 0;
+		switch ( next ) {
+		case State::High:	return Event::High;
+		case State::Low:	return Event::Low;
+		default:			return Event::Clear;
+		}
+	}
+
+	uint16_t		high;						// raise above
+	uint16_t		low;						// raise below
+	uint16_t		hysteresis;					// counts back inside to clear
+	uint8_t			debounce;					// consecutive samples to change state
+	bool			enabled;
+
+private:
+	State			_state;
+	State			_pending;
+	uint8_t			_count;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Threshold alarms of all channels of one sensor
+template < uint8_t Channels >
+class Alarms {
+public:
+	Alarms()					{
+		for (uint8_t i = 0; i < Channels; ++i)	last[i] = 0;
+	}
+
+	/// @brief evaluate a sample, fn(channel, event) is called for every event
+	template < typename Fn >
+	void
+	update(const uint16_t (&x)[Channels], Fn&& fn) {
+		for (uint8_t i = 0; i < Channels; ++i) {
+			last[i]	= x[i];
+			const Threshold::Event
+			e		= ch[i].update(x[i]);
+			if ( e != Threshold::Event::None )	fn(i, e);
+		}
+	}
+
+	bool
+	active() const				{
+		for (uint8_t i = 0; i < Channels; ++i)
+			if ( ch[i].state() != Threshold::State::Normal )	return true;
+		return false;
+	}
+
+	Threshold		ch[Channels];
+	uint16_t		last[Channels];				// latest sample (for heartbeats)
+};
+// ----------------------------------------------------------------------------
+
+/// @brief What the sensor threads print
+struct Reporting {
+	enum class Mode: uint8_t {
+		Stream,									// every sample
+		Events									// alarm events and heartbeats only
+	};
+
+	Mode			mode		= Mode::Stream;
+	uint16_t		heartbeat	= 60;			// seconds, 0 = off
+	bool			binary		= false;		// binary transfer running, no text at all
+	bool			normalised	= false;		// samples in the common unit (scale.hpp)
+	uint8_t			fields		= 0x03;			// of the RGBW output, counts|hue (derived::DEFAULT)
+
+	bool
+	streaming() const			{ return mode == Mode::Stream && !binary; }
+};
+// ----------------------------------------------------------------------------
+
+#endif	// ALARM_HPP
@@ -0,0 +1,155 @@
+// ----------------------------------------------------------------------------
+
+#ifndef BASELINE_HPP
+#define BASELINE_HPP
+
+#include <stdint.h>
+// ----------------------------------------------------------------------------
+
+/// @brief Dark and blank baselines of a sensor, one pair per setting
+///
+/// A capture averages the next n readings of the current setting (the
+/// integration time, and the gain of the TCS3472) into its dark (no light)
+/// or blank (reference cuvette) counts. Every reading then has the dark of
+/// its setting subtracted in place, clipped at 0, before it is published;
+/// the blank is kept raw and handed out dark-corrected, it is the I0 the
+/// absorbance is taken against, not subtracted: a reading below it is what
+/// the analyte absorbs.
+///
+/// The baselines of every setting are kept, switching back to one does not
+/// need a new capture. A capture follows a change of the setting: it starts
+/// over with the new one. Integers only, a reading costs a compare and a
+/// subtraction per channel, the sums of a capture fit 32 bits.
+template < uint8_t Channels, uint8_t Settings >
+class Baselines {
+public:
+	enum class Kind: uint8_t {
+		Dark,
+		Blank
+	};
+
+	enum : uint16_t {
+		SAMPLES		= 16,							// default readings per capture
+		MAX_SAMPLES	= 4096
+	};
+
+	static_assert(static_cast<uint64_t>(UINT16_MAX) * MAX_SAMPLES <= UINT32_MAX, "sums fit 32 bits");
+
+public:
+
+	Baselines():
+		_setting(0),
+		_samples(0),
+		_pending(0),
+		_kind(Kind::Dark)		{
+		for (uint8_t s = 0; s < Settings; ++s)	clear(s);
+	}
+
+	/// @brief the setting the next readings are taken with (on configure)
+	/// @return true if it changed
+	bool
+	select(uint8_t setting)		{
+		if ( setting >= Settings || setting == _setting )	return false;
+		_setting	= setting;
+		if ( _pending )			start(_kind, _samples);
+		return true;
+	}
+
+	uint8_t
+	setting() const				{ return _setting; }
+
+	/// @brief average the next n readings into a baseline of the setting
+	bool
+	start(Kind kind, uint16_t n) {
+		if ( n == 0 || n > MAX_SAMPLES )	return false;
+		_kind		= kind;
+		_samples	= n;
+		_pending	= n;
+		for (uint8_t i = 0; i < Channels; ++i)	_sums[i] = 0;
+		return true;
+	}
+
+	bool
+	capturing() const			{ return _pending != 0; }
+
+	Kind
+	kind() const				{ return _kind; }
+
+	/// @brief forget the baselines of a setting
+	void
+	clear(uint8_t setting)		{
+		Baseline&
+		b		= _baselines[setting];
+		b.dark	= false;
+		b.blank	= false;
+		for (uint8_t i = 0; i < Channels; ++i) {
+			b.darks[i]	= 0;
+			b.blanks[i]	= 0;
+		}
+	}
+
+	/// @brief one reading of the setting, in place: taken into a capture,
+	/// then the dark is subtracted
+	/// @return true if it completed a capture
+	bool
+	process(uint16_t (&ch)[Channels]) {
+		Baseline&
+		b		= _baselines[_setting];
+		bool
+		done	= false;
+		if ( _pending ) {
+			for (uint8_t i = 0; i < Channels; ++i)	_sums[i] += ch[i];
+			if ( --_pending == 0 ) {
+				uint16_t*
+				to		= ( _kind == Kind::Dark ) ? b.darks : b.blanks;
+				for (uint8_t i = 0; i < Channels; ++i)
+					to[i]	= static_cast<uint16_t>(( _sums[i] + _samples / 2 ) / _samples);
+				if ( _kind == Kind::Dark )	b.dark	= true;
+				else						b.blank	= true;
+				done	= true;
+			}
+		}
+		if ( b.dark ) {
+			for (uint8_t i = 0; i < Channels; ++i)
+				ch[i]	= ( ch[i] > b.darks[i] ) ? ch[i] - b.darks[i] : 0;
+		}
+		return done;
+	}
+
+	bool
+	hasDark(uint8_t setting) const	{ return _baselines[setting].dark; }
+
+	bool
+	hasBlank(uint8_t setting) const	{ return _baselines[setting].blank; }
+
+	uint16_t
+	dark(uint8_t setting, uint8_t i) const	{ return _baselines[setting].darks[i]; }
+
+	/// @brief blank of a channel less the dark of its setting, at least 1
+	uint16_t
+	blank(uint8_t setting, uint8_t i) const	{
+		const Baseline&
+		b		= _baselines[setting];
+		const uint16_t
+		d		= b.dark ? b.darks[i] : 0;
+		return ( b.blanks[i] > d ) ? b.blanks[i] - d : 1;
+	}
+
+private:
+	struct Baseline {
+		uint16_t		darks[Channels];
+		uint16_t		blanks[Channels];			// raw
+		bool			dark;
+		bool			blank;
+	};
+
+	Baseline		_baselines[Settings];
+	uint32_t		_sums[Channels];
+	uint8_t			_setting;
+	uint16_t		_samples;
+	uint16_t		_pending;						// readings left of the capture
+	Kind			_kind;
+};
+// ----------------------------------------------------------------------------
+
+#endif	// BASELINE_HPP
@@ -0,0 +1,140 @@
+// ----------------------------------------------------------------------------
+
+#ifndef BUS_HPP
+#define BUS_HPP
+
+#include <stdint.h>
+
+#include <atomic>
+// ----------------------------------------------------------------------------
+
+/// @brief Single-publisher channel of samples with any number of readers
+///
+/// The publisher fills a slot of a fixed pool in place (claim(), then
+/// publish()), readers get a reference to it (read()) and confirm it with
+/// release(): nothing is copied and nothing is allocated. Messages are
+/// numbered from 1 and a Reader is only the number of the next message it
+/// wants, so consumers are independent of each other and of the publisher.
+///
+/// The publisher never waits. A reader that falls more than `Slots`
+/// messages behind loses the oldest ones, they are counted. Every slot has
+/// a sequence word (odd while written, 2 * number once published) that
+/// release() checks again, so a message overwritten while in use is
+/// reported instead of silently used. Between protothreads this can only
+/// happen if the reader yields before release(); on the host the same
+/// code works with publisher and readers in different threads (seqlock).
+template < typename T, uint8_t Slots >
+class Channel {
+	static_assert(Slots && !(Slots & (Slots - 1)), "Slots must be a power of 2");
+
+public:
+	class Reader {
+	public:
+		/// messages skipped because they were overwritten
+		uint32_t
+		lost() const				{ return _lost; }
+
+		/// number of the next message to read
+		uint32_t
+		next() const				{ return _next; }
+
+	private:
+		friend class Channel;
+
+		uint32_t		_next		= 1;
+		uint32_t		_lost		= 0;
+	};
+
+	Channel():
+		_published(0)			{
+		for (uint8_t i = 0; i < Slots; ++i)
+			_slots[i].seq.store(0, std::memory_order_relaxed);
+	}
+
+	/// @brief slot of the next message, fill it and publish()
+	T&
+	claim() {
+		const uint32_t
+		n		= _published.load(std::memory_order_relaxed) + 1;
+		Slot&
+		s		= _slots[n % Slots];
+		s.seq.store(2 * n - 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		return s.value;
+	}
+
+	void
+	publish() {
+		const uint32_t
+		n		= _published.load(std::memory_order_relaxed) + 1;
+		_slots[n % Slots].seq.store(2 * n, std::memory_order_release);
+		_published.store(n, std::memory_order_release);
+	}
+
+	/// number of the last published message
+	uint32_t
+	published() const			{ return _published.load(std::memory_order_acquire); }
+
+	/// @brief start a reader at the next message (default: the first one)
+	void
+	subscribe(Reader& r) const	{ r._next = published() + 1; }
+
+	/// @return the next message of the reader or nullptr, valid until release()
+	const T*
+	read(Reader& r) const {
+		const uint32_t
+		head	= published();
+		while ( r._next <= head ) {
+			if ( head - r._next >= Slots ) {			// already overwritten
+				r._lost	+= head - r._next - Slots + 1;
+				r._next	= head - Slots + 1;
+			}
+			const Slot&
+			s		= _slots[r._next % Slots];
+			if ( s.seq.load(std::memory_order_acquire) == 2 * r._next )
+				return &s.value;
+			++r._lost;									// overwritten meanwhile
+			++r._next;
+		}
+		return nullptr;
+	}
+
+	/// @brief done with the message of the last read()
+	/// @return false if it was overwritten while it was used
+	bool
+	release(Reader& r) const {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const bool
+		ok		= ( _slots[r._next % Slots].seq.load(std::memory_order_relaxed) == 2 * r._next );
+		if ( !ok )	++r._lost;
+		++r._next;
+		return ok;
+	}
+
+	/// @brief fn(message) for every message the reader has not seen yet
+	/// @return number of messages
+	template < typename Fn >
+	uint8_t
+	consume(Reader& r, Fn&& fn) const {
+		uint8_t
+		n		= 0;
+		while ( const T* m = read(r) ) {
+			fn(*m);
+			release(r);
+			++n;
+		}
+		return n;
+	}
+
+private:
+	struct Slot {
+		std::atomic<uint32_t>	seq;
+		T						value;
+	};
+
+	Slot					_slots[Slots];
+	std::atomic<uint32_t>	_published;
+};
+// ----------------------------------------------------------------------------
+
+#endif	// BUS_HPP
@@ -4,7 +4,23 @@
 
 #include <modm/debug.hpp>
 
+#include <memory.hpp>
+#include <static_string.hpp>
+#include <trace.hpp>
+#if !HEAP_FREE
+#include <string>
+#endif
+
 using namespace Board;
+
+// input line and option values: in place (heap-free build) or std::string
+#if HEAP_FREE
+template < uint8_t N >
+using CliString	= StaticString<N>;
+#else
+template < uint8_t N >
+using CliString	= std::string;
+#endif
 // ----------------------------------------------------------------------------
 
 /// @brief simple CLI class
@@ -12,8 +28,26 @@ class Cli {
 	friend class Tcs;
 	friend class V6040;
 	friend class V6070;
+	friend class Unmix;
+	friend class Stats;
+	friend class Alarm;
+	friend class Report;
+	friend class Dump;
+	friend class Mem;
+	friend class Rate;
+	friend class Loop;
+	friend class Trace;
+	friend class Power;
+	friend class Script;
+	friend class Kalman;
 
 	enum { CMD_LINE_LENGTH = 80, CMD_MAX_ARGC = 10 };
+	// QUEUE_LENGTH: power of 2, entries are indexed by uint16_t sequence numbers
+	enum { QUEUE_LENGTH = 4, MAX_SUBSCRIBERS = 8 };
+	// option values, lists (--curve, --absorptivity) take a whole line
+	enum { OPTION_LENGTH = 15 };
+	// input kept aside while a line waits for room in the queue, power of 2
+	enum { AHEAD_LENGTH = 128 };
 
 public:
 	enum class Cmd: uint8_t {
@@ -44,31 +78,123 @@ public:
 		_ios(s)					{
 		_control		= 0;
 		_commands.clear();
-		_capacity		= 0;
-		_ctlHasTaken	= false;
-		_lastInputState	= Cmd::None;
+		_capacity		= QUEUE_LENGTH;
+		_tail			= 0;
+		_head			= 0;
+		_parsed			= 0;
+		_subscribers	= 0;
+		_outstanding	= 0;
+		_completed		= 0;
 		_argc			= 0;
 		_argv[0][0]		= '\0';
 	}
 
+	/// @brief register a consumer of the command queue
+	/// @param name	commands with this name (and "all") and Ctrl+C go to it,
+	///				nullptr = the commands nobody else takes
+	/// @return subscriber id for next() and done()
+	uint8_t
+	subscribe(const char* name) {
+		_names[_subscribers]	= name;
+		_cursor[_subscribers]	= _head;
+		return _subscribers++;
+	}
+
+	/// @brief oldest queued entry for a subscriber, its command line is
+	/// parsed for command() and getOptions() until the next call
+	Cmd
+	next(uint8_t subscriber) {
+		if ( _held )	return Cmd::None;
+		const uint8_t
+		bit		= 1 << subscriber;
+		uint16_t&
+		cursor	= _cursor[subscriber];
+		for (; cursor != _head; ++cursor) {
+			Entry&
+			e		= _queue[cursor % _capacity];
+			if ( !( e.pending & bit ) )	continue;	// not addressed to it or done
+
+			_control	= e.control;
+			_injected	= e.injected;
+			if ( e.cmd == Cmd::Command && ( _parsed != cursor || _argc == 0 ) ) {
+				parseCmdLine(e.line);
+				_parsed	= cursor;
+			}
+			return e.cmd;
+		}
+		return Cmd::None;
+	}
+
+	/// @brief the subscriber has finished its current entry; the prompt
+	/// comes back when every queued entry is done by all its subscribers
 	void
-	prompt() const				{ _ios << _prompt; }
+	done(uint8_t subscriber) {
+		const uint8_t
+		bit		= 1 << subscriber;
+		const uint16_t
+		cursor	= _cursor[subscriber];
+		if ( cursor == _head )	return;
+
+		Entry&
+		e		= _queue[cursor % _capacity];
+		if ( !( e.pending & bit ) )	return;
+		TRACE(CliDone, subscriber, cursor);
+		e.pending	&= ~bit;
+		++_cursor[subscriber];
+		--_outstanding;
+		if ( !e.pending )	++_completed;
+		while ( _tail != _head && !_queue[_tail % _capacity].pending )
+			++_tail;
+		if ( _outstanding == 0 && !_prompted && !typedAhead() )	prompt();
+	}
 
-	std::string
-	command() const				{ return std::string(_argv[0]); }
+	/// @brief queue a command line that was not typed (a script step), as
+	/// if it was; its completion alone does not bring the prompt back
+	/// @return false if the queue is full or the line is not a command
+	bool
+	inject(const char* line) {
+		if ( !room(Cmd::Command) )									return false;
+		if ( parseCmdLine(line) != Result::eDone )					return false;
+		push(Cmd::Command, 0, line, true);
+		return true;
+	}
 
-	char
-	control() const				{ return _control; }
+	/// @brief as above for a control (Ctrl+C)
+	bool
+	inject(char control) {
+		if ( !room(Cmd::Control) )									return false;
+		push(Cmd::Control, control, "", true);
+		return true;
+	}
 
+	/// the entry of the last next() was injected
 	bool
-	isDone()					{ return _capacity == 0; }
+	injected() const			{ return _injected; }
 
+	/// @brief while held (a binary dump owns the output) next() hands out
+	/// nothing to any subscriber, input is queued silently meanwhile
 	void
-	done()						{
-		clearCommands();
-		prompt();
+	hold(bool held)				{ _held = held; }
+
+	/// entries completed since start
+	uint32_t
+	completed() const			{ return _completed; }
+
+	void
+	prompt() const {
+		_ios << _prompt;
+		_prompted	= true;
 	}
 
+	StringRef
+	command() const				{ return StringRef(_argv[0]); }
+
+	char
+	control() const				{ return _control; }
+
+	bool
+	isDone()					{ return _outstanding == 0; }
+
 	void
 	usage() {
 		_ios <<
@@ -80,6 +206,13 @@ public:
 				"	Common:\n"
 				"		Ctrl+C | Esc:						stop the polling\n"
 				"		[-r | --restart]:					restart sensor polling\n"
+				"		Period:								sampling period in ms\n"
+				"		Phase:								ms into the period (spreads the sensors) | free\n"
+				"		Power:								on | gated (shut down between samples)\n"
+				"		Zero:								dark | blank: average the next readings into the\n"
+				"											baseline of this setting | off: forget it; the dark\n"
+				"											is subtracted from every reading, the blank is I0\n"
+				"		Samples:							readings averaged by --zero (default 16)\n"
 				"	For TCS:\n"
 				"		Wlong:								set Wlong bit\n"
 				"		Wtime:								set Wtime to W\n"
@@ -87,56 +220,116 @@ public:
 				"		Again:								set Gain  to G\n"
 				"	For VEML6040:\n"
 				"		Atime:								set Atime to A\n"
+				"	stats tcs | v6040 | v6070 | all:\n"
+				"		(none):								print mean/stddev/min/max/count/rate\n"
+				"		Window:								tumbling window of N samples (0 = since reset)\n"
+				"		Reset:								reset the statistics\n"
+				"	alarm tcs | v6040 | v6070 R | G | B | C | W | UV:\n"
+				"		High | Low:							thresholds in counts\n"
+				"		Hyst:								counts back inside to clear\n"
+				"		Debounce:							consecutive samples to change state\n"
+				"		Off:								disable the alarm\n"
+				"	report stream | events:\n"
+				"		Heartbeat:							heartbeat period in s in events mode (0 = off)\n"
+				"		Units:								raw (counts) | norm (counts at the most sensitive setting)\n"
+				"		Fields:								of the RGB output: counts,hue,sat,value (derived ones\n"
+				"											are only computed if output)\n"
+				"	dump tcs | v6040 | v6070:\n"
+				"		(none):								binary delta/varint dump of the sample history\n"
+				"		Clear:								clear the sample history\n"
+				"	rate tcs | v6040 | v6070 | all:\n"
+				"		(none):								print the sampling policy and interval\n"
+				"		Fixed | Adaptive:					fixed period | interval follows the signal\n"
+				"		Min | Max:							bounds of the interval in ms (min >= integration time)\n"
+				"		Slope:								counts/s that halve the interval (0 = off)\n"
+				"		Noise:								standard deviation that halves it (0 = off)\n"
+				"		Hold:								quiet samples before it grows by 1/4\n"
+				"	mem:\n"
+				"		(none):								static RAM and heap use/peak per subsystem\n"
+				"		Reset:								reset the heap peaks and counts\n"
+				"	loop:\n"
+				"		(none):								pass time and wake lateness histograms, overruns\n"
+				"		Budget:								pass time in us that is an overrun (0 = off)\n"
+				"		Late:								ms a task may wake late before it is an overrun\n"
+				"		Reset:								reset the histograms and overruns\n"
+				"	power:\n"
+				"		(none):								power mode, duty cycle and register writes per sensor\n"
+				"		Reset:								restart the duty cycle measurement\n"
+				"	script [add <line> | clear | run | stop | save [boot]]:\n"
+				"		(none):								list the script and its state\n"
+				"		add:								append a line: tcs | v6040 | v6070 | all <options>,\n"
+				"											wait <ms>, repeat <n> (0 = forever) ... end, mark <n>, halt\n"
+				"		run | stop:							start | stop the script (Ctrl+C stops it too)\n"
+				"		save [boot]:						keep it over a reset [and run it after one]\n"
+				"	trace [dump | clear]:\n"
+				"		(none):								events recorded, kept and dropped\n"
+				"		dump:								binary dump of the event trace (tools/tracedecode)\n"
+				"		clear:								clear the event trace\n"
+				"	unmix (UV + RGB unmixing of several analytes):\n"
+				"		Analytes:							number of analytes N (1..3)\n"
+				"		Source:								tcs | v6040 (R/G/B/C channels)\n"
+				"		Blank:								take next feature vector as blank\n"
+				"		Standard --conc C:					next vector is analyte J at C\n"
+				"		Standard --absorptivity E:			set absorptivities of analyte J\n"
+				"		On | Off:							start | stop unmixing output\n"
+				"	kalman (concentration tracking of the analytes, UV curve and unmix):\n"
+				"		(none):								print the estimates, their deviation and the noise\n"
+				"		Analyte:							J the options apply to (default all)\n"
+				"		Process:							drift of the concentration, standard deviation per s^1/2\n"
+				"		Noise:								standard deviation of a reading | auto (learnt)\n"
+				"		Reset:								forget the estimates\n"
+				"		On | Off:							start | stop filtering and its output\n"
 				"	For VEML6070:\n"
 				"		Atime:								set Atime to A\n"
+				"		Blank:								take next sample as blank (I0)\n"
+				"		Analyte:							select calibration curve N\n"
+				"		Curve:								set curve k0,k1,k2,k3 (c = k0 + k1*A + ...)\n"
+				"		Output:								raw | conc | both\n"
+				"		Ack:								off | 102 | 145 (ACK threshold, gates reads in events mode)\n"
 				"\n";
 		prompt();
 	}
 
+	/// @brief always reads the UART, a full queue must not keep Ctrl+C out:
+	/// a line that finds no room waits for it, what is typed behind it is
+	/// kept aside meanwhile, a control goes in right away
 	Cmd
 	checkInput()		{
-		char	buf[2];
-
-		if ( _ctlHasTaken && _capacity )
-			return	_lastInputState;
+		if ( _waiting ) {
+			if ( !room(Cmd::Command) )	return typeAhead();
+			_waiting	= false;
+			return enter();
+		}
 
+		char	c;
 		while(true) {
-			_ios.get(buf, 2);
-
-			if ( buf[0] )	_ios << buf[0];
+			if ( !nextChar(c) )	return	Cmd::None;
 
-			if ( ( buf[0] == 0 ) ||
-				( buf[0] == modm::IOStream::eof )
-			) {
-				_lastInputState	= Cmd::None;
-				return	Cmd::None;
-			}
-
-			if (( buf[0] != CR ) && ( buf[0] != LF ))
-				_commands += buf[0];
-
-			if ( buf[0] == BackSpace ) {
-				_commands.pop_back();
-				_commands.pop_back();
+			if ( c == BackSpace ) {
+				if ( !_commands.empty() )	_commands.pop_back();
+			} else if (( c != CR ) && ( c != LF )) {
+				_commands += c;
 			}
 
-			if ( ( buf[0] > 0 ) && ( buf[0] < Space ) )
+			if ( ( c > 0 ) && ( c < Space ) )
 				break;
 		}
 
-		if ( isCtrls(_control) ) {
-			_ctlHasTaken	= true;
-			_lastInputState	= Cmd::Control;
+		char	ctl;
+		if ( isCtrls(ctl) ) {
+			if ( !room(Cmd::Control) ) {				// one is queued already
+				_commands.clear();
+				return	Cmd::None;
+			}
+			push(Cmd::Control, ctl);
 			return	Cmd::Control;
-		} else if (( buf[0] == CR ) || ( buf[0] == LF )) {
-			if ( parseCmdLine(_commands.c_str()) == Result::eDone ) {
-				_ctlHasTaken	= true;
-				_lastInputState	= Cmd::Command;
-				return	Cmd::Command;
+		} else if (( c == CR ) || ( c == LF )) {
+			if ( _commands.empty() ) {
+				if ( isDone() )	prompt();
+			} else if ( !room(Cmd::Command) ) {
+				_waiting	= true;
 			} else {
-				clearCommands();
-				_ios << "\nUnknown command" << modm::endl;
-				usage();
+				return	enter();
 			}
 		}
 
@@ -156,14 +349,127 @@ private:
 	const char Esc		= {0x1B};
 	const char Space	= {0x20};
 
+	/// @brief queued input line
+	struct Entry {
+		Cmd			cmd;
+		char		control;					// Ctrl+C, ... for Cmd::Control
+		uint8_t		pending;					// subscribers that have not done it
+		bool		injected;					// not typed, see inject()
+		char		line[CMD_LINE_LENGTH];
+	};
+
+	/// @brief input is waiting to go into the queue, no prompt yet
+	bool
+	typedAhead() const			{ return _waiting || _aheadHead != _aheadTail; }
+
+	/// @brief the complete line in _commands
+	Cmd
+	enter() {
+		if ( parseCmdLine(_commands.c_str()) == Result::eDone ) {
+			push(Cmd::Command, 0);
+			return	Cmd::Command;
+		}
+		TRACE(CliRejected, 0, _commands.length());
+		clearCommands();
+		if ( !_held ) {
+			_ios << "\nUnknown command" << modm::endl;
+			usage();
+		}
+		return	Cmd::None;
+	}
+
+	/// @brief what was kept aside first, then the UART (echoed)
+	bool
+	nextChar(char& c) {
+		if ( !_waiting && _aheadTail != _aheadHead ) {
+			c	= _ahead[_aheadTail++ % AHEAD_LENGTH];
+			return true;
+		}
+		char	buf[2];
+		_ios.get(buf, 2);
+		if ( buf[0] && !_held )	_ios << buf[0];
+		c	= buf[0];
+		return ( c != 0 ) && ( c != modm::IOStream::eof );
+	}
+
+	/// @brief input while a line waits for room: controls are queued, the
+	/// rest is kept aside (and lost if that overflows)
+	Cmd
+	typeAhead() {
+		char	c;
+		while ( nextChar(c) ) {
+			if ( c > 0 && c < Space && c != CR && c != LF && c != BackSpace ) {
+				if ( !room(Cmd::Control) )	continue;		// one is queued already
+				push(Cmd::Control, c, "", false);
+				return	Cmd::Control;
+			}
+			if ( static_cast<uint8_t>(_aheadHead - _aheadTail) < AHEAD_LENGTH )
+				_ahead[_aheadHead++ % AHEAD_LENGTH]	= c;
+		}
+		return	Cmd::None;
+	}
+
+	/// @brief commands leave the last entry free, a control can always be
+	/// queued behind them
+	bool
+	room(Cmd cmd) const {
+		const uint16_t
+		used	= _head - _tail;
+		return used < ( ( cmd == Cmd::Control ) ? _capacity : _capacity - 1 );
+	}
+
 	void
 	clearCommands()	{
 		_commands.clear();
-		_ctlHasTaken	= false;
 		_argc			= 0;
 		_argv[0][0]		= '\0';
 	}
 
+	/// @brief queue the input line (already parsed into _argv for commands)
+	void
+	push(Cmd cmd, char control) {
+		push(cmd, control, _commands.c_str(), false);
+		_commands.clear();
+	}
+
+	void
+	push(Cmd cmd, char control, const char* line, bool injected) {
+		Entry&
+		e		= _queue[_head % _capacity];
+		e.cmd		= cmd;
+		e.control	= control;
+		e.pending	= 0;
+		e.injected	= injected;
+		const size_t
+		length	= strlen(line),
+		n		= ( length < CMD_LINE_LENGTH ) ? length : CMD_LINE_LENGTH - 1;
+		memcpy(e.line, line, n);
+		e.line[n]	= '\0';
+		if ( !injected )	_prompted = false;
+
+		uint8_t
+		fallback	= 0;
+		for (uint8_t i = 0; i < _subscribers; ++i) {
+			if ( _names[i] == nullptr )
+				fallback	|= 1 << i;
+			else if ( cmd == Cmd::Control || strcmp(_argv[0], "all") == 0 || strcmp(_argv[0], _names[i]) == 0 )
+				e.pending	|= 1 << i;
+		}
+		if ( cmd == Cmd::Command && !e.pending )	e.pending = fallback;
+		for (uint8_t i = 0; i < _subscribers; ++i)
+			if ( e.pending & (1 << i) )	++_outstanding;
+		TRACE(CliQueued, static_cast<uint8_t>(cmd), ( _head & 0xFF ) | ( e.pending << 8 ));
+
+		_parsed		= _head;
+		++_head;
+		if ( !e.pending ) {							// nobody to do it
+			++_completed;
+			while ( _tail != _head && !_queue[_tail % _capacity].pending )
+				++_tail;
+			if ( isDone() && !_prompted )	prompt();
+		}
+	}
+
 	Result
 	parseCmdLine(const char* cmd_line);
 
@@ -181,10 +487,25 @@ private:
 	modm::IOStream& _ios;
 	const char*		_prompt		= "\n/>";	// CLI prompt
 	char			_control;				// CLI control (Ex. Ctrl+C)
-	std::string		_commands;				// CLI command (from terminal)
+	bool			_injected	= false;	// of the entry in _control/_argv
+	mutable bool	_prompted	= false;	// nothing typed since the last prompt
+	bool			_held		= false;	// see hold()
+	bool			_waiting	= false;	// a complete line in _commands, the queue is full
+	char			_ahead[AHEAD_LENGTH];	// typed behind it
+	uint8_t			_aheadHead	= 0;
+	uint8_t			_aheadTail	= 0;
+	CliString<CMD_LINE_LENGTH>
+					_commands;				// CLI command (from terminal)
 	uint8_t			_capacity;				// CLI command queue capacity for threads/processes
-	bool			_ctlHasTaken;			// CLI command has been taken
-	Cmd				_lastInputState;		// CLI input state
+	Entry			_queue[QUEUE_LENGTH];
+	uint16_t		_tail;					// oldest entry not done by all subscribers
+	uint16_t		_head;					// next entry to write
+	uint16_t		_parsed;				// entry in _argv
+	const char*		_names[MAX_SUBSCRIBERS];
+	uint16_t		_cursor[MAX_SUBSCRIBERS];	// next entry to look at, per subscriber
+	uint8_t			_subscribers;
+	uint16_t		_outstanding;			// (entry, subscriber) pairs not done yet
+	uint32_t		_completed;
 	uint8_t		 	_argc;
 	char			_argv[CMD_MAX_ARGC][CMD_LINE_LENGTH];
 };
@@ -302,7 +623,6 @@ Cli::parseCmdLine(const char* cmd_line) {
 // ----------------------------------------------------------------------------
 
 #include <getopt.h>
-#include <map>
 
 char *strlwr(char *str);							// #include don't see strlwr
 
@@ -323,36 +643,51 @@ protected:
 		bool			ferror		= false;
 
 		Cli&			_cli;
-		std::map<std::string, std::string>
-						_messages	= {
-							{"help",	"See usage"},
-							{"invArg",	"Invalid argument"},
-							{"ok",		"Done"}
-						};
+
+		static constexpr const char*	msgHelp		= "See usage";
+		static constexpr const char*	msgInvArg	= "Invalid argument";
+
+		/// @brief option value (optarg or a non-option argument), one
+		/// that does not fit is an invalid argument
+		template < typename S >
+		void
+		take(S& s, const char* arg) {
+			s		= arg;
+			if ( s.length() < strlen(arg) ) {
+				s.clear();								// not applied, not even later
+				ferror	= true;
+			}
+		}
 };
 // ----------------------------------------------------------------------------
 /*__PRETTY_FUNCTION__ */
 
 class Tcs: public CommandBase {
 public:
+	/// its options, also the ones a script line of the command may use (script.hpp)
+	static constexpr struct option	options[] = {
+		{"wtime",		required_argument,	NULL, 'w'},
+		{"atime",		required_argument,	NULL, 'a'},
+		{"again",		required_argument,	NULL, 'g'},
+		{"wlong",		no_argument,		NULL, 'l'},
+		{"period",		required_argument,	NULL, 'P'},
+		{"phase",		required_argument,	NULL, 'F'},
+		{"power",		required_argument,	NULL, 'O'},
+		{"zero",		required_argument,	NULL, 'z'},
+		{"samples",		required_argument,	NULL, 'N'},
+		{"init",		no_argument,		NULL, 'i'},
+		{"ping",		no_argument,		NULL, 'p'},
+		{"restart",		no_argument,		NULL, 'r'},
+		{"verbose",		no_argument,		NULL, 'v'},
+		{"help",		no_argument,		NULL, 'h'},
+		{0,0,0,0}
+	};
+
 	Tcs(Cli&	cli): CommandBase(cli) {}
 
 	void
 	getOptions() override {
 
-		const struct option loptions[] = {
-			{"wtime",		required_argument,	NULL, 'w'},
-			{"atime",		required_argument,	NULL, 'a'},
-			{"again",		required_argument,	NULL, 'g'},
-			{"wlong",		no_argument,		NULL, 'l'},
-			{"init",		no_argument,		NULL, 'i'},
-			{"ping",		no_argument,		NULL, 'p'},
-			{"restart",		no_argument,		NULL, 'r'},
-			{"verbose",		no_argument,		NULL, 'v'},
-			{"help",		no_argument,		NULL, 'h'},
-			{0,0,0,0}
-		};
-
 		int opt;
 		opterr				= 0;
 		optarg				= nullptr;
@@ -363,25 +698,50 @@ public:
 
 		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
 		av					= p;
+
+		ferror				= false;
+		fhelp				= false;
+
+		// one-shot: the period/phase are not set again by the next command
+		speriod.clear();
+		sphase.clear();
+		spower.clear();
+		szero.clear();
+		ssamples.clear();
 																		/* Debug msg {
 		_cli._ios << "argc: " << _cli._argc << " argv: ";
 		for(uint8_t i=0; i<_cli._argc; i++) _cli._ios << av[i] << " ";
 		_cli._ios << "end of argv\n";									}*/
 
-		while ( (opt = getopt_long(_cli._argc, av, "w:a:g:liprvh", loptions, NULL)) != -1 ) {
+		while ( (opt = getopt_long(_cli._argc, av, "w:a:g:lP:F:O:z:N:iprvh", options, NULL)) != -1 ) {
 	        switch (opt) {
 	        case 'w':
-	        	swtime		= optarg;
+	        	take(swtime, optarg);
 	        	break;
 	        case 'a':
-	        	satime		= optarg;
+	        	take(satime, optarg);
 	        	break;
 	        case 'g':
-	        	sagain		= optarg;
+	        	take(sagain, optarg);
 	        	break;
 	        case 'l':
 	        	wlong		= true;
 	        	break;
+	        case 'P':
+	        	take(speriod, optarg);
+	        	break;
+	        case 'F':
+	        	take(sphase, optarg);
+	        	break;
+	        case 'O':
+	        	take(spower, optarg);
+	        	break;
+	        case 'z':
+	        	take(szero, optarg);
+	        	break;
+	        case 'N':
+	        	take(ssamples, optarg);
+	        	break;
 	        case 'i':
 	        	init		= true;
 	        	break;
@@ -407,41 +767,64 @@ public:
 	    }
 
 	    if( ferror ) {
-	    	_cli._ios << (_messages["invArg"]).c_str() << modm::endl;
+	    	_cli._ios << msgInvArg << modm::endl;
 	    }
 	    if( fhelp ){
-	    	_cli._ios << (_messages["help"]).c_str() << modm::endl;
+	    	_cli._ios << msgHelp << modm::endl;
 	    }
 
 	}
 
+	/// an unknown option or a value that does not fit: nothing is applied
+	bool
+	failed() const				{ return ferror; }
+
 	bool			restart		= false;
 	bool			ping		= false;
 	bool			init		= false;
 	bool			wlong		= false;
-	std::string		sagain;						// X1/X4/X16/X60
-	std::string		swtime;						// 0..256 (0 = 256(614ms/7.4s); 0xFF = 1(2,4ms/0.029s)wo long bit/w long bit)
-	std::string		satime;						// Count = (256 − ATIME) × 1024 up to a maximum of 65535 (0 = 700ms; 0xFF = 2.4ms)
+	CliString<Cli::OPTION_LENGTH>
+					sagain;						// X1/X4/X16/X60
+	CliString<Cli::OPTION_LENGTH>
+					swtime;						// 0..256 (0 = 256(614ms/7.4s); 0xFF = 1(2,4ms/0.029s)wo long bit/w long bit)
+	CliString<Cli::OPTION_LENGTH>
+					satime;						// Count = (256 − ATIME) × 1024 up to a maximum of 65535 (0 = 700ms; 0xFF = 2.4ms)
+	CliString<Cli::OPTION_LENGTH>
+					speriod;					// ms
+	CliString<Cli::OPTION_LENGTH>
+					sphase;						// ms into the period | free
+	CliString<Cli::OPTION_LENGTH>
+					spower;						// on | gated
+	CliString<Cli::OPTION_LENGTH>
+					szero;						// dark | blank | off
+	CliString<Cli::OPTION_LENGTH>
+					ssamples;					// readings averaged by --zero
 };
 // ----------------------------------------------------------------------------
 
 class V6040: public CommandBase {
 public:
+	/// see Tcs::options
+	static constexpr struct option	options[] = {
+		{"atime",		required_argument,	NULL, 'a'},
+		{"period",		required_argument,	NULL, 'P'},
+		{"phase",		required_argument,	NULL, 'F'},
+		{"power",		required_argument,	NULL, 'O'},
+		{"zero",		required_argument,	NULL, 'z'},
+		{"samples",		required_argument,	NULL, 'N'},
+		{"init",		no_argument,		NULL, 'i'},
+		{"ping",		no_argument,		NULL, 'p'},
+		{"restart",		no_argument,		NULL, 'r'},
+		{"verbose",		no_argument,		NULL, 'v'},
+		{"help",		no_argument,		NULL, 'h'},
+		{0,0,0,0}
+	};
+
 	V6040(Cli&	cli): CommandBase(cli) {}
 
 	void
 	getOptions() override {
 
-		const struct option loptions[] = {
-			{"atime",		required_argument,	NULL, 'a'},
-			{"init",		no_argument,		NULL, 'i'},
-			{"ping",		no_argument,		NULL, 'p'},
-			{"restart",		no_argument,		NULL, 'r'},
-			{"verbose",		no_argument,		NULL, 'v'},
-			{"help",		no_argument,		NULL, 'h'},
-			{0,0,0,0}
-		};
-
 		int opt;
 		opterr				= 0;
 		optarg				= nullptr;
@@ -453,10 +836,35 @@ public:
 		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
 		av					= p;
 
-		while ( (opt = getopt_long(_cli._argc, av, "a:iprvh", loptions, NULL)) != -1 ) {
+		ferror				= false;
+		fhelp				= false;
+
+		// one-shot: the period/phase are not set again by the next command
+		speriod.clear();
+		sphase.clear();
+		spower.clear();
+		szero.clear();
+		ssamples.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "a:P:F:O:z:N:iprvh", options, NULL)) != -1 ) {
 	        switch (opt) {
 	        case 'a':
-	        	satime		= optarg;
+	        	take(satime, optarg);
+	        	break;
+	        case 'P':
+	        	take(speriod, optarg);
+	        	break;
+	        case 'F':
+	        	take(sphase, optarg);
+	        	break;
+	        case 'O':
+	        	take(spower, optarg);
+	        	break;
+	        case 'z':
+	        	take(szero, optarg);
+	        	break;
+	        case 'N':
+	        	take(ssamples, optarg);
 	        	break;
 	        case 'i':
 	        	init		= true;
@@ -483,38 +891,64 @@ public:
 	    }
 
 	    if( ferror ) {
-	    	_cli._ios << (_messages["invArg"]).c_str() << modm::endl;
+	    	_cli._ios << msgInvArg << modm::endl;
 	    }
 	    if( fhelp ){
-	    	_cli._ios << (_messages["help"]).c_str() << modm::endl;
+	    	_cli._ios << msgHelp << modm::endl;
 	    }
 
 	}
 
+	/// an unknown option or a value that does not fit: nothing is applied
+	bool
+	failed() const				{ return ferror; }
+
 	bool			restart		= false;
 	bool			ping		= false;
 	bool			init		= false;
-	std::string		satime;						// 1280ms 640ms 320ms 160ms 80ms  40ms
+	CliString<Cli::OPTION_LENGTH>
+					satime;						// 1280ms 640ms 320ms 160ms 80ms  40ms
+	CliString<Cli::OPTION_LENGTH>
+					speriod;					// ms
+	CliString<Cli::OPTION_LENGTH>
+					sphase;						// ms into the period | free
+	CliString<Cli::OPTION_LENGTH>
+					spower;						// on | gated
+	CliString<Cli::OPTION_LENGTH>
+					szero;						// dark | blank | off
+	CliString<Cli::OPTION_LENGTH>
+					ssamples;					// readings averaged by --zero
 };
 // ----------------------------------------------------------------------------
 
 class V6070: public CommandBase {
 public:
+	/// see Tcs::options
+	static constexpr struct option	options[] = {
+		{"atime",		required_argument,	NULL, 'a'},
+		{"blank",		no_argument,		NULL, 'b'},
+		{"analyte",		required_argument,	NULL, 'n'},
+		{"curve",		required_argument,	NULL, 'k'},
+		{"output",		required_argument,	NULL, 'o'},
+		{"ack",			required_argument,	NULL, 'c'},
+		{"period",		required_argument,	NULL, 'P'},
+		{"phase",		required_argument,	NULL, 'F'},
+		{"power",		required_argument,	NULL, 'O'},
+		{"zero",		required_argument,	NULL, 'z'},
+		{"samples",		required_argument,	NULL, 'N'},
+		{"init",		no_argument,		NULL, 'i'},
+		{"ping",		no_argument,		NULL, 'p'},
+		{"restart",		no_argument,		NULL, 'r'},
+		{"verbose",		no_argument,		NULL, 'v'},
+		{"help",		no_argument,		NULL, 'h'},
+		{0,0,0,0}
+	};
+
 	V6070(Cli&	cli): CommandBase(cli) {}
 
 	void
 	getOptions() override {
 
-		const struct option loptions[] = {
-			{"atime",		required_argument,	NULL, 'a'},
-			{"init",		no_argument,		NULL, 'i'},
-			{"ping",		no_argument,		NULL, 'p'},
-			{"restart",		no_argument,		NULL, 'r'},
-			{"verbose",		no_argument,		NULL, 'v'},
-			{"help",		no_argument,		NULL, 'h'},
-			{0,0,0,0}
-		};
-
 		int opt;
 		opterr				= 0;
 		optarg				= nullptr;
@@ -526,10 +960,57 @@ public:
 		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
 		av					= p;
 
-		while ( (opt = getopt_long(_cli._argc, av, "a:iprvh", loptions, NULL)) != -1 ) {
+		ferror				= false;
+		fhelp				= false;
+
+		// one-shot: the period/phase are not set again by the next command
+		speriod.clear();
+		sphase.clear();
+		spower.clear();
+		szero.clear();
+		ssamples.clear();
+
+		// one-shot options are not sticky between commands
+		blank				= false;
+		sanalyte.clear();
+		scurve.clear();
+		soutput.clear();
+		sack.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "a:bn:k:o:c:P:F:O:z:N:iprvh", options, NULL)) != -1 ) {
 	        switch (opt) {
 	        case 'a':
-	        	satime		= optarg;
+	        	take(satime, optarg);
+	        	break;
+	        case 'b':
+	        	blank		= true;
+	        	break;
+	        case 'n':
+	        	take(sanalyte, optarg);
+	        	break;
+	        case 'k':
+	        	take(scurve, optarg);
+	        	break;
+	        case 'o':
+	        	take(soutput, optarg);
+	        	break;
+	        case 'c':
+	        	take(sack, optarg);
+	        	break;
+	        case 'P':
+	        	take(speriod, optarg);
+	        	break;
+	        case 'F':
+	        	take(sphase, optarg);
+	        	break;
+	        case 'O':
+	        	take(spower, optarg);
+	        	break;
+	        case 'z':
+	        	take(szero, optarg);
+	        	break;
+	        case 'N':
+	        	take(ssamples, optarg);
 	        	break;
 	        case 'i':
 	        	init		= true;
@@ -556,17 +1037,1048 @@ public:
 	    }
 
 	    if( ferror ) {
-	    	_cli._ios << (_messages["invArg"]).c_str() << modm::endl;
+	    	_cli._ios << msgInvArg << modm::endl;
 	    }
 	    if( fhelp ){
-	    	_cli._ios << (_messages["help"]).c_str() << modm::endl;
+	    	_cli._ios << msgHelp << modm::endl;
 	    }
 
 	}
 
+	/// an unknown option or a value that does not fit: nothing is applied
+	bool
+	failed() const				{ return ferror; }
+
 	bool			restart		= false;
 	bool			ping		= false;
 	bool			init		= false;
-	std::string		satime;						// 500ms 250ms 125ms 62.5ms
+	bool			blank		= false;		// take the next UV sample as blank (I0)
+	CliString<Cli::OPTION_LENGTH>
+					satime;						// 500ms 250ms 125ms 62.5ms
+	CliString<Cli::OPTION_LENGTH>
+					sanalyte;					// 0..Concentration::MAX_ANALYTES-1
+	CliString<Cli::CMD_LINE_LENGTH>
+					scurve;						// k0,k1,k2,k3 (decimal)
+	CliString<Cli::OPTION_LENGTH>
+					soutput;					// raw | conc | both
+	CliString<Cli::OPTION_LENGTH>
+					sack;						// off | 102 | 145
+	CliString<Cli::OPTION_LENGTH>
+					speriod;					// ms
+	CliString<Cli::OPTION_LENGTH>
+					sphase;						// ms into the period | free
+	CliString<Cli::OPTION_LENGTH>
+					spower;						// on | gated
+	CliString<Cli::OPTION_LENGTH>
+					szero;						// dark | blank | off
+	CliString<Cli::OPTION_LENGTH>
+					ssamples;					// readings averaged by --zero
+};
+// ----------------------------------------------------------------------------
+
+class Unmix: public CommandBase {
+public:
+	Unmix(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"analytes",	required_argument,	NULL, 'n'},
+			{"source",		required_argument,	NULL, 's'},
+			{"blank",		no_argument,		NULL, 'b'},
+			{"standard",	required_argument,	NULL, 'j'},
+			{"conc",		required_argument,	NULL, 'c'},
+			{"absorptivity",required_argument,	NULL, 'e'},
+			{"on",			no_argument,		NULL, '1'},
+			{"off",			no_argument,		NULL, '0'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		blank				= false;
+		on					= false;
+		off					= false;
+		ferror				= false;
+		fhelp				= false;
+		sanalytes.clear();
+		ssource.clear();
+		sstandard.clear();
+		sconc.clear();
+		sabsorptivity.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "n:s:bj:c:e:10vh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'n':
+	        	take(sanalytes, optarg);
+	        	break;
+	        case 's':
+	        	take(ssource, optarg);
+	        	break;
+	        case 'b':
+	        	blank		= true;
+	        	break;
+	        case 'j':
+	        	take(sstandard, optarg);
+	        	break;
+	        case 'c':
+	        	take(sconc, optarg);
+	        	break;
+	        case 'e':
+	        	take(sabsorptivity, optarg);
+	        	break;
+	        case '1':
+	        	on			= true;
+	        	break;
+	        case '0':
+	        	off			= true;
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	bool			blank		= false;		// next feature vector is the blank
+	bool			on			= false;
+	bool			off			= false;
+	CliString<Cli::OPTION_LENGTH>
+					sanalytes;					// 1..Unmixing::MAX_ANALYTES
+	CliString<Cli::OPTION_LENGTH>
+					ssource;					// tcs | v6040
+	CliString<Cli::OPTION_LENGTH>
+					sstandard;					// analyte index J
+	CliString<Cli::OPTION_LENGTH>
+					sconc;						// concentration of standard J (decimal)
+	CliString<Cli::CMD_LINE_LENGTH>
+					sabsorptivity;				// e_uv,e_r,e_g,e_b,e_c of analyte J (decimal)
+};
+// ----------------------------------------------------------------------------
+
+class Kalman: public CommandBase {
+public:
+	Kalman(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"analyte",		required_argument,	NULL, 'j'},
+			{"process",		required_argument,	NULL, 'q'},
+			{"noise",		required_argument,	NULL, 'n'},
+			{"reset",		no_argument,		NULL, 'r'},
+			{"on",			no_argument,		NULL, '1'},
+			{"off",			no_argument,		NULL, '0'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		reset				= false;
+		on					= false;
+		off					= false;
+		ferror				= false;
+		fhelp				= false;
+		sanalyte.clear();
+		sprocess.clear();
+		snoise.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "j:q:n:r10vh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'j':
+	        	take(sanalyte, optarg);
+	        	break;
+	        case 'q':
+	        	take(sprocess, optarg);
+	        	break;
+	        case 'n':
+	        	take(snoise, optarg);
+	        	break;
+	        case 'r':
+	        	reset		= true;
+	        	break;
+	        case '1':
+	        	on			= true;
+	        	break;
+	        case '0':
+	        	off			= true;
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	/// @return true if the settings are to be changed, not just printed
+	bool
+	changes() const				{
+		return reset || on || off || !sprocess.empty() || !snoise.empty();
+	}
+
+	bool			reset		= false;
+	bool			on			= false;
+	bool			off			= false;
+	CliString<Cli::OPTION_LENGTH>
+					sanalyte;					// analyte index J, (none) = all
+	CliString<Cli::OPTION_LENGTH>
+					sprocess;					// conc/s^1/2 (decimal)
+	CliString<Cli::OPTION_LENGTH>
+					snoise;						// conc (decimal) | auto
+};
+// ----------------------------------------------------------------------------
+
+class Stats: public CommandBase {
+public:
+	Stats(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"window",		required_argument,	NULL, 'w'},
+			{"reset",		no_argument,		NULL, 'r'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		reset				= false;
+		ferror				= false;
+		fhelp				= false;
+		swindow.clear();
+		sensor.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "w:rvh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'w':
+	        	take(swindow, optarg);
+	        	break;
+	        case 'r':
+	        	reset		= true;
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+		// sensor name is the first non-option argument
+		if ( optind < _cli._argc ) {
+			take(sensor, av[optind]);
+		} else {
+			ferror			= true;
+		}
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	bool			reset		= false;
+	CliString<Cli::OPTION_LENGTH>
+					swindow;					// samples per window, 0 = since reset
+	CliString<Cli::OPTION_LENGTH>
+					sensor;						// tcs | v6040 | v6070 | all
+};
+// ----------------------------------------------------------------------------
+
+class Alarm: public CommandBase {
+public:
+	Alarm(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"high",		required_argument,	NULL, 'u'},
+			{"low",			required_argument,	NULL, 'l'},
+			{"hyst",		required_argument,	NULL, 'y'},
+			{"debounce",	required_argument,	NULL, 'd'},
+			{"off",			no_argument,		NULL, '0'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		off					= false;
+		ferror				= false;
+		fhelp				= false;
+		shigh.clear();
+		slow.clear();
+		shyst.clear();
+		sdebounce.clear();
+		sensor.clear();
+		channel.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "u:l:y:d:0vh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'u':
+	        	take(shigh, optarg);
+	        	break;
+	        case 'l':
+	        	take(slow, optarg);
+	        	break;
+	        case 'y':
+	        	take(shyst, optarg);
+	        	break;
+	        case 'd':
+	        	take(sdebounce, optarg);
+	        	break;
+	        case '0':
+	        	off			= true;
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+		// sensor and channel names are the non-option arguments
+		if ( optind + 1 < _cli._argc ) {
+			take(sensor, av[optind]);
+			take(channel, av[optind + 1]);
+		} else {
+			ferror			= true;
+		}
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	bool			off			= false;
+	CliString<Cli::OPTION_LENGTH>
+					shigh;						// counts
+	CliString<Cli::OPTION_LENGTH>
+					slow;						// counts
+	CliString<Cli::OPTION_LENGTH>
+					shyst;						// counts
+	CliString<Cli::OPTION_LENGTH>
+					sdebounce;					// samples
+	CliString<Cli::OPTION_LENGTH>
+					sensor;						// tcs | v6040 | v6070
+	CliString<Cli::OPTION_LENGTH>
+					channel;					// R | G | B | C | W | UV
+};
+// ----------------------------------------------------------------------------
+
+class Report: public CommandBase {
+public:
+	Report(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"heartbeat",	required_argument,	NULL, 'b'},
+			{"units",		required_argument,	NULL, 'u'},
+			{"fields",		required_argument,	NULL, 'f'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		ferror				= false;
+		fhelp				= false;
+		sheartbeat.clear();
+		sunits.clear();
+		sfields.clear();
+		mode.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "b:u:f:vh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'b':
+	        	take(sheartbeat, optarg);
+	        	break;
+	        case 'u':
+	        	take(sunits, optarg);
+	        	break;
+	        case 'f':
+	        	take(sfields, optarg);
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+		if ( optind < _cli._argc ) {
+			take(mode, av[optind]);
+		}
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	CliString<Cli::OPTION_LENGTH>
+					sheartbeat;					// seconds, 0 = off
+	CliString<Cli::OPTION_LENGTH>
+					sunits;						// raw | norm
+	CliString<Cli::CMD_LINE_LENGTH>
+					sfields;					// counts,hue,sat,value
+	CliString<Cli::OPTION_LENGTH>
+					mode;						// stream | events
+};
+// ----------------------------------------------------------------------------
+
+class Dump: public CommandBase {
+public:
+	Dump(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"clear",		no_argument,		NULL, 'c'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		clear				= false;
+		ferror				= false;
+		fhelp				= false;
+		sensor.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "cvh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'c':
+	        	clear		= true;
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+		if ( optind < _cli._argc ) {
+			take(sensor, av[optind]);
+		} else {
+			ferror			= true;
+		}
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	bool			clear		= false;
+	CliString<Cli::OPTION_LENGTH>
+					sensor;						// tcs | v6040 | v6070
+};
+// ----------------------------------------------------------------------------
+
+class Mem: public CommandBase {
+public:
+	Mem(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"reset",		no_argument,		NULL, 'r'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		reset				= false;
+		ferror				= false;
+		fhelp				= false;
+
+		while ( (opt = getopt_long(_cli._argc, av, "rvh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'r':
+	        	reset		= true;
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	bool			reset		= false;
+};
+// ----------------------------------------------------------------------------
+
+class Power: public CommandBase {
+public:
+	Power(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"reset",		no_argument,		NULL, 'r'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		reset				= false;
+		ferror				= false;
+		fhelp				= false;
+
+		while ( (opt = getopt_long(_cli._argc, av, "rvh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'r':
+	        	reset		= true;
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	bool			reset		= false;
+};
+// ----------------------------------------------------------------------------
+
+class Trace: public CommandBase {
+public:
+	Trace(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		ferror				= false;
+		fhelp				= false;
+		action.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "vh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+		// optional action, the first non-option argument
+		if ( optind < _cli._argc ) {
+			take(action, av[optind]);
+			if ( action != "dump" && action != "clear" )	ferror = true;
+		}
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	CliString<Cli::OPTION_LENGTH>
+					action;						// (none) | dump | clear
+};
+// ----------------------------------------------------------------------------
+
+class Loop: public CommandBase {
+public:
+	Loop(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"reset",		no_argument,		NULL, 'r'},
+			{"budget",		required_argument,	NULL, 'b'},
+			{"late",		required_argument,	NULL, 'l'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		reset				= false;
+		ferror				= false;
+		fhelp				= false;
+		sbudget.clear();
+		slate.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "rb:l:vh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'r':
+	        	reset		= true;
+	        	break;
+	        case 'b':
+	        	take(sbudget, optarg);
+	        	break;
+	        case 'l':
+	        	take(slate, optarg);
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	bool			reset		= false;
+	CliString<Cli::OPTION_LENGTH>
+					sbudget;					// us per pass, 0 = off
+	CliString<Cli::OPTION_LENGTH>
+					slate;						// ms
+};
+// ----------------------------------------------------------------------------
+
+class Rate: public CommandBase {
+public:
+	Rate(Cli&	cli): CommandBase(cli) {}
+
+	void
+	getOptions() override {
+
+		const struct option loptions[] = {
+			{"fixed",		no_argument,		NULL, 'f'},
+			{"adaptive",	no_argument,		NULL, 'a'},
+			{"min",			required_argument,	NULL, 'm'},
+			{"max",			required_argument,	NULL, 'M'},
+			{"slope",		required_argument,	NULL, 's'},
+			{"noise",		required_argument,	NULL, 'n'},
+			{"hold",		required_argument,	NULL, 'o'},
+			{"verbose",		no_argument,		NULL, 'v'},
+			{"help",		no_argument,		NULL, 'h'},
+			{0,0,0,0}
+		};
+
+		int opt;
+		opterr				= 0;
+		optarg				= nullptr;
+		optind				= 0;
+
+		char*const* av;
+		char*		p[Cli::CMD_MAX_ARGC];
+
+		for(uint8_t i=0; i<_cli._argc; i++) p[i]	= _cli._argv[i];
+		av					= p;
+
+		fixed				= false;
+		adaptive			= false;
+		ferror				= false;
+		fhelp				= false;
+		smin.clear();
+		smax.clear();
+		sslope.clear();
+		snoise.clear();
+		shold.clear();
+		sensor.clear();
+
+		while ( (opt = getopt_long(_cli._argc, av, "fam:M:s:n:o:vh", loptions, NULL)) != -1 ) {
+	        switch (opt) {
+	        case 'f':
+	        	fixed		= true;
+	        	break;
+	        case 'a':
+	        	adaptive	= true;
+	        	break;
+	        case 'm':
+	        	take(smin, optarg);
+	        	break;
+	        case 'M':
+	        	take(smax, optarg);
+	        	break;
+	        case 's':
+	        	take(sslope, optarg);
+	        	break;
+	        case 'n':
+	        	take(snoise, optarg);
+	        	break;
+	        case 'o':
+	        	take(shold, optarg);
+	        	break;
+	        case 'v':
+	            fverbose   	= true;
+	            break;
+	        case 'h':
+	            fhelp   	= true;
+	            break;
+	        case ':':
+	            ferror 		= true;
+	            break;
+	        case '?':
+	            ferror		= true;
+	            break;
+	        }
+	    }
+		// sensor name is the first non-option argument
+		if ( optind < _cli._argc ) {
+			take(sensor, av[optind]);
+		} else {
+			ferror			= true;
+		}
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror; }
+
+	/// @return true if the policy is to be changed, not just printed
+	bool
+	changes() const				{
+		return fixed || adaptive || !smin.empty() || !smax.empty() ||
+			   !sslope.empty() || !snoise.empty() || !shold.empty();
+	}
+
+	bool			fixed		= false;
+	bool			adaptive	= false;
+	CliString<Cli::OPTION_LENGTH>
+					smin;						// ms
+	CliString<Cli::OPTION_LENGTH>
+					smax;						// ms
+	CliString<Cli::OPTION_LENGTH>
+					sslope;						// counts/s, 0 = off
+	CliString<Cli::OPTION_LENGTH>
+					snoise;						// counts, 0 = off
+	CliString<Cli::OPTION_LENGTH>
+					shold;						// samples
+	CliString<Cli::OPTION_LENGTH>
+					sensor;						// tcs | v6040 | v6070 | all
+};
+// ----------------------------------------------------------------------------
+
+class Script: public CommandBase {
+public:
+	Script(Cli&	cli): CommandBase(cli) {}
+
+	/// no getopt: the options after 'add' belong to the script line
+	void
+	getOptions() override {
+		ferror				= false;
+		fhelp				= false;
+		action.clear();
+		argc				= 0;
+
+		if ( _cli._argc > 1 )	take(action, _cli._argv[1]);
+		if ( action == "-h" || action == "--help" ) {
+			fhelp			= true;
+		} else if ( action == "add" ) {
+			for (uint8_t i = 2; i < _cli._argc; ++i)	argv[argc++] = _cli._argv[i];
+			if ( argc == 0 )	ferror = true;
+		} else if ( action == "save" ) {
+			boot			= ( _cli._argc > 2 && strcmp(_cli._argv[2], "boot") == 0 );
+			if ( _cli._argc > 3 || ( _cli._argc == 3 && !boot ) )	ferror = true;
+		} else if ( !action.empty() && action != "run" && action != "stop" && action != "clear" ) {
+			ferror			= true;
+		} else if ( _cli._argc > 2 ) {
+			ferror			= true;
+		}
+
+	    if( ferror ) {
+	    	_cli._ios << msgInvArg << modm::endl;
+	    }
+	    if( fhelp ){
+	    	_cli._ios << msgHelp << modm::endl;
+	    }
+
+	}
+
+	bool
+	failed() const				{ return ferror || fhelp; }
+
+	CliString<Cli::OPTION_LENGTH>
+					action;						// (none) | add | clear | run | stop | save
+	const char*		argv[Cli::CMD_MAX_ARGC];	// the line of 'add'
+	uint8_t			argc		= 0;
+	bool			boot		= false;		// 'save boot': run it after a reset
 };
 // ----------------------------------------------------------------------------
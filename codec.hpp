@@ -0,0 +1,296 @@
+// ----------------------------------------------------------------------------
+
+#ifndef CODEC_HPP
+#define CODEC_HPP
+
+#include <stdint.h>
+// ----------------------------------------------------------------------------
+
+/// @brief Delta + zigzag block coding of sample records
+///
+/// Shared by the firmware ('dump' command) and the host tools.
+///
+/// Stream format (v1), after the text header line
+///		"DUMP v1 <sensor> n=<records> ch=<channels> dropped=<n>\n":
+///
+///	  record 0:		varint(ms)  varint(ch[0]) ... varint(ch[C-1])
+///	  then blocks of up to BLOCK records:
+///		widths:		1 + C bytes, bit width of the widest residual per field
+///		residuals:	record by record, field by field, each residual in
+///					width bits, LSB first; the block ends on a byte boundary
+///	  residuals:	timestamp	zigzag((ms - prev.ms) - (prev.ms - prevprev.ms))
+///					channel		zigzag(ch - prev.ch)
+///
+/// followed by "\nEND <crc16 of the binary part, hex>\n".
+///
+/// A 500 ms period with a few ms of jitter costs 2-3 bits per timestamp, a
+/// slowly varying channel with a few counts of noise 3-4 bits instead of 16.
+namespace codec {
+
+enum {
+	BLOCK			= 16,					// records per block
+	MAX_CHANNELS	= 8
+};
+
+inline uint32_t
+zigzag(int32_t v)						{ return (static_cast<uint32_t>(v) << 1) ^ static_cast<uint32_t>(v >> 31); }
+
+inline int32_t
+unzigzag(uint32_t v)					{ return static_cast<int32_t>(v >> 1) ^ -static_cast<int32_t>(v & 1); }
+
+inline uint8_t
+width(uint32_t v)						{ return v ? 32 - __builtin_clz(v) : 0; }
+
+/// @brief LEB128: 7 bits per byte, MSB set = more bytes follow
+template < typename Put >
+inline void
+varint(uint32_t v, Put&& put) {
+	while ( v >= 0x80 ) {
+		put(static_cast<uint8_t>(v | 0x80));
+		v	>>= 7;
+	}
+	put(static_cast<uint8_t>(v));
+}
+
+/// @brief CRC-16/CCITT-FALSE, one byte
+inline uint16_t
+crc16(uint16_t crc, uint8_t b) {
+	crc		^= static_cast<uint16_t>(b) << 8;
+	for (uint8_t i = 0; i < 8; ++i)
+		crc	= ( crc & 0x8000 ) ? (crc << 1) ^ 0x1021 : (crc << 1);
+	return crc;
+}
+// ----------------------------------------------------------------------------
+
+/// @brief Block encoder over a record source with random access
+///
+/// `Src` provides `at(i)` returning a record with `ms` and `ch[Channels]`.
+/// The residuals are computed twice (widths, then bits) straight from the
+/// source, so nothing but a 64-bit bit accumulator is needed.
+template < uint8_t Channels, typename Src >
+class BlockEncoder {
+public:
+	enum { FIELDS = 1 + Channels };
+
+	explicit
+	BlockEncoder(const Src& src):
+		_src(src),
+		_count(0),
+		_next(0)				{
+	}
+
+	void
+	start(uint16_t count)		{
+		_count	= count;
+		_next	= 0;
+	}
+
+	bool
+	done() const				{ return _next >= _count; }
+
+	/// @brief encode record 0 or the next block
+	template < typename Put >
+	void
+	step(Put&& put) {
+		if ( done() )	return;
+
+		if ( _next == 0 ) {
+			const auto&
+			r		= _src.at(0);
+			varint(r.ms, put);
+			for (uint8_t i = 0; i < Channels; ++i)
+				varint(r.ch[i], put);
+			_next	= 1;
+			return;
+		}
+
+		const uint16_t
+		end		= ( _count - _next > BLOCK ) ? _next + BLOCK : _count;
+
+		uint8_t
+		w[FIELDS]	= {};
+		for (uint16_t k = _next; k < end; ++k) {
+			for (uint8_t f = 0; f < FIELDS; ++f) {
+				const uint8_t
+				b		= width(residual(k, f));
+				if ( b > w[f] )	w[f] = b;
+			}
+		}
+		for (uint8_t f = 0; f < FIELDS; ++f)	put(w[f]);
+
+		uint64_t	acc		= 0;
+		uint8_t		bits	= 0;
+		for (uint16_t k = _next; k < end; ++k) {
+			for (uint8_t f = 0; f < FIELDS; ++f) {
+				acc		|= static_cast<uint64_t>(residual(k, f)) << bits;
+				bits	+= w[f];
+				while ( bits >= 8 ) {
+					put(static_cast<uint8_t>(acc));
+					acc		>>= 8;
+					bits	-= 8;
+				}
+			}
+		}
+		if ( bits )	put(static_cast<uint8_t>(acc));
+
+		_next	= end;
+	}
+
+private:
+	/// residual of field f (0 = timestamp) of record k >= 1
+	uint32_t
+	residual(uint16_t k, uint8_t f) const {
+		const auto&	r	= _src.at(k);
+		const auto&	p	= _src.at(k - 1);
+		if ( f == 0 ) {
+			const int32_t
+			dt		= static_cast<int32_t>(r.ms - p.ms),
+			dtPrev	= ( k >= 2 ) ? static_cast<int32_t>(p.ms - _src.at(k - 2).ms) : 0;
+			return zigzag(dt - dtPrev);
+		}
+		return zigzag(static_cast<int32_t>(r.ch[f - 1]) - static_cast<int32_t>(p.ch[f - 1]));
+	}
+
+	const Src&		_src;
+	uint16_t		_count;
+	uint16_t		_next;						// next record to encode
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Decoder, fed byte by byte (host side)
+class BlockDecoder {
+public:
+	BlockDecoder(uint8_t channels, uint32_t count):
+		_channels(channels > MAX_CHANNELS ? uint8_t(MAX_CHANNELS) : channels),
+		_count(count)			{
+		reset();
+	}
+
+	void
+	reset()						{
+		_decoded	= 0;
+		_field		= 0;
+		_value		= 0;
+		_shift		= 0;
+		_acc		= 0;
+		_bits		= 0;
+		_inBlock	= 0;
+		_dt			= 0;
+		ms			= 0;
+		for (uint8_t i = 0; i < MAX_CHANNELS; ++i)	ch[i] = 0;
+	}
+
+	bool
+	done() const				{ return _decoded >= _count; }
+
+	uint32_t
+	decoded() const				{ return _decoded; }
+
+	/// @brief feed one byte, fn() is called for every completed record
+	/// (read it from ms, ch[])
+	template < typename Fn >
+	void
+	put(uint8_t b, Fn&& fn) {
+		if ( done() )	return;
+
+		if ( _decoded == 0 ) {								// record 0: varints
+			_value	|= static_cast<uint32_t>(b & 0x7F) << _shift;
+			_shift	+= 7;
+			if ( b & 0x80 )	return;
+			if ( _field == 0 )	ms = _value;
+			else				ch[_field - 1] = static_cast<uint16_t>(_value);
+			_value	= 0;
+			_shift	= 0;
+			if ( ++_field <= _channels )	return;
+			_field	= 0;
+			++_decoded;
+			fn();
+			return;
+		}
+
+		if ( _inBlock == 0 ) {								// block header: widths
+			_w[_field]	= b;
+			if ( ++_field <= _channels )	return;
+			_field		= 0;
+			_inBlock	= ( _count - _decoded > BLOCK ) ? uint8_t(BLOCK) : static_cast<uint8_t>(_count - _decoded);
+			_acc		= 0;
+			_bits		= 0;
+			if ( !zeroWidth() )	return;
+			// a block of all-zero residuals has no payload
+			while ( _inBlock )	record(fn);
+			return;
+		}
+
+		_acc	|= static_cast<uint64_t>(b) << _bits;
+		_bits	+= 8;
+		while ( _inBlock && _bits >= _w[_field] ) {
+			const uint32_t
+			v		= static_cast<uint32_t>(_acc & ((1ULL << _w[_field]) - 1));
+			_acc	>>= _w[_field];
+			_bits	-= _w[_field];
+			if ( _field == 0 ) {
+				_dt		+= unzigzag(v);
+				_next	= ms + _dt;
+			} else {
+				_nextCh[_field - 1]	= static_cast<uint16_t>(ch[_field - 1] + unzigzag(v));
+			}
+			if ( ++_field <= _channels )	continue;
+			_field	= 0;
+			commit(fn);
+			// the rest of the byte is padding once the block is complete
+			if ( _inBlock == 0 ) {
+				_acc	= 0;
+				_bits	= 0;
+			}
+		}
+	}
+
+	uint32_t		ms;
+	uint16_t		ch[MAX_CHANNELS];
+
+private:
+	bool
+	zeroWidth() const			{
+		for (uint8_t f = 0; f <= _channels; ++f)
+			if ( _w[f] )	return false;
+		return true;
+	}
+
+	/// record with all residuals zero
+	template < typename Fn >
+	void
+	record(Fn&& fn) {
+		_next	= ms + _dt;
+		for (uint8_t i = 0; i < _channels; ++i)	_nextCh[i] = ch[i];
+		commit(fn);
+	}
+
+	template < typename Fn >
+	void
+	commit(Fn&& fn) {
+		ms		= _next;
+		for (uint8_t i = 0; i < _channels; ++i)	ch[i] = _nextCh[i];
+		--_inBlock;
+		++_decoded;
+		fn();
+	}
+
+	uint8_t			_channels;
+	uint32_t		_count;						// records in the stream
+	uint32_t		_decoded;
+	uint8_t			_field;						// 0 = timestamp, 1.. = channels
+	uint32_t		_value;						// varint being read
+	uint8_t			_shift;
+	uint8_t			_w[1 + MAX_CHANNELS];		// widths of the current block
+	uint8_t			_inBlock;					// records left in the block
+	uint64_t		_acc;						// bit accumulator
+	uint8_t			_bits;
+	int32_t			_dt;						// last timestamp delta
+	uint32_t		_next;
+	uint16_t		_nextCh[MAX_CHANNELS];
+};
+
+}	// namespace codec
+// ----------------------------------------------------------------------------
+
+#endif	// CODEC_HPP
@@ -0,0 +1,106 @@
+// ----------------------------------------------------------------------------
+
+#ifndef CONCENTRATION_HPP
+#define CONCENTRATION_HPP
+
+#include <fixed.hpp>
+// ----------------------------------------------------------------------------
+
+/// @brief UV absorbance -> concentration engine
+///
+/// A = log10(I0 / I), where I0 is the blank (reference) reading.
+/// c = k0 + k1*A + k2*A^2 + k3*A^3:
+///		k1 = 1/(epsilon*l) is the Beer-Lambert slope,
+///		k0, k2, k3 correct for stray light and detector nonlinearity.
+/// Everything is Q16.16, so one sample costs a CLZ, two LUT lookups
+/// and four multiplies.
+class Concentration {
+public:
+	enum { MAX_ANALYTES = 4, CURVE_ORDER = 4 };
+
+	enum class Output: uint8_t {
+		Raw,
+		Conc,
+		Both
+	};
+
+	struct Curve {
+		const char*		name;
+		fixed::q16		k[CURVE_ORDER];
+	};
+
+public:
+
+	Concentration():
+		_blank(0),
+		_analyte(0),
+		output(Output::Both)	{
+	}
+
+	void
+	setBlank(uint16_t counts)	{ _blank = counts ? counts : 1; }
+
+	void
+	clearBlank()				{ _blank = 0; }
+
+	bool
+	hasBlank() const			{ return _blank != 0; }
+
+	uint16_t
+	blank() const				{ return _blank; }
+
+	bool
+	selectAnalyte(uint8_t idx)	{
+		if ( idx >= MAX_ANALYTES )	return false;
+		_analyte	= idx;
+		return true;
+	}
+
+	const Curve&
+	curve() const				{ return _curves[_analyte]; }
+
+	uint8_t
+	analyte() const				{ return _analyte; }
+
+	void
+	setCurve(const fixed::q16 (&k)[CURVE_ORDER]) {
+		for (uint8_t i = 0; i < CURVE_ORDER; ++i)
+			_curves[_analyte].k[i]	= k[i];
+	}
+
+	/// @brief absorbance of a sample against the blank, Q16.16
+	fixed::q16
+	absorbance(uint16_t counts) const {
+		return fixed::log10(_blank) - fixed::log10(counts);
+	}
+
+	/// @brief concentration from absorbance via the selected curve, Q16.16
+	fixed::q16
+	concentration(fixed::q16 a) const {
+		return fixed::poly(_curves[_analyte].k, CURVE_ORDER, a);
+	}
+
+	/// @brief parse "k0,k1,k2,k3" (missing trailing terms are zero)
+	static bool
+	parseCurve(const char* s, fixed::q16 (&k)[CURVE_ORDER]) {
+		for (uint8_t i = 0; i < CURVE_ORDER; ++i)	k[i] = 0;
+		return fixed::parseList(s, k, CURVE_ORDER) > 0;
+	}
+
+private:
+	uint16_t		_blank;							// I0, 0 = not captured
+	uint8_t			_analyte;						// selected calibration curve
+	Curve			_curves[MAX_ANALYTES]	= {
+		// k0, k1 (1/(epsilon*l)), k2, k3
+		{"generic",		{0, fixed::ONE, 0, 0}},
+		{"user1",		{0, fixed::ONE, 0, 0}},
+		{"user2",		{0, fixed::ONE, 0, 0}},
+		{"user3",		{0, fixed::ONE, 0, 0}}
+	};
+
+public:
+	Output			output;
+};
+// ----------------------------------------------------------------------------
+
+#endif	// CONCENTRATION_HPP
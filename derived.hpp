@@ -0,0 +1,159 @@
+// ----------------------------------------------------------------------------
+
+#ifndef DERIVED_HPP
+#define DERIVED_HPP
+
+#include <stdint.h>
+#include <string.h>
+
+#include <modm/ui/color.hpp>
+#include <concentration.hpp>
+#include <scale.hpp>
+// ----------------------------------------------------------------------------
+
+/// @brief Values derived from the counts of a sample, computed on demand
+///
+/// A sample on the bus carries its counts only. What is derived from them
+/// (the counts in the common unit, HSV, the absorbance) is computed the
+/// first time a consumer asks for it and kept in the sample, a bit of the
+/// validity mask per value, so each is computed at most once per sample and
+/// not at all if no output, alarm or filter needs it. Publishing a sample
+/// clears the mask.
+///
+/// The fields of the RGBW output ('report --fields') decide what the output
+/// asks for. The counts are always among them, the line starts with
+/// "RGBW" and the labels of the others, that is what the host tools parse.
+namespace derived {
+
+/// fields of the RGBW output
+enum Field : uint8_t {
+	Counts		= 1 << 0,						// raw or normalised ('report --units')
+	Hue			= 1 << 1,
+	Saturation	= 1 << 2,
+	Value		= 1 << 3,
+	FIELDS		= 4,
+	DEFAULT		= Counts | Hue
+};
+
+inline const char* const	names[FIELDS]	= { "counts", "hue", "sat", "value" };
+inline const char* const	labels[FIELDS]	= { "RGBW", "Hue", "Sat", "Val" };
+
+/// @brief "counts,hue,..." -> mask of the fields
+/// @return 0 if a name is unknown or none is given
+inline uint8_t
+parse(const char* s) {
+	uint8_t
+	mask	= 0;
+	while ( *s ) {
+		const char*
+		end		= strchr(s, ',');
+		const size_t
+		n		= end ? static_cast<size_t>(end - s) : strlen(s);
+		uint8_t
+		i		= 0;
+		while ( i < FIELDS && ( strlen(names[i]) != n || strncmp(s, names[i], n) != 0 ) )	++i;
+		if ( i == FIELDS )	return 0;
+		mask	|= ( 1 << i );
+		s		+= n;
+		if ( *s == ',' )	++s;
+	}
+	return mask;
+}
+// ----------------------------------------------------------------------------
+
+/// @brief derived values of an RGBW sample
+class Rgbw {
+public:
+	typedef modm::color::HsvT<uint16_t>	Hsv;
+
+	/// new counts, nothing derived yet
+	void
+	invalidate()				{ _valid = 0; }
+
+	uint32_t
+	normalised(const uint16_t (&ch)[4], uint32_t factor, uint8_t i) const {
+		if ( !( _valid & NORMALISED ) ) {
+			for (uint8_t c = 0; c < 4; ++c)	_normalised[c] = scale::normalise(ch[c], factor);
+			_valid	|= NORMALISED;
+		}
+		return _normalised[i];
+	}
+
+	const Hsv&
+	hsv(const uint16_t (&ch)[4]) const {
+		if ( !( _valid & HSV ) ) {
+			modm::color::RgbwT<uint16_t>
+			c;
+			c.red	= ch[0];
+			c.green	= ch[1];
+			c.blue	= ch[2];
+			c.white	= ch[3];
+			c.toHsv(&_hsv);
+			_valid	|= HSV;
+		}
+		return _hsv;
+	}
+
+private:
+	enum : uint8_t {
+		NORMALISED	= 1 << 0,
+		HSV			= 1 << 1
+	};
+
+	mutable uint32_t	_normalised[4];
+	mutable Hsv			_hsv;
+	mutable uint8_t		_valid	= 0;
+};
+
+/// @brief derived values of a UV sample
+class Uv {
+public:
+	void
+	invalidate()				{ _valid = 0; }
+
+	uint32_t
+	normalised(uint16_t uv, uint32_t factor) const {
+		if ( !( _valid & NORMALISED ) ) {
+			_normalised	= scale::normalise(uv, factor);
+			_valid		|= NORMALISED;
+		}
+		return _normalised;
+	}
+
+	/// against the blank of the concentration engine, which has one
+	fixed::q16
+	absorbance(uint16_t uv, const Concentration& c) const {
+		if ( !( _valid & ABSORBANCE ) ) {
+			_absorbance	= c.absorbance(uv);
+			_valid		|= ABSORBANCE;
+		}
+		return _absorbance;
+	}
+
+	/// via the selected curve
+	fixed::q16
+	concentration(uint16_t uv, const Concentration& c) const {
+		if ( !( _valid & CONCENTRATION ) ) {
+			_concentration	= c.concentration(absorbance(uv, c));
+			_valid			|= CONCENTRATION;
+		}
+		return _concentration;
+	}
+
+private:
+	enum : uint8_t {
+		NORMALISED		= 1 << 0,
+		ABSORBANCE		= 1 << 1,
+		CONCENTRATION	= 1 << 2
+	};
+
+	mutable uint32_t	_normalised;
+	mutable fixed::q16	_absorbance;
+	mutable fixed::q16	_concentration;
+	mutable uint8_t		_valid	= 0;
+};
+
+}	// namespace derived
+// ----------------------------------------------------------------------------
+
+#endif	// DERIVED_HPP
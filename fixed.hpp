@@ -0,0 +1,163 @@
+// ----------------------------------------------------------------------------
+
+#ifndef FIXED_HPP
+#define FIXED_HPP
+
+#include <stdint.h>
+#include <stdlib.h>
+// ----------------------------------------------------------------------------
+
+/// @brief Q16.16 fixed-point arithmetic (no soft-float on the MCU)
+namespace fixed {
+
+typedef int32_t	q16;
+
+enum : q16 {
+	ONE			= 1L << 16,
+	LOG10_2		= 19728					// log10(2) in Q16.16
+};
+
+constexpr q16
+fromInt(int32_t v)						{ return v * ONE; }
+
+constexpr q16
+mul(q16 a, q16 b)						{ return static_cast<q16>((static_cast<int64_t>(a) * b) >> 16); }
+
+inline q16
+div(q16 a, q16 b)						{ return static_cast<q16>((static_cast<int64_t>(a) << 16) / b); }
+
+/// @brief value * 1000, rounded (for printing as "int.frac")
+/// @param frac number of fraction bits of v (Q16.16 by default)
+constexpr int32_t
+toMilli(int64_t v, uint8_t frac = 16)	{ return static_cast<int32_t>((v * 1000 + ((1LL << frac) >> 1)) >> frac); }
+
+// log10(1 + i/64) in Q16.16, i = 0..64
+static const uint16_t
+log10Lut[65] = {
+	    0,   441,   876,  1304,  1725,  2141,  2551,  2954,
+	 3352,  3745,  4132,  4514,  4891,  5263,  5631,  5993,
+	 6351,  6705,  7054,  7399,  7740,  8077,  8409,  8739,
+	 9064,  9385,  9703, 10018, 10329, 10637, 10941, 11242,
+	11540, 11835, 12127, 12416, 12702, 12985, 13266, 13543,
+	13818, 14091, 14361, 14628, 14893, 15155, 15415, 15672,
+	15928, 16181, 16432, 16680, 16927, 17171, 17413, 17653,
+	17891, 18128, 18362, 18594, 18825, 19053, 19280, 19505,
+	19728
+};
+
+/// @brief log10(x) for integer x > 0 (x = 0 is treated as 1)
+/// exponent from CLZ, mantissa from 64-entry LUT with linear interpolation
+inline q16
+log10(uint32_t x) {
+	if ( x == 0 )	x	= 1;
+
+	const uint8_t
+	n		= 31 - __builtin_clz(x);			// integer part of log2(x)
+	const uint32_t
+	m		= x << (31 - n);					// mantissa, leading 1 at bit 31
+	const uint8_t
+	idx		= (m >> 25) & 0x3F;					// next 6 bits -> LUT index
+	const int32_t
+	frac	= (m >> 9) & 0xFFFF;				// next 16 bits -> interpolation
+
+	const int32_t
+	lo		= log10Lut[idx],
+	hi		= log10Lut[idx + 1];
+
+	return n * LOG10_2 + lo + (((hi - lo) * frac) >> 16);
+}
+
+/// @brief square root of a non-negative Q16.16 (bit by bit, no division)
+inline q16
+sqrt(uint32_t v) {
+	uint64_t
+	x		= static_cast<uint64_t>(v) << 16,
+	r		= 0,
+	bit		= 1ULL << 62;
+	while ( bit > x )	bit >>= 2;
+	while ( bit ) {
+		if ( x >= r + bit ) {
+			x	-= r + bit;
+			r	= (r >> 1) + bit;
+		} else {
+			r	>>= 1;
+		}
+		bit	>>= 2;
+	}
+	return static_cast<q16>(r);
+}
+
+/// @brief Horner evaluation of c[0] + c[1]*x + ... + c[n-1]*x^(n-1)
+inline q16
+poly(const q16* c, uint8_t n, q16 x) {
+	int64_t
+	acc		= 0;
+	while ( n-- ) {
+		acc	= ((acc * x) >> 16) + c[n];
+	}
+	return static_cast<q16>(acc);
+}
+
+/// @brief parse a decimal ("-1.25", "3", ".5") into Q16.16
+/// @return false on invalid characters
+inline bool
+parse(const char* s, q16& out) {
+	bool		neg		= false;
+	int64_t		whole	= 0;
+	int64_t		frac	= 0;
+	int64_t		scale	= 1;
+	bool		digits	= false;
+
+	if ( *s == '-' || *s == '+' ) {
+		neg	= ( *s == '-' );
+		++s;
+	}
+	while ( *s >= '0' && *s <= '9' ) {
+		whole	= whole * 10 + (*s++ - '0');
+		digits	= true;
+		if ( whole > 32767 )	return false;
+	}
+	if ( *s == '.' ) {
+		++s;
+		while ( *s >= '0' && *s <= '9' ) {
+			if ( scale < 100000 ) {
+				frac	= frac * 10 + (*s - '0');
+				scale	*= 10;
+			}
+			++s;
+			digits	= true;
+		}
+	}
+	if ( *s || !digits )	return false;
+
+	int64_t
+	v		= (whole << 16) + ((frac << 16) + scale / 2) / scale;
+	out		= static_cast<q16>(neg ? -v : v);
+	return true;
+}
+
+/// @brief parse a comma separated list ("1.5,-2,0.25") into Q16.16
+/// @return number of values, or -1 on error / too many values
+inline int8_t
+parseList(const char* s, q16* out, uint8_t max) {
+	char		buf[16];
+	uint8_t		n	= 0;
+
+	while ( n < max ) {
+		uint8_t
+		len		= 0;
+		while ( *s && *s != ',' && len < sizeof(buf) - 1 )
+			buf[len++]	= *s++;
+		buf[len]	= '\0';
+
+		if ( !parse(buf, out[n++]) )	return -1;
+		if ( *s == '\0' )				return n;
+		if ( *s++ != ',' )				return -1;
+	}
+	return -1;
+}
+
+}	// namespace fixed
+// ----------------------------------------------------------------------------
+
+#endif	// FIXED_HPP
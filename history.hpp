@@ -0,0 +1,149 @@
+// ----------------------------------------------------------------------------
+
+#ifndef HISTORY_HPP
+#define HISTORY_HPP
+
+#include <stdint.h>
+
+#include <codec.hpp>
+// ----------------------------------------------------------------------------
+
+/// @brief Ring buffer of the last `Capacity` samples of one sensor
+///
+/// The oldest sample is overwritten when full. While locked (a dump is
+/// reading it) new samples are dropped and counted instead.
+template < uint8_t Channels, uint16_t Capacity >
+class History {
+public:
+	struct Record {
+		uint32_t		ms;						// modm::Clock time of the sample
+		uint16_t		ch[Channels];
+	};
+
+	History():
+		_head(0),
+		_size(0),
+		_dropped(0),
+		_locked(false)			{
+	}
+
+	void
+	push(const uint16_t (&x)[Channels], uint32_t ms) {
+		if ( _locked ) {
+			++_dropped;
+			return;
+		}
+		Record&
+		r		= _ring[_head];
+		r.ms	= ms;
+		for (uint8_t i = 0; i < Channels; ++i)	r.ch[i] = x[i];
+
+		_head	= ( _head + 1 == Capacity ) ? 0 : _head + 1;
+		if ( _size < Capacity )	++_size;
+	}
+
+	/// @param i 0 = oldest
+	const Record&
+	at(uint16_t i) const		{
+		uint16_t
+		idx		= _head + Capacity - _size + i;
+		if ( idx >= Capacity )	idx -= Capacity;
+		if ( idx >= Capacity )	idx -= Capacity;
+		return _ring[idx];
+	}
+
+	uint16_t
+	size() const				{ return _size; }
+
+	static constexpr uint16_t
+	capacity()					{ return Capacity; }
+
+	static constexpr uint8_t
+	channels()					{ return Channels; }
+
+	void
+	clear()						{
+		_head		= 0;
+		_size		= 0;
+		_dropped	= 0;
+	}
+
+	void
+	lock(bool locked)			{ _locked = locked; }
+
+	uint32_t
+	dropped() const				{ return _dropped; }
+
+private:
+	Record			_ring[Capacity];
+	uint16_t		_head;						// next write position
+	uint16_t		_size;
+	uint32_t		_dropped;					// samples lost while locked
+	bool			_locked;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Incremental 'dump' of a History (see codec.hpp for the format)
+///
+/// step() encodes one block straight into the output stream, so a dump
+/// never needs a transfer buffer and the sensor threads keep running
+/// between records. The history is locked for the duration.
+class HistoryDumpBase {
+public:
+	virtual
+	~HistoryDumpBase()			= default;
+
+	virtual void
+	start()						= 0;
+
+	/// @return false when the dump is finished
+	virtual bool
+	step()						= 0;
+};
+
+template < typename H, typename Out >
+class HistoryDump: public HistoryDumpBase {
+public:
+	HistoryDump(H& history, Out& out, const char* name):
+		_history(history),
+		_out(out),
+		_name(name),
+		_crc(0xFFFF),
+		_encoder(history)		{
+	}
+
+	void
+	start() override			{
+		_history.lock(true);
+		_encoder.start(_history.size());
+		_crc	= 0xFFFF;
+		_out.printf("DUMP v1 %s n=%u ch=%u dropped=%u\n", _name,
+				static_cast<unsigned int>(_history.size()), static_cast<unsigned int>(H::channels()),
+				static_cast<unsigned int>(_history.dropped()));
+	}
+
+	bool
+	step() override				{
+		if ( !_encoder.done() ) {
+			_encoder.step([this](uint8_t b) {
+				_crc	= codec::crc16(_crc, b);
+				_out.write(static_cast<char>(b));
+			});
+			return true;
+		}
+		_out.printf("\nEND %04x\n", static_cast<unsigned int>(_crc));
+		_history.lock(false);
+		return false;
+	}
+
+private:
+	H&				_history;
+	Out&			_out;
+	const char*		_name;
+	uint16_t		_crc;
+	codec::BlockEncoder<H::channels(), H>
+					_encoder;
+};
+// ----------------------------------------------------------------------------
+
+#endif	// HISTORY_HPP
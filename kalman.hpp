@@ -0,0 +1,164 @@
+// ----------------------------------------------------------------------------
+
+#ifndef KALMAN_HPP
+#define KALMAN_HPP
+
+#include <stdint.h>
+
+#include <fixed.hpp>
+// ----------------------------------------------------------------------------
+
+/// @brief Concentration tracking: a scalar Kalman filter per analyte
+///
+/// The concentration is modelled as a random walk: between two readings
+/// its variance p grows by the process noise q (conc^2 per s), a reading z
+/// with the measurement noise r of its source pulls the estimate by the
+/// gain k = p / (p + r) and shrinks p by (1 - k). The readings of several
+/// sources of an analyte (UV curve, unmixing) update the same estimate one
+/// after the other, each with its own r.
+///
+/// r is set from the CLI or estimated per source: half the mean squared
+/// difference of successive readings (exponential, 1/16), the noise of a
+/// signal that changes slowly against the sampling rate. It follows a
+/// change of the integration time by itself; once settled, a difference
+/// counts as 4 r (but at least R_MIN) at most, so a step of the
+/// concentration does not make the filter slow right when it has to follow,
+/// and an r of 0 learnt from identical first readings still grows.
+///
+/// Everything is Q16.16 (p and r unsigned, conc^2), the state of an
+/// analyte is 16 bytes plus 8 per source, an update is a few 64-bit
+/// multiplies and one division.
+class KalmanFilter {
+public:
+	enum { MAX_ANALYTES = 4 };
+
+	enum Source: uint8_t {
+		Uv,											// VEML6070 via the selected curve
+		Unmix,										// multi-wavelength unmixing
+		SOURCES
+	};
+
+	struct Estimate {
+		fixed::q16		x;							// concentration
+		uint32_t		p;							// its variance
+		uint32_t		ms;							// of the last reading
+		uint32_t		n;							// readings
+	};
+
+	/// q default: 0.001 conc^2/s (a drift of 0.03 per s^1/2)
+	static constexpr fixed::q16	PROCESS	= fixed::ONE / 1024;
+
+public:
+
+	KalmanFilter():
+		enabled(false)			{
+		for (uint8_t j = 0; j < MAX_ANALYTES; ++j) {
+			process[j]	= PROCESS;
+			noise[j]	= 0;
+		}
+		reset();
+	}
+
+	/// @brief forget the estimates and the learnt noise
+	void
+	reset()						{
+		for (uint8_t j = 0; j < MAX_ANALYTES; ++j) {
+			_estimates[j]	= {0, 0, 0, 0};
+			for (uint8_t s = 0; s < SOURCES; ++s)	_readings[j][s] = {0, 0, 0};
+		}
+	}
+
+	/// @brief one reading z of analyte j at ms
+	void
+	update(uint8_t j, Source s, fixed::q16 z, uint32_t ms) {
+		if ( j >= MAX_ANALYTES )	return;
+		Estimate&
+		e		= _estimates[j];
+		Reading&
+		m		= _readings[j][s];
+
+		// measurement noise from the successive differences
+		if ( m.n ) {
+			const int64_t
+			d		= static_cast<int64_t>(z) - m.last;
+			const uint64_t
+			a		= ( d < 0 ) ? -d : d;
+			uint64_t										// Q16, d^2 / 2
+			half	= ( a < ( 1ULL << 24 ) ) ? ( a * a ) >> 17 : UINT32_MAX;
+			const uint64_t
+			clip	= ( 4ULL * m.r > R_MIN ) ? 4ULL * m.r : static_cast<uint64_t>(R_MIN);
+			if ( m.n > SETTLE && half > clip )	half = clip;
+			const int64_t
+			r		= ( m.n == 1 ) ? static_cast<int64_t>(half) :
+					  m.r + ( static_cast<int64_t>(half) - m.r ) / 16;
+			m.r		= saturate(r);
+		}
+		m.last	= z;
+		if ( m.n < UINT16_MAX )	++m.n;
+		const uint32_t
+		r		= noise[j] ? noise[j] : ( m.r ? m.r : 1 );
+
+		if ( e.n == 0 ) {
+			e.x		= z;
+			e.p		= UNKNOWN;						// no noise known yet
+		} else if ( e.p == UNKNOWN ) {
+			e.x		= z;
+			e.p		= r;
+		} else {
+			// predict: random walk since the last reading
+			uint64_t
+			p		= e.p + static_cast<uint64_t>(process[j]) * ( ms - e.ms ) / 1000;
+			if ( p > UNKNOWN )	p = UNKNOWN;
+			// update
+			const int64_t
+			k		= static_cast<int64_t>(( p << 16 ) / ( p + r ));	// Q16, 0..1
+			e.x		+= static_cast<fixed::q16>(( k * ( static_cast<int64_t>(z) - e.x ) ) >> 16);
+			e.p		= saturate(static_cast<int64_t>(( ( fixed::ONE - k ) * p ) >> 16));
+		}
+		e.ms	= ms;
+		++e.n;
+	}
+
+	const Estimate&
+	estimate(uint8_t j) const	{ return _estimates[j]; }
+
+	/// @brief standard deviation of the estimate, Q16.16
+	fixed::q16
+	deviation(uint8_t j) const	{ return fixed::sqrt(_estimates[j].p); }
+
+	/// @brief measurement noise learnt for a source (variance), Q16.16
+	uint32_t
+	learnt(uint8_t j, Source s) const	{ return _readings[j][s].r; }
+
+	/// @brief readings of a source so far
+	uint16_t
+	readings(uint8_t j, Source s) const	{ return _readings[j][s].n; }
+
+private:
+	enum : uint32_t {
+		UNKNOWN		= UINT32_MAX,
+		SETTLE		= 8,							// readings before the differences are clipped
+		R_MIN		= fixed::ONE / 256				// clip at least, Q16 conc^2 (1/16 conc deviation)
+	};
+
+	/// last reading of a source and its noise
+	struct Reading {
+		fixed::q16		last;
+		uint32_t		r;							// variance, Q16.16
+		uint16_t		n;
+	};
+
+	static uint32_t
+	saturate(int64_t v)			{ return ( v < 0 ) ? 0 : ( v > UINT32_MAX ) ? UINT32_MAX : static_cast<uint32_t>(v); }
+
+	Estimate		_estimates[MAX_ANALYTES];
+	Reading			_readings[MAX_ANALYTES][SOURCES];
+
+public:
+	bool			enabled;
+	fixed::q16		process[MAX_ANALYTES];			// q, conc^2/s
+	uint32_t		noise[MAX_ANALYTES];			// r, conc^2, 0 = learnt per source
+};
+// ----------------------------------------------------------------------------
+
+#endif	// KALMAN_HPP
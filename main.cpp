@@ -20,6 +20,24 @@
 
 #include <modm/architecture/interface/gpio.hpp>
 #include <cli.hpp>
+#include <concentration.hpp>
+#include <unmixing.hpp>
+#include <kalman.hpp>
+#include <stats.hpp>
+#include <alarm.hpp>
+#include <veml6070_ara.hpp>
+#include <tcs3472_registers.hpp>
+#include <history.hpp>
+#include <bus.hpp>
+#include <memory.hpp>
+#include <rate.hpp>
+#include <power.hpp>
+#include <scale.hpp>
+#include <baseline.hpp>
+#include <derived.hpp>
+#include <timing.hpp>
+#include <trace.hpp>
+#include <script.hpp>
 
 using namespace modm::literals;
 
@@ -50,6 +68,18 @@ Cli		cli(modm::log::info);
 Tcs		tcsCmd(cli);
 V6040	v6040Cmd(cli);
 V6070	v6070Cmd(cli);
+Unmix	unmixCmd(cli);
+Stats	statsCmd(cli);
+Alarm	alarmCmd(cli);
+Report	reportCmd(cli);
+Dump	dumpCmd(cli);
+Mem		memCmd(cli);
+Rate	rateCmd(cli);
+Loop	loopCmd(cli);
+Trace	traceCmd(cli);
+Power	powerCmd(cli);
+Script	scriptCmd(cli);
+Kalman	kalmanCmd(cli);
 // ----------------------------------------------------------------------------
 
 #define PT_CASE(x)					\
@@ -58,12 +88,1025 @@ V6070	v6070Cmd(cli);
 	modm_fallthrough;				\
 	case __LINE__:					\
 
+// resume at the PT_CASE(x) label with the next update()
 #define PT_CASE_SET(x) ({			\
 	this->ptState	= x;			\
-	break;							\
+	return true;					\
 })
 // ----------------------------------------------------------------------------
 
+// fixed-point (Q16.16 by default) as "<label>[-]int.frac"
+void
+printFixed(const char* label, int64_t v, uint8_t frac = 16) {
+	const int32_t	m	= fixed::toMilli(v, frac);
+	stream.printf("%s%s%d.%03d", label, (m < 0) ? "-" : "", int(labs(m) / 1000), int(labs(m) % 1000));
+}
+
+// a whole decimal number of an option, -1 if it is not one ("", "abc", "1x")
+int
+parseIndex(const char* s) {
+	char*
+	end;
+	const long
+	v		= strtol(s, &end, 10);
+	return ( end == s || *end || v < 0 || v > INT16_MAX ) ? -1 : static_cast<int>(v);
+}
+
+// a whole decimal number of an option in 0..max into v, an option not given
+// leaves v as it is; false if it is not one ("abc", "1x", "-1", too large)
+template < typename S >
+bool
+parseNumber(const S& option, uint32_t max, uint32_t& v) {
+	if ( option.empty() )	return true;
+	const char*
+	s		= option.c_str();
+	uint32_t
+	x		= 0;
+	do {
+		const uint32_t
+		d		= static_cast<uint32_t>(*s - '0');
+		if ( *s < '0' || *s > '9' || d > max || x > ( max - d ) / 10 )	return false;
+		x		= x * 10 + d;
+	} while ( *++s );
+	v		= x;
+	return true;
+}
+// ----------------------------------------------------------------------------
+
+Reporting	report;
+static_assert(Reporting().fields == derived::DEFAULT, "alarm.hpp keeps the default of derived.hpp");
+
+const char* const	tcsChannels[4]		= {"R", "G", "B", "C"};
+const char* const	v6040Channels[4]	= {"R", "G", "B", "W"};
+const char* const	v6070Channels[1]	= {"UV"};
+// ----------------------------------------------------------------------------
+
+Unmixing	unmixing;
+KalmanFilter	kalman;
+
+// "Kalman: <j> <estimate> <deviation> ..." of the analytes in mask, after
+// their update
+void
+kalmanPrint(uint8_t mask) {
+	if ( !report.streaming() )	return;
+	stream << "Kalman:";
+	for (uint8_t j = 0; j < KalmanFilter::MAX_ANALYTES; ++j) {
+		if ( !( mask & ( 1 << j ) ) )	continue;
+		stream.printf(" %u", j);
+		printFixed(" ", kalman.estimate(j).x);
+		printFixed(" ", kalman.deviation(j));
+	}
+	stream << "\n";
+}
+
+struct {
+	bool			blank		= false;	// next feature vector is the blank
+	int8_t			standard	= -1;		// next feature vector is this analyte...
+	fixed::q16		conc		= 0;		// ...at this concentration
+} unmixPending;
+
+// called by the sample consumers after feeding their channels
+void
+unmixUpdate(uint32_t ms) {
+	if ( !unmixing.ready() )	return;
+
+	// a capture asked for before a dump waits for its end, as its message
+	if ( unmixPending.blank && !report.binary ) {
+		unmixing.captureBlank();
+		unmixPending.blank	= false;
+		stream << "Unmix: blank taken" << modm::endl;
+	}
+	if ( unmixPending.standard >= 0 && !report.binary ) {
+		if ( unmixing.captureStandard(unmixPending.standard, unmixPending.conc) ) {
+			stream.printf("Unmix: standard %d taken\n", unmixPending.standard);
+			if ( unmixing.isCalibrated() && !unmixing.solve() )
+				stream << "Unmix: absorptivity matrix is singular" << modm::endl;
+		} else {
+			stream << "Unmix: standard rejected (blank missing?)" << modm::endl;
+		}
+		unmixPending.standard	= -1;
+	}
+
+	if ( unmixing.isSolved() && ( ( unmixing.enabled && report.streaming() ) || kalman.enabled ) ) {
+		fixed::q16	c[Unmixing::MAX_ANALYTES];
+		unmixing.unmix(c);
+		if ( unmixing.enabled && report.streaming() ) {
+			stream << "Unmix:";
+			for (uint8_t j = 0; j < unmixing.analytes(); ++j)
+				printFixed(" ", c[j]);
+			stream << "\n";
+		}
+		if ( kalman.enabled ) {
+			for (uint8_t j = 0; j < unmixing.analytes(); ++j)
+				kalman.update(j, KalmanFilter::Unmix, c[j], ms);
+			kalmanPrint(( 1 << unmixing.analytes() ) - 1);
+		}
+	}
+}
+
+Statistics<4>	tcsStats;
+Statistics<4>	v6040Stats;
+Statistics<1>	v6070Stats;
+
+template < uint8_t N >
+void
+printStats(const char* name, const char* const (&channels)[N], const Statistics<N>& st) {
+	const typename Statistics<N>::Window*
+	windows[2]	= { st.last(), &st.current() };
+
+	for (const auto* w : windows) {
+		if ( w == nullptr )	continue;
+		stream.printf("%s %s: count %u", name, (w == &st.current()) ? "now" : "last",
+				static_cast<unsigned int>(w->count));
+		printFixed(" rate ", w->rate(), RunningStat::FRAC);
+		stream << "/s\n";
+		for (uint8_t i = 0; i < N; ++i) {
+			const RunningStat&
+			c	= w->ch[i];
+			stream.printf("  %s", channels[i]);
+			printFixed(" mean ", c.mean(), RunningStat::FRAC);
+			printFixed(" sd ", c.stddev(w->count), RunningStat::FRAC);
+			stream.printf(" min %5u max %5u\n", c.min(), c.max());
+		}
+	}
+}
+
+// 'stats' only reads/resets the accumulators, handled right in the main loop
+void
+statsCommand() {
+	statsCmd.getOptions();
+	if ( statsCmd.failed() )	return;
+
+	const bool
+	all		= ( statsCmd.sensor == "all" ),
+	tcs		= all || ( statsCmd.sensor == "tcs" ),
+	v6040	= all || ( statsCmd.sensor == "v6040" ),
+	v6070	= all || ( statsCmd.sensor == "v6070" );
+
+	if ( !tcs && !v6040 && !v6070 ) {
+		stream << "Invalid sensor name" << modm::endl;
+		return;
+	}
+
+	const uint32_t
+	now		= modm::Clock::now().getTime();
+
+	if ( !statsCmd.swindow.empty() ) {
+		uint32_t
+		n		= 0;
+		if ( !parseNumber(statsCmd.swindow, UINT32_MAX, n) ) {
+			stream << "Invalid value of option 'window'" << modm::endl;
+			return;
+		}
+		if ( tcs )		tcsStats	.setWindow(n, now);
+		if ( v6040 )	v6040Stats	.setWindow(n, now);
+		if ( v6070 )	v6070Stats	.setWindow(n, now);
+	} else if ( statsCmd.reset ) {
+		if ( tcs )		tcsStats	.reset(now);
+		if ( v6040 )	v6040Stats	.reset(now);
+		if ( v6070 )	v6070Stats	.reset(now);
+	} else {
+		if ( tcs )		printStats("TCS34725",	tcsChannels,	tcsStats);
+		if ( v6040 )	printStats("VEML6040",	v6040Channels,	v6040Stats);
+		if ( v6070 )	printStats("VEML6070",	v6070Channels,	v6070Stats);
+	}
+}
+
+Alarms<4>		tcsAlarms;
+Alarms<4>		v6040Alarms;
+Alarms<1>		v6070Alarms;
+
+// printed in every report mode
+void
+alarmEvent(const char* name, const char* channel, uint16_t value, Threshold::Event e) {
+	static const char* const
+	events[]	= {"", "high", "low", "clear"};
+	if ( report.binary )	return;
+	stream.printf("Alarm: %s %s %s %5u\n", name, channel, events[static_cast<uint8_t>(e)], value);
+}
+
+template < uint8_t N >
+void
+printLatest(const char* name, const char* const (&channels)[N], const Alarms<N>& al) {
+	stream.printf(" %s%s", name, al.active() ? "!" : "");
+	for (uint8_t i = 0; i < N; ++i)
+		stream.printf(" %s %u", channels[i], al.last[i]);
+}
+
+// events mode: latest samples and alarm states, so the host knows we are alive
+void
+heartbeat() {
+	if ( report.binary )	return;
+	stream.printf("Heartbeat: %u s", static_cast<unsigned int>(modm::Clock::now().getTime() / 1000));
+	printLatest("tcs",		tcsChannels,	tcsAlarms);
+	printLatest("v6040",	v6040Channels,	v6040Alarms);
+	printLatest("v6070",	v6070Channels,	v6070Alarms);
+	stream << "\n";
+}
+
+template < uint8_t N >
+bool
+alarmConfigure(const char* const (&channels)[N], Alarms<N>& al) {
+	for (uint8_t i = 0; i < N; ++i) {
+		if ( alarmCmd.channel != channels[i] )	continue;
+
+		Threshold&
+		th		= al.ch[i];
+		if ( alarmCmd.off ) {
+			th.enabled	= false;
+			th.reset();
+			return true;
+		}
+		uint32_t
+		high		= th.high,
+		low			= th.low,
+		hysteresis	= th.hysteresis,
+		debounce	= th.debounce;
+		if ( !parseNumber(alarmCmd.shigh, UINT16_MAX, high) || !parseNumber(alarmCmd.slow, UINT16_MAX, low) ||
+			 !parseNumber(alarmCmd.shyst, UINT16_MAX, hysteresis) ||
+			 !parseNumber(alarmCmd.sdebounce, UINT8_MAX, debounce) || low > high ) {
+			stream << "Invalid value" << modm::endl;	// nothing applied
+			return true;
+		}
+		th.high			= high;
+		th.low			= low;
+		th.hysteresis	= hysteresis;
+		th.debounce		= debounce;
+		th.enabled		= true;
+		th.reset();
+		return true;
+	}
+	return false;
+}
+
+void
+alarmCommand() {
+	alarmCmd.getOptions();
+	if ( alarmCmd.failed() )	return;
+
+	bool
+	ok		= false;
+	if ( alarmCmd.sensor == "tcs" )			ok = alarmConfigure(tcsChannels,	tcsAlarms);
+	else if ( alarmCmd.sensor == "v6040" )	ok = alarmConfigure(v6040Channels,	v6040Alarms);
+	else if ( alarmCmd.sensor == "v6070" )	ok = alarmConfigure(v6070Channels,	v6070Alarms);
+
+	if ( !ok ) {
+		stream << "Invalid sensor or channel name" << modm::endl;
+	}
+}
+
+void
+reportCommand() {
+	reportCmd.getOptions();
+	if ( reportCmd.failed() )	return;
+
+	if ( !reportCmd.mode.empty() ) {
+			   if ( reportCmd.mode == "stream" ) {
+			report.mode	= Reporting::Mode::Stream;
+		} else if ( reportCmd.mode == "events" ) {
+			report.mode	= Reporting::Mode::Events;
+		} else {
+			stream << "Invalid report mode" << modm::endl;
+		}
+	}
+	uint32_t
+	heartbeat	= report.heartbeat;
+	if ( parseNumber(reportCmd.sheartbeat, UINT16_MAX, heartbeat) ) {
+		report.heartbeat	= heartbeat;
+	} else {
+		stream << "Invalid value of option 'heartbeat'" << modm::endl;
+	}
+	if ( !reportCmd.sunits.empty() ) {
+			   if ( reportCmd.sunits == "raw" ) {
+			report.normalised	= false;
+		} else if ( reportCmd.sunits == "norm" ) {
+			report.normalised	= true;
+		} else {
+			stream << "Invalid value of option 'units'" << modm::endl;
+		}
+	}
+	if ( !reportCmd.sfields.empty() ) {
+		const uint8_t
+		fields	= derived::parse(reportCmd.sfields.c_str());
+		if ( fields & derived::Counts ) {				// the host tools read the counts
+			report.fields	= fields;
+		} else {
+			stream << "Invalid value of option 'fields' (counts[,hue,sat,value])" << modm::endl;
+		}
+	}
+}
+
+// sample history for 'dump' (8 KiB of RAM)
+History<4, 256>	tcsHistory;
+History<4, 256>	v6040History;
+History<1, 256>	v6070History;
+
+HistoryDump<decltype(tcsHistory),	modm::IOStream>	tcsDump		(tcsHistory,	stream, "tcs");
+HistoryDump<decltype(v6040History),	modm::IOStream>	v6040Dump	(v6040History,	stream, "v6040");
+HistoryDump<decltype(v6070History),	modm::IOStream>	v6070Dump	(v6070History,	stream, "v6070");
+
+// event trace for 'trace dump' (trace.hpp)
+trace::Dump<decltype(trace::ring), modm::IOStream>	traceDump	(trace::ring, stream);
+
+HistoryDumpBase*	dumping		= nullptr;		// running dump, stepped by the main loop
+
+// @return true if a dump was started (the prompt follows when it is done)
+bool
+dumpCommand() {
+	dumpCmd.getOptions();
+	if ( dumpCmd.failed() )	return false;
+
+	if ( dumpCmd.sensor == "tcs" ) {
+		if ( dumpCmd.clear )	tcsHistory.clear();
+		else					dumping = &tcsDump;
+	} else if ( dumpCmd.sensor == "v6040" ) {
+		if ( dumpCmd.clear )	v6040History.clear();
+		else					dumping = &v6040Dump;
+	} else if ( dumpCmd.sensor == "v6070" ) {
+		if ( dumpCmd.clear )	v6070History.clear();
+		else					dumping = &v6070Dump;
+	} else {
+		stream << "Invalid sensor name" << modm::endl;
+	}
+
+	if ( dumping == nullptr )	return false;
+	stream << modm::endl;
+	report.binary	= true;
+	cli.hold(true);
+	dumping->start();
+	return true;
+}
+
+// 'trace': what the event trace holds, 'trace dump' is stepped like a
+// history dump
+// @return true if a dump was started (the prompt follows when it is done)
+bool
+traceCommand() {
+	traceCmd.getOptions();
+	if ( traceCmd.failed() )	return false;
+
+	if ( traceCmd.action == "clear" ) {
+		trace::ring.clear();
+		return false;
+	}
+	if ( traceCmd.action == "dump" ) {
+		dumping	= &traceDump;
+		stream << modm::endl;
+		report.binary	= true;
+		cli.hold(true);
+		dumping->start();
+		return true;
+	}
+	stream.printf("Trace events %u kept %u of %u dropped %u hz %u%s\n",
+			static_cast<unsigned int>(trace::ring.recorded()), static_cast<unsigned int>(trace::ring.size()),
+			static_cast<unsigned int>(trace::ring.capacity()), static_cast<unsigned int>(trace::ring.dropped()),
+			static_cast<unsigned int>(trace::ring.hz()), TRACE_ENABLED ? "" : " (compiled out)");
+	return false;
+}
+
+// 'kalman': the estimates, or the settings of one analyte (--analyte) or all;
+// the noises are given and printed as standard deviations, the filter
+// takes their squares
+void
+kalmanCommand() {
+	kalmanCmd.getOptions();
+	if ( kalmanCmd.failed() )	return;
+
+	uint8_t
+	first	= 0,
+	last	= KalmanFilter::MAX_ANALYTES - 1;
+	if ( !kalmanCmd.sanalyte.empty() ) {
+		const int
+		j		= parseIndex(kalmanCmd.sanalyte.c_str());
+		if ( j < 0 || j >= KalmanFilter::MAX_ANALYTES ) {
+			stream << "Invalid value of option 'analyte'" << modm::endl;
+			return;
+		}
+		first	= last = j;
+	}
+
+	if ( kalmanCmd.changes() ) {
+		fixed::q16
+		q		= 0,
+		r		= 0;
+		if ( !kalmanCmd.sprocess.empty() && ( !fixed::parse(kalmanCmd.sprocess.c_str(), q) || q < 0 ) ) {
+			stream << "Invalid value of option 'process'" << modm::endl;
+			return;
+		}
+		if ( !kalmanCmd.snoise.empty() && kalmanCmd.snoise != "auto" &&
+			 ( !fixed::parse(kalmanCmd.snoise.c_str(), r) || r <= 0 ) ) {
+			stream << "Invalid value of option 'noise'" << modm::endl;
+			return;
+		}
+		for (uint8_t j = first; j <= last; ++j) {
+			if ( !kalmanCmd.sprocess.empty() )	kalman.process[j]	= fixed::mul(q, q);
+			if ( !kalmanCmd.snoise.empty() )	kalman.noise[j]		= fixed::mul(r, r);
+		}
+		if ( kalmanCmd.reset )	kalman.reset();
+		if ( kalmanCmd.on )		kalman.enabled	= true;
+		if ( kalmanCmd.off )	kalman.enabled	= false;
+		return;
+	}
+
+	stream.printf("Kalman %s\n", kalman.enabled ? "on" : "off");
+	for (uint8_t j = first; j <= last; ++j) {
+		const KalmanFilter::Estimate&
+		e		= kalman.estimate(j);
+		stream.printf("Kalman %u: n %u", j, static_cast<unsigned int>(e.n));
+		if ( e.n ) {
+			printFixed(" x ", e.x);
+			printFixed(" sd ", kalman.deviation(j));
+		}
+		printFixed(" process ", fixed::sqrt(kalman.process[j]));
+		if ( kalman.noise[j] ) {
+			printFixed(" noise ", fixed::sqrt(kalman.noise[j]));
+		} else {
+			printFixed(" noise auto uv ", fixed::sqrt(kalman.learnt(j, KalmanFilter::Uv)));
+			printFixed(" unmix ", fixed::sqrt(kalman.learnt(j, KalmanFilter::Unmix)));
+		}
+		stream << "\n";
+	}
+}
+
+// 'unmix' is not bound to a sensor thread, it is handled right in the main loop
+void
+unmixCommand() {
+	unmixCmd.getOptions();
+	if ( unmixCmd.failed() )	return;
+
+	if ( !unmixCmd.sanalytes.empty() ) {
+		const int
+		n		= parseIndex(unmixCmd.sanalytes.c_str());
+		if ( n < 0 || !unmixing.setAnalytes(n) )
+			stream << "Invalid value of option 'analytes'" << modm::endl;
+	}
+	if ( !unmixCmd.ssource.empty() ) {
+			   if ( unmixCmd.ssource == "tcs" ) {
+			unmixing.source	= Unmixing::Source::Tcs;
+		} else if ( unmixCmd.ssource == "v6040" ) {
+			unmixing.source	= Unmixing::Source::V6040;
+		} else {
+			stream << "Invalid value of option 'source'" << modm::endl;
+		}
+	}
+	if ( unmixCmd.blank ) {
+		unmixPending.blank	= true;
+	}
+	if ( !unmixCmd.sstandard.empty() ) {
+		const int
+		j		= parseIndex(unmixCmd.sstandard.c_str());
+		if ( j < 0 || j >= unmixing.analytes() ) {
+			stream << "Invalid value of option 'standard'" << modm::endl;
+		} else if ( !unmixCmd.sabsorptivity.empty() ) {
+			fixed::q16	e[Unmixing::CHANNELS];
+			if ( fixed::parseList(unmixCmd.sabsorptivity.c_str(), e, Unmixing::CHANNELS) != Unmixing::CHANNELS ) {
+				stream << "Invalid value of option 'absorptivity'" << modm::endl;
+			} else {
+				unmixing.setColumn(j, e);
+				if ( unmixing.isCalibrated() && !unmixing.solve() )
+					stream << "Unmix: absorptivity matrix is singular" << modm::endl;
+			}
+		} else if ( !fixed::parse(unmixCmd.sconc.c_str(), unmixPending.conc) || unmixPending.conc <= 0 ) {
+			stream << "Invalid value of option 'conc'" << modm::endl;
+		} else {
+			unmixPending.standard	= j;
+		}
+	}
+	if ( unmixCmd.on ) {
+		if ( !unmixing.isSolved() )
+			stream << "Unmix: not calibrated yet" << modm::endl;
+		unmixing.enabled	= true;
+	}
+	if ( unmixCmd.off ) {
+		unmixing.enabled	= false;
+	}
+}
+// ----------------------------------------------------------------------------
+
+// Sample bus: the sensor threads only acquire and publish, the consumers
+// below (statistics, history, alarms, unmixing, output) read the samples in
+// place, each with its own reader. Another consumer is another reader.
+
+struct RgbwSample {
+	uint32_t		ms;
+	uint16_t		ch[4];						// R, G, B, C|W
+	uint32_t		factor;						// raw -> common unit (scale.hpp)
+	derived::Rgbw	derived;					// HSV..., computed when asked for
+};
+
+struct UvSample {
+	uint32_t		ms;
+	uint16_t		ch[1];
+	uint32_t		factor;
+	derived::Uv		derived;					// absorbance..., computed when asked for
+};
+
+Channel<RgbwSample, 4>	tcsBus;
+Channel<RgbwSample, 4>	v6040Bus;
+Channel<UvSample, 4>	v6070Bus;
+
+struct {
+	Channel<RgbwSample, 4>::Reader	record, output;
+} tcsReaders, v6040Readers;
+
+struct {
+	Channel<UvSample, 4>::Reader	record, output;
+} v6070Readers;
+
+// owned by ThreadThree ('v6070' options, blank), used by the output
+Concentration	concentration;
+
+template < typename Colors >
+const RgbwSample&
+publishRgbw(Channel<RgbwSample, 4>& bus, const Colors& colors, uint32_t factor) {
+	RgbwSample&
+	s		= bus.claim();
+	s.ms	= modm::Clock::now().getTime();
+	s.factor	= factor;
+	s.ch[0]	= colors.red;
+	s.ch[1]	= colors.green;
+	s.ch[2]	= colors.blue;
+	s.ch[3]	= colors.white;
+	s.derived.invalidate();
+	bus.publish();
+	return s;								// unchanged until the next publish
+}
+
+// the fields of 'report --fields', "RGBW Hue: r g b w  hue" by default; a
+// derived value is computed here, if it is asked for
+void
+printRgbw(const char* name, const RgbwSample& s) {
+	if ( !report.streaming() )	return;
+	const uint8_t
+	fields	= report.fields;
+	stream << name << modm::endl;
+	const char*
+	separator	= "";
+	for (uint8_t f = 0; f < derived::FIELDS; ++f) {
+		if ( !( fields & ( 1 << f ) ) )	continue;
+		stream << separator << derived::labels[f];
+		separator	= " ";
+	}
+	stream << ":";
+	if ( fields & derived::Counts ) {
+		for (uint8_t i = 0; i < 4; ++i) {
+			if ( report.normalised )
+				stream.printf(" %5u", static_cast<unsigned int>(s.derived.normalised(s.ch, s.factor, i)));
+			else
+				stream.printf(" %5d", s.ch[i]);
+		}
+	}
+	if ( fields & derived::Hue )		stream.printf("  %5d", s.derived.hsv(s.ch).hue);
+	if ( fields & derived::Saturation )	stream.printf("  %5u", static_cast<unsigned int>(s.derived.hsv(s.ch).saturation));
+	if ( fields & derived::Value )		stream.printf("  %5u", static_cast<unsigned int>(s.derived.hsv(s.ch).value));
+	stream << "\n";
+}
+
+void
+consumeTcs() {
+	memory::Scope	scope(memory::Bus);				// and the output, each consumer its own
+
+	tcsBus.consume(tcsReaders.record, [](const RgbwSample& s) {
+		{
+			memory::Scope	scope(memory::Stats);
+			tcsStats.add(s.ch, s.ms);
+		}
+		{
+			memory::Scope	scope(memory::History);
+			tcsHistory.push(s.ch, s.ms);
+		}
+		{
+			memory::Scope	scope(memory::Alarms);
+			tcsAlarms.update(s.ch, [&s](uint8_t i, Threshold::Event e) {
+				alarmEvent("TCS34725", tcsChannels[i], s.ch[i], e);
+			});
+		}
+		if ( unmixing.source == Unmixing::Source::Tcs ) {
+			memory::Scope	scope(memory::Unmix);
+			unmixing.setRgbc(s.ch[0], s.ch[1], s.ch[2], s.ch[3]);
+			unmixUpdate(s.ms);
+		}
+	});
+	tcsBus.consume(tcsReaders.output, [](const RgbwSample& s) {
+		printRgbw("TCS34725", s);
+	});
+}
+
+void
+consumeV6040() {
+	memory::Scope	scope(memory::Bus);
+
+	v6040Bus.consume(v6040Readers.record, [](const RgbwSample& s) {
+		{
+			memory::Scope	scope(memory::Stats);
+			v6040Stats.add(s.ch, s.ms);
+		}
+		{
+			memory::Scope	scope(memory::History);
+			v6040History.push(s.ch, s.ms);
+		}
+		{
+			memory::Scope	scope(memory::Alarms);
+			v6040Alarms.update(s.ch, [&s](uint8_t i, Threshold::Event e) {
+				alarmEvent("VEML6040", v6040Channels[i], s.ch[i], e);
+			});
+		}
+		if ( unmixing.source == Unmixing::Source::V6040 ) {
+			memory::Scope	scope(memory::Unmix);
+			unmixing.setRgbc(s.ch[0], s.ch[1], s.ch[2], s.ch[3]);
+			unmixUpdate(s.ms);
+		}
+	});
+	v6040Bus.consume(v6040Readers.output, [](const RgbwSample& s) {
+		printRgbw("VEML6040", s);
+	});
+}
+
+void
+consumeV6070() {
+	memory::Scope	scope(memory::Bus);
+
+	v6070Bus.consume(v6070Readers.record, [](const UvSample& s) {
+		{
+			memory::Scope	scope(memory::Stats);
+			v6070Stats.add(s.ch, s.ms);
+		}
+		{
+			memory::Scope	scope(memory::History);
+			v6070History.push(s.ch, s.ms);
+		}
+		{
+			memory::Scope	scope(memory::Alarms);
+			v6070Alarms.update(s.ch, [&s](uint8_t i, Threshold::Event e) {
+				alarmEvent("VEML6070", v6070Channels[i], s.ch[i], e);
+			});
+		}
+		// unmixing and the concentration tracking fed by it
+		memory::Scope	scope(memory::Unmix);
+		unmixing.setUv(s.ch[0]);
+		unmixUpdate(s.ms);
+		// the reading of the selected curve's analyte, at full sensor rate
+		if ( kalman.enabled && concentration.hasBlank() ) {
+			const uint8_t
+			j		= concentration.analyte();
+			kalman.update(j, KalmanFilter::Uv, s.derived.concentration(s.ch[0], concentration), s.ms);
+			kalmanPrint(1 << j);
+		}
+	});
+	v6070Bus.consume(v6070Readers.output, [](const UvSample& s) {
+		if ( !report.streaming() )	return;
+		stream << "VEML6070" << modm::endl;
+		if ( concentration.output != Concentration::Output::Conc && report.normalised )
+			stream.printf("Uv: %5u", static_cast<unsigned int>(s.derived.normalised(s.ch[0], s.factor)));
+		else if ( concentration.output != Concentration::Output::Conc )
+			stream.printf("Uv: %5d", s.ch[0]);
+		if ( concentration.output != Concentration::Output::Raw && concentration.hasBlank() ) {
+			printFixed(" A: ", s.derived.absorbance(s.ch[0], concentration));
+			printFixed(" C: ", s.derived.concentration(s.ch[0], concentration));
+		} else if ( concentration.output == Concentration::Output::Conc ) {
+			stream << "C: no blank, take one with '--blank'";
+		}
+		stream << "\n";
+	});
+}
+// ----------------------------------------------------------------------------
+
+// Sampling intervals, set by 'rate', fed by the sensor threads with their samples
+
+AdaptiveRate<4>		tcsRate;
+AdaptiveRate<4>		v6040Rate;
+AdaptiveRate<1>		v6070Rate;
+
+// power gating of the sensors ('--power gated'), the reads of the gated ones
+// are lined up by gatedReads (indexed by trace::Sensor)
+power::Sensor		tcsPower;
+power::Sensor		v6040Power;
+power::Sensor		v6070Power;
+power::Group<trace::SENSORS>	gatedReads;
+
+// dark and blank baselines per setting ('--zero'), the sensor threads take
+// them and subtract the dark before publishing
+Baselines<4, scale::TCS_SETTINGS>	tcsZero;
+Baselines<4, scale::V6040_SETTINGS>	v6040Zero;
+Baselines<1, scale::V6070_SETTINGS>	v6070Zero;
+
+// main loop sections of the 'loop' report, the sensor threads are the tasks
+// whose wake lateness is measured
+enum LoopSection : uint8_t {
+	LOOP_CLI,									// input, global commands, dump
+	LOOP_TCS,									// thread and consumers
+	LOOP_V6040,
+	LOOP_V6070,
+	LOOP_OTHER,									// LED, heartbeat
+	LOOP_SECTIONS
+};
+
+const char* const	loopNames[LOOP_SECTIONS]	= { "cli", "tcs", "v6040", "v6070", "other" };
+timing::LoopMonitor<LOOP_SECTIONS>	mainLoop;
+
+/// @brief restart the sampling timeout of a thread for its next sample
+/// @return the scheduled wake time (ms) for mainLoop.wake()
+template < uint8_t N >
+uint32_t
+schedule(modm::ShortTimeout& timeout, const AdaptiveRate<N>& rate) {
+	const uint32_t
+	now		= modm::Clock::now().getTime();
+	const uint16_t
+	wait	= rate.wait(now);
+	timeout.restart(wait);
+	return now + wait;
+}
+
+/// @brief as above for a sensor that may be power gated: a gated one wakes
+/// up a window before its read. The reads of the gated sensors are lined
+/// up so that their wake windows overlap: with a fixed period and no phase
+/// they fall on phase 0 (commensurate periods read together), adaptive
+/// ones are pulled in to a read of another gated sensor up to a quarter of
+/// their interval before.
+template < uint8_t N >
+uint32_t
+schedule(modm::ShortTimeout& timeout, const AdaptiveRate<N>& rate, power::Sensor& p, trace::Sensor sensor) {
+	if ( !p.gated() ) {
+		gatedReads.drop(sensor);
+		return schedule(timeout, rate);
+	}
+	const uint32_t
+	now		= modm::Clock::now().getTime();
+	const typename AdaptiveRate<N>::Policy&
+	policy	= rate.policy();
+	uint32_t
+	readAt;
+	if ( policy.mode == AdaptiveRate<N>::Mode::Adaptive ) {
+		const uint16_t
+		wait	= rate.wait(now);
+		readAt	= gatedReads.align(sensor, now + p.window(), now + wait, wait / 4);
+	} else {
+		gatedReads.drop(sensor);
+		readAt	= now + ( ( policy.phase == AdaptiveRate<N>::FREE ) ? policy.period - now % policy.period : rate.wait(now) );
+	}
+	const uint32_t
+	wakeAt	= p.plan(now, readAt);
+	timeout.restart(static_cast<uint16_t>(wakeAt - now));
+	return wakeAt;
+}
+
+// integration time in ms, the shortest useful sampling interval
+uint16_t
+integrationMs(modm::tcs3472::IntegrationTime t) {
+	return (256 - static_cast<uint8_t>(t)) * 12 / 5;			// 2.4 ms per cycle
+}
+
+uint16_t
+integrationMs(modm::veml6040::IntegrationTime t) {
+	return 40 << (static_cast<uint8_t>(t) >> 4);
+}
+
+uint16_t
+integrationMs(modm::veml6070::IntegrationTime t) {
+	return (125 << (static_cast<uint8_t>(t) >> 2)) / 2;		// 62.5 ms at 1/2 T
+}
+
+template < uint8_t N >
+void
+printRate(const char* name, const AdaptiveRate<N>& r) {
+	const typename AdaptiveRate<N>::Policy&
+	p		= r.policy();
+	const bool
+	fixed	= ( p.mode == AdaptiveRate<N>::Mode::Fixed );
+	stream.printf("Rate %s: %s %u ms (%u/min), period %u", name, fixed ? "fixed" : "adaptive",
+			r.interval(), 60000u / r.interval(), p.period);
+	if ( p.phase == AdaptiveRate<N>::FREE )	stream << " phase free";
+	else									stream.printf(" phase %u", p.phase);
+	stream.printf(" min %u max %u slope %u noise %u hold %u\n", r.lowest(), p.max, p.slope, p.noise, p.hold);
+	stream.printf("  seen: slope %u/s variance %u\n",
+			static_cast<unsigned int>(r.lastSlope()), static_cast<unsigned int>(r.variance()));
+}
+
+template < uint8_t N >
+bool
+rateConfigure(AdaptiveRate<N>& r) {
+	typename AdaptiveRate<N>::Policy
+	p		= r.policy();
+	if ( rateCmd.fixed )		p.mode	= AdaptiveRate<N>::Mode::Fixed;
+	if ( rateCmd.adaptive )		p.mode	= AdaptiveRate<N>::Mode::Adaptive;
+	uint32_t
+	min		= p.min,
+	max		= p.max,
+	slope	= p.slope,
+	noise	= p.noise,
+	hold	= p.hold;
+	if ( !parseNumber(rateCmd.smin, UINT16_MAX, min) || !parseNumber(rateCmd.smax, UINT16_MAX, max) ||
+		 !parseNumber(rateCmd.sslope, UINT16_MAX, slope) || !parseNumber(rateCmd.snoise, UINT16_MAX, noise) ||
+		 !parseNumber(rateCmd.shold, UINT8_MAX, hold) ) {
+		stream << "Invalid value" << modm::endl;
+		return false;
+	}
+	p.min	= min;
+	p.max	= max;
+	p.slope	= slope;
+	p.noise	= noise;
+	p.hold	= hold;
+	if ( p.max == 0 || p.min > p.max || p.hold == 0 ) {
+		stream << "Invalid bounds or hold" << modm::endl;
+		return false;
+	}
+	r.setPolicy(p);
+	return true;
+}
+
+// --period / --phase of the sensor commands
+template < uint8_t N, typename Command >
+bool
+timingConfigure(AdaptiveRate<N>& r, const Command& cmd) {
+	if ( cmd.speriod.empty() && cmd.sphase.empty() )	return true;
+
+	typename AdaptiveRate<N>::Policy
+	p		= r.policy();
+	uint32_t
+	period	= p.period,
+	phase	= p.phase;
+	if ( !parseNumber(cmd.speriod, AdaptiveRate<N>::FREE - 1, period) || period == 0 ) {
+		stream << "Invalid value of option 'period'" << modm::endl;
+		return false;
+	}
+	p.period	= period;
+	if ( cmd.sphase == "free" )	phase = AdaptiveRate<N>::FREE;
+	const bool
+	number	= ( cmd.sphase == "free" || parseNumber(cmd.sphase, AdaptiveRate<N>::FREE - 1, phase) );
+	if ( !number || ( phase != AdaptiveRate<N>::FREE && phase >= p.period ) ) {
+		stream << "Invalid value of option 'phase' (0..period-1 | free)" << modm::endl;
+		return false;
+	}
+	p.phase		= phase;
+	r.setPolicy(p);
+	return true;
+}
+
+// --power of the sensor commands
+template < typename Command >
+bool
+powerConfigure(power::Sensor& p, const Command& cmd) {
+	if ( cmd.spower.empty() )	return true;
+
+		   if ( cmd.spower == "on" ) {
+		p.mode	= power::Mode::On;
+	} else if ( cmd.spower == "gated" ) {
+		p.mode	= power::Mode::Gated;
+	} else {
+		stream << "Invalid value of option 'power' (on | gated)" << modm::endl;
+		return false;
+	}
+	return true;
+}
+
+// --zero / --samples of the sensor commands, the capture takes the next
+// readings of the setting the command leaves
+template < uint8_t C, uint8_t S, typename Command >
+bool
+zeroConfigure(Baselines<C, S>& z, const Command& cmd, uint8_t setting) {
+	if ( cmd.szero.empty() )	return true;
+
+	typename Baselines<C, S>::Kind
+	kind;
+		   if ( cmd.szero == "off" ) {
+		z.clear(setting);
+		return true;
+	} else if ( cmd.szero == "dark" ) {
+		kind	= Baselines<C, S>::Kind::Dark;
+	} else if ( cmd.szero == "blank" ) {
+		kind	= Baselines<C, S>::Kind::Blank;
+	} else {
+		stream << "Invalid value of option 'zero' (dark | blank | off)" << modm::endl;
+		return false;
+	}
+	uint32_t
+	n		= Baselines<C, S>::SAMPLES;
+	if ( !parseNumber(cmd.ssamples, Baselines<C, S>::MAX_SAMPLES, n) || !z.start(kind, n) ) {
+		stream.printf("Invalid value of option 'samples' (1..%u)\n", Baselines<C, S>::MAX_SAMPLES);
+		return false;
+	}
+	return true;
+}
+
+template < uint8_t C, uint8_t S >
+void
+zeroPrint(const char* name, const Baselines<C, S>& z) {
+	if ( report.binary )	return;			// a capture that ends in a dump
+	const bool
+	dark	= ( z.kind() == Baselines<C, S>::Kind::Dark );
+	stream.printf("Zero %s %s:", name, dark ? "dark" : "blank");
+	for (uint8_t i = 0; i < C; ++i)
+		stream.printf(" %5u", dark ? z.dark(z.setting(), i) : z.blank(z.setting(), i));
+	stream << "\n";
+}
+
+// the unmixing blank of a channel was taken with the setting its sensor
+// ran with before a change: gone, take a new one
+void
+unmixBlankLost(Unmixing::Channel first, uint8_t n) {
+	const bool
+	had		= unmixing.hasBlank();
+	for (uint8_t i = 0; i < n; ++i)
+		unmixing.clearBlank(static_cast<Unmixing::Channel>(first + i));
+	if ( had )
+		stream << "Unmix: blank cleared, take a new one with 'unmix --blank'" << modm::endl;
+}
+
+// the blank of the setting an RGB sensor runs with is the I0 of the
+// unmixing channels, if the sensor is their source
+template < uint8_t S >
+void
+zeroBlankRgbw(const Baselines<4, S>& z, Unmixing::Source source) {
+	const uint8_t
+	setting	= z.setting();
+	if ( unmixing.source != source || !z.hasBlank(setting) )	return;
+	for (uint8_t i = 0; i < 4; ++i)
+		unmixing.setBlank(static_cast<Unmixing::Channel>(Unmixing::RED + i), z.blank(setting, i));
+}
+
+// ... and the UV one is the I0 of the concentration and of the UV channel
+void
+zeroBlankUv() {
+	const uint8_t
+	setting	= v6070Zero.setting();
+	if ( !v6070Zero.hasBlank(setting) )	return;
+	concentration.setBlank(v6070Zero.blank(setting, 0));
+	unmixing.setBlank(Unmixing::UV, v6070Zero.blank(setting, 0));
+}
+
+// a sensor runs with a new setting: the blank of it, if there is one,
+// otherwise the old I0 is lost
+template < uint8_t S >
+void
+zeroSelectedRgbw(const Baselines<4, S>& z, Unmixing::Source source) {
+	if ( unmixing.source != source )			return;
+	if ( z.hasBlank(z.setting()) )				zeroBlankRgbw(z, source);
+	else										unmixBlankLost(Unmixing::RED, 4);
+}
+
+// (the concentration blank is cleared by the command that changes the setting)
+void
+zeroSelectedUv() {
+	if ( v6070Zero.hasBlank(v6070Zero.setting()) )	zeroBlankUv();
+	else											unmixBlankLost(Unmixing::UV, 1);
+}
+
+// an RGBW reading less the dark of its setting, on its way to the bus
+template < typename Colors, uint8_t S >
+Colors
+zeroRgbw(Baselines<4, S>& z, Colors colors, const char* name, Unmixing::Source source) {
+	uint16_t
+	ch[4]	= { colors.red, colors.green, colors.blue, colors.white };
+	if ( z.process(ch) ) {
+		zeroPrint(name, z);
+		zeroBlankRgbw(z, source);
+	}
+	colors.red		= ch[0];
+	colors.green	= ch[1];
+	colors.blue		= ch[2];
+	colors.white	= ch[3];
+	return colors;
+}
+
+// 'rate' changes the policies the threads read, handled right in the main loop
+void
+rateCommand() {
+	rateCmd.getOptions();
+	if ( rateCmd.failed() )	return;
+
+	const bool
+	all		= ( rateCmd.sensor == "all" ),
+	tcs		= all || ( rateCmd.sensor == "tcs" ),
+	v6040	= all || ( rateCmd.sensor == "v6040" ),
+	v6070	= all || ( rateCmd.sensor == "v6070" );
+
+	if ( !tcs && !v6040 && !v6070 ) {
+		stream << "Invalid sensor name" << modm::endl;
+		return;
+	}
+
+	if ( rateCmd.changes() ) {
+		if ( tcs && !rateConfigure(tcsRate) )		return;
+		if ( v6040 && !rateConfigure(v6040Rate) )	return;
+		if ( v6070 )								rateConfigure(v6070Rate);
+		return;
+	}
+	if ( tcs )		printRate("TCS34725",	tcsRate);
+	if ( v6040 )	printRate("VEML6040",	v6040Rate);
+	if ( v6070 )	printRate("VEML6070",	v6070Rate);
+}
+// ----------------------------------------------------------------------------
+
+// a thread that waits for its device (ping, initialize, configure retries)
+// runs no commands: they are dropped, an absent sensor must not keep its
+// entries in the command queue until it fills up
+void
+dropWaiting(Cli::Cmd& ctl, const char* name) {
+	if ( ctl == Cli::Cmd::Command )
+		stream.printf("%s: no response from the device, command dropped\n", name);
+	ctl	= Cli::Cmd::None;
+}
+
 class ThreadOne : public modm::pt::Protothread
 {
 public:
@@ -71,6 +1114,10 @@ public:
 	{
 	}
 
+	/// configuration writes issued and skipped
+	const RegisterShadow<4>&
+	writes() const				{ return registers.writes(); }
+
 	bool
 	update(Cli::Cmd& ctl) {
 		PT_BEGIN();
@@ -80,59 +1127,96 @@ public:
 		// ping the device until it responds
 		while (true) {
 			// we wait until the task started
-			if (PT_CALL(colorSensor.ping())) {
+			TRACE(I2cStart, trace::Tcs, trace::Ping);
+			if (trace::i2c(trace::Tcs, trace::Ping, PT_CALL(colorSensor.ping()))) {
 			 	break;
 			}
 			// otherwise, try again in 100ms
 			this->timeout.restart(100);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 		}
 		MODM_LOG_DEBUG << "Device responded" << modm::endl;
 
 		while (true) {
-			if (PT_CALL(colorSensor.initialize())) {
+			TRACE(I2cStart, trace::Tcs, trace::Initialize);
+			if (trace::i2c(trace::Tcs, trace::Initialize, PT_CALL(colorSensor.initialize()))) {
+				registers.initialized(true);
+				tcsPower.on(modm::Clock::now().getTime());
 				break;
 			}
 			// otherwise, try again in 100ms
 			this->timeout.restart(100);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 		}
 		MODM_LOG_DEBUG << "Device initialized" << modm::endl;
 
 		PT_CASE(PT_ONE_CONFIG);
 		while (true) {
-			if (PT_CALL(colorSensor.configure(
-				colorSensor.gain,
+			TRACE(I2cStart, trace::Tcs, trace::Configure);
+			if (trace::i2c(trace::Tcs, trace::Configure, PT_CALL(registers.configure(
+				static_cast<uint8_t>(colorSensor.gain),
 				static_cast<uint8_t>(colorSensor.integrationTime),
-				static_cast<uint8_t>(colorSensor.waitTime)))){
+				static_cast<uint8_t>(colorSensor.waitTime))))){
 				break;
 			}
 			// otherwise, try again in 100ms
 			this->timeout.restart(100);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 		}
 
+		tcsRate.setFloor(integrationMs(colorSensor.integrationTime));
+		factor	= scale::factor(colorSensor.gain, colorSensor.integrationTime);
+		if ( tcsZero.select(scale::setting(colorSensor.gain, colorSensor.integrationTime)) )
+			zeroSelectedRgbw(tcsZero, Unmixing::Source::Tcs);
+		tcsPower.setWindow(integrationMs(colorSensor.integrationTime), 3);	// 2.4 ms start-up
 		MODM_LOG_DEBUG << "Device configured\n" << modm::endl;
 		MODM_LOG_DEBUG << "Sensors data:" << modm::endl;
 
+		PT_CASE(PT_ONE_POLL);
+		polling	= true;
 		while (true) {
 			if (ctl == Cli::Cmd::Control) {
 				stream << "Ctrl+C" << modm::endl;
+				TRACE(Stop, trace::Tcs, 0);
 				ctl = Cli::Cmd::None;
+				polling	= false;
+				break;
+			}
+			// a command while polling is done below, then polling goes on
+			if (ctl == Cli::Cmd::Command) {
 				break;
 			}
 
-			if (PT_CALL(colorSensor.refreshAllColors())) {
-				auto colors = colorSensor.getOldColors();
-				stream << "TCS34725" << modm::endl;
-				stream.printf("RGBW Hue: %5d %5d %5d %5d", colors.red, colors.green, colors.blue, colors.white);
-				modm::color::HsvT<modm::tcs3472::UnderlyingType> hsv;
-				colors.toHsv(&hsv);
-				stream.printf("  %5d\n", hsv.hue);
-				//MODM_LOG_DEBUG << modm::flush;
+			// gated and shut down: power up and wait for one integration
+			if ( !tcsPower.isOn() ) {
+				TRACE(I2cStart, trace::Tcs, trace::Wake);
+				if (trace::i2c(trace::Tcs, trace::Wake, PT_CALL(colorSensor.initialize()))) {
+					registers.initialized(false);
+					tcsPower.on(modm::Clock::now().getTime());
+				}
+				this->timeout.restart(tcsPower.window());
+				PT_WAIT_UNTIL(this->timeout.isExpired());
+			}
+
+			TRACE(I2cStart, trace::Tcs, trace::Read);
+			if (trace::i2c(trace::Tcs, trace::Read, PT_CALL(colorSensor.refreshAllColors()))) {
+				const RgbwSample&
+				s		= publishRgbw(tcsBus,
+						zeroRgbw(tcsZero, colorSensor.getOldColors(), sensorName, Unmixing::Source::Tcs), factor);
+				tcsRate.update(s.ch, s.ms);
+			}
+			this->wakeAt	= schedule(this->timeout, tcsRate, tcsPower, trace::Tcs);
+			if ( tcsPower.sleeps() ) {
+				TRACE(I2cStart, trace::Tcs, trace::Sleep);
+				if (trace::i2c(trace::Tcs, trace::Sleep, PT_CALL(registers.shutdown()))) {
+					tcsPower.off(modm::Clock::now().getTime());
+				}
 			}
-			this->timeout.restart(500);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			mainLoop.wake(LOOP_TCS, this->wakeAt, modm::Clock::now().getTime());
 		}
 
 		PT_YIELD();
@@ -143,10 +1227,17 @@ public:
 				if ( cli.command() == sensorName || cli.command() == "all" ) {
 					bool ok	= true;
 					tcsCmd.getOptions();
+					// dropped: sampling goes on as it was
+					if ( tcsCmd.failed() ) {
+						ctl = Cli::Cmd::None;
+						if ( polling )	PT_CASE_SET(PT_ONE_POLL);
+						return true;
+					}
 
 					// Restart
 					if ( tcsCmd.restart | tcsCmd.init |  tcsCmd.ping ) {
 						ctl = Cli::Cmd::None;
+						TRACE(Restart, trace::Tcs, 0);
 						PT_RESTART();
 					}
 					// wlong Bit set
@@ -199,7 +1290,17 @@ public:
 						}
 					}
 
-					if ( ok ) {
+					// sampling period and phase
+					if ( !timingConfigure(tcsRate, tcsCmd) )	ok = false;
+					// power gating
+					if ( !powerConfigure(tcsPower, tcsCmd) )	ok = false;
+					// dark / blank baselines
+					if ( !zeroConfigure(tcsZero, tcsCmd,
+							scale::setting(colorSensor.gain, colorSensor.integrationTime)) )	ok = false;
+
+					if ( ok || polling ) {
+						ctl = Cli::Cmd::None;
+						TRACE(Reconfigure, trace::Tcs, 0);
 						PT_CASE_SET(PT_ONE_CONFIG);
 					}
 				}
@@ -216,10 +1317,15 @@ private:
 	Cli&						_cli;
 	modm::ShortTimeout 			timeout;
 	modm::Tcs3472<MyI2cMaster>	colorSensor;
+	modm::Tcs3472Registers<MyI2cMaster>	registers;
 	const char*					sensorName		= "tcs";
 	const char*					sensorsName		= "all";
 
 	int							PT_ONE_CONFIG	= 0;
+	int							PT_ONE_POLL		= 0;		// sampling, a dropped command resumes it
+	bool						polling			= false;	// sampling, not stopped by Ctrl+C
+	uint32_t					wakeAt			= 0;		// scheduled end of the sampling wait, ms
+	uint32_t					factor			= scale::ONE;	// of the configured setting
 };
 
 ThreadOne one(cli);
@@ -232,6 +1338,10 @@ public:
 	{
 	}
 
+	/// configuration writes issued and skipped
+	const RegisterShadow<1>&
+	writes() const				{ return colorSensor.writes(); }
+
 	bool
 	update(Cli::Cmd& ctl) {
 		PT_BEGIN();
@@ -241,55 +1351,91 @@ public:
 		// ping the device until it responds
 		while (true) {
 			// we wait until the task started
-			if (PT_CALL(colorSensor.ping())) {
+			TRACE(I2cStart, trace::V6040, trace::Ping);
+			if (trace::i2c(trace::V6040, trace::Ping, PT_CALL(colorSensor.ping()))) {
 			 	break;
 			}
 			// otherwise, try again in 100ms
 			this->timeout.restart(100);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 		}
 		MODM_LOG_DEBUG << "Device responded" << modm::endl;
 
 		while (true) {
-			if (PT_CALL(colorSensor.initialize())) {
+			TRACE(I2cStart, trace::V6040, trace::Initialize);
+			if (trace::i2c(trace::V6040, trace::Initialize, PT_CALL(colorSensor.initialize()))) {
 				break;
 			}
 			// otherwise, try again in 100ms
 			this->timeout.restart(100);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 		}
 		MODM_LOG_DEBUG << "Device initialized" << modm::endl;
 
 		PT_CASE(PT_TWO_CONFIG);
 		while (true) {
-			if (PT_CALL(colorSensor.configure(static_cast<uint8_t>(colorSensor.integrationTime)))){
+			TRACE(I2cStart, trace::V6040, trace::Configure);
+			if (trace::i2c(trace::V6040, trace::Configure, PT_CALL(colorSensor.configure(static_cast<uint8_t>(colorSensor.integrationTime))))){
+				v6040Power.on(modm::Clock::now().getTime());		// SD cleared
 				break;
 			}
 			// otherwise, try again in 100ms
 			this->timeout.restart(100);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 		}
 
+		v6040Rate.setFloor(integrationMs(colorSensor.integrationTime));
+		factor	= scale::factor(colorSensor.integrationTime);
+		if ( v6040Zero.select(scale::setting(colorSensor.integrationTime)) )
+			zeroSelectedRgbw(v6040Zero, Unmixing::Source::V6040);
+		v6040Power.setWindow(integrationMs(colorSensor.integrationTime));
 		MODM_LOG_DEBUG << "Device configured\n" << modm::endl;
 		MODM_LOG_DEBUG << "Sensors data:" << modm::endl;
 
+		PT_CASE(PT_TWO_POLL);
+		polling	= true;
 		while (true) {
 			if (ctl == Cli::Cmd::Control) {
 				stream << "Ctrl+C" << modm::endl;
+				TRACE(Stop, trace::V6040, 0);
 				ctl = Cli::Cmd::None;
+				polling	= false;
+				break;
+			}
+			// a command while polling is done below, then polling goes on
+			if (ctl == Cli::Cmd::Command) {
 				break;
 			}
 
-			if (PT_CALL(colorSensor.refreshAllColors())) {
-				auto colors = colorSensor.getOldColors();
-				stream << "VEML6040" << modm::endl;
-				stream.printf("RGBW Hue: %5d %5d %5d %5d", colors.red, colors.green, colors.blue, colors.white);
-				modm::color::HsvT<modm::tcs3472::UnderlyingType> hsv;
-				colors.toHsv(&hsv);
-				stream.printf("  %5d\n", hsv.hue);
+			// gated and shut down: power up and wait for one integration
+			if ( !v6040Power.isOn() ) {
+				TRACE(I2cStart, trace::V6040, trace::Wake);
+				if (trace::i2c(trace::V6040, trace::Wake, PT_CALL(colorSensor.sleep(false)))) {
+					v6040Power.on(modm::Clock::now().getTime());
+				}
+				this->timeout.restart(v6040Power.window());
+				PT_WAIT_UNTIL(this->timeout.isExpired());
+			}
+
+			TRACE(I2cStart, trace::V6040, trace::Read);
+			if (trace::i2c(trace::V6040, trace::Read, PT_CALL(colorSensor.refreshAllColors()))) {
+				const RgbwSample&
+				s		= publishRgbw(v6040Bus,
+						zeroRgbw(v6040Zero, colorSensor.getOldColors(), sensorName, Unmixing::Source::V6040), factor);
+				v6040Rate.update(s.ch, s.ms);
+			}
+			this->wakeAt	= schedule(this->timeout, v6040Rate, v6040Power, trace::V6040);
+			if ( v6040Power.sleeps() ) {
+				TRACE(I2cStart, trace::V6040, trace::Sleep);
+				if (trace::i2c(trace::V6040, trace::Sleep, PT_CALL(colorSensor.sleep(true)))) {
+					v6040Power.off(modm::Clock::now().getTime());
+				}
 			}
-			this->timeout.restart(500);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			mainLoop.wake(LOOP_V6040, this->wakeAt, modm::Clock::now().getTime());
 		}
 
 		PT_YIELD();
@@ -300,10 +1446,17 @@ public:
 				if ( cli.command() == sensorName || cli.command() == "all" ) {
 					bool ok	= true;
 					v6040Cmd.getOptions();
+					// dropped: sampling goes on as it was
+					if ( v6040Cmd.failed() ) {
+						ctl = Cli::Cmd::None;
+						if ( polling )	PT_CASE_SET(PT_TWO_POLL);
+						return true;
+					}
 
 					// Restart
 					if ( v6040Cmd.restart | v6040Cmd.init |  v6040Cmd.ping ) {
 						ctl = Cli::Cmd::None;
+						TRACE(Restart, trace::V6040, 0);
 						PT_RESTART();
 					}
 					// set atime
@@ -326,7 +1479,16 @@ public:
 						}
 					}
 
-					if ( ok ) {
+					// sampling period and phase
+					if ( !timingConfigure(v6040Rate, v6040Cmd) )	ok = false;
+					// power gating
+					if ( !powerConfigure(v6040Power, v6040Cmd) )	ok = false;
+					// dark / blank baselines
+					if ( !zeroConfigure(v6040Zero, v6040Cmd, scale::setting(colorSensor.integrationTime)) )	ok = false;
+
+					if ( ok || polling ) {
+						ctl = Cli::Cmd::None;
+						TRACE(Reconfigure, trace::V6040, 0);
 						PT_CASE_SET(PT_TWO_CONFIG);
 					}
 				}
@@ -347,6 +1509,10 @@ private:
 	const char*					sensorsName		= "all";
 
 	int 						PT_TWO_CONFIG	= 0;
+	int							PT_TWO_POLL		= 0;
+	bool						polling			= false;	// sampling, not stopped by Ctrl+C
+	uint32_t					wakeAt			= 0;		// scheduled end of the sampling wait, ms
+	uint32_t					factor			= scale::ONE;	// of the configured setting
 };
 
 ThreadTwo two(cli);
@@ -359,6 +1525,10 @@ public:
 	{
 	}
 
+	/// configuration writes issued and skipped
+	const RegisterShadow<1>&
+	writes() const				{ return shadow; }
+
 	bool
 	update(Cli::Cmd& ctl) {
 		PT_BEGIN();
@@ -370,32 +1540,43 @@ public:
 			// otherwise, try again in 150ms
 			this->timeout.restart(150);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 
 			// we wait until the task started
-			if (PT_CALL(colorSensor.ping())) {
+			TRACE(I2cStart, trace::V6070, trace::Ping);
+			if (trace::i2c(trace::V6070, trace::Ping, PT_CALL(colorSensor.ping()))) {
 			 	break;
 			}
 		}
 		MODM_LOG_DEBUG << "Device responded" << modm::endl;
 
 		while (true) {
-			if (PT_CALL(colorSensor.initialize())) {
+			TRACE(I2cStart, trace::V6070, trace::Initialize);
+			if (trace::i2c(trace::V6070, trace::Initialize, PT_CALL(colorSensor.initialize()))) {
+				shadow.lost();
 				break;
 			}
 			// otherwise, try again in 100ms
 			this->timeout.restart(100);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 		}
 		MODM_LOG_DEBUG << "Device initialized" << modm::endl;
 
 		PT_CASE(PT_THREE_CONFIG);
-		while (true) {
-			if (PT_CALL(colorSensor.configure(static_cast<uint8_t>(colorSensor.integrationTime)))) {
+		// the driver has a write-only command register and no shadow of it
+		command	= static_cast<uint8_t>(colorSensor.integrationTime) | ack;
+		while ( shadow.needed(0, command) ) {
+			TRACE(I2cStart, trace::V6070, trace::Configure);
+			if (trace::i2c(trace::V6070, trace::Configure, PT_CALL(colorSensor.configure(command)))) {
+				shadow.written(0, command);
 				break;
 			}
+			shadow.lost();
 			// otherwise, try again in 100ms
 			this->timeout.restart(100);
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			dropWaiting(ctl, sensorName);
 		}													/*
 
 		while (true) {
@@ -408,27 +1589,97 @@ public:
 			}
 		}													*/
 
+		v6070Power.on(modm::Clock::now().getTime());		// SD cleared, or was already
+		v6070Rate.setFloor(integrationMs(colorSensor.integrationTime));
+		factor	= scale::factor(colorSensor.integrationTime);
+		if ( v6070Zero.select(scale::setting(colorSensor.integrationTime)) )
+			zeroSelectedUv();
+		v6070Power.setWindow(integrationMs(colorSensor.integrationTime));
 		MODM_LOG_DEBUG << "Device configured\n" << modm::endl;
 		MODM_LOG_DEBUG << "Sensors data:" << modm::endl;
 
+		PT_CASE(PT_THREE_POLL);
+		polling	= true;
 		while (true) {
 			if (ctl == Cli::Cmd::Control) {
 				stream << "Ctrl+C" << modm::endl;
+				TRACE(Stop, trace::V6070, 0);
 				ctl = Cli::Cmd::None;
+				polling	= false;
+				break;
+			}
+			// a command while polling is done below, then polling goes on
+			if (ctl == Cli::Cmd::Command) {
 				break;
 			}
 
-			if (PT_CALL(colorSensor.refreshAllColors())) {
+			// gated and shut down: power up and wait for one integration
+			if ( !v6070Power.isOn() ) {
+				command	= static_cast<uint8_t>(colorSensor.integrationTime) | ack;
+				TRACE(I2cStart, trace::V6070, trace::Wake);
+				if (trace::i2c(trace::V6070, trace::Wake, PT_CALL(colorSensor.configure(command)))) {
+					shadow.written(0, command);
+					v6070Power.on(modm::Clock::now().getTime());
+				} else {
+					shadow.lost();
+				}
+				this->timeout.restart(v6070Power.window());
+				PT_WAIT_UNTIL(this->timeout.isExpired());
+			}
+
+			// in events mode the ACK threshold gates the read: while UV is below it
+			// (and no UV alarm has to be cleared) one ARA byte replaces the data read.
+			// Every ACK_FULL-th poll reads anyway, alarms set below the ACK level,
+			// the low ones, the stats and the heartbeat need the value down there
+			acked	= true;
+			if ( ack && !report.streaming() && !v6070Alarms.active() && ++unacked < ACK_FULL ) {
+				TRACE(I2cStart, trace::V6070, trace::Ara);
+				acked	= trace::i2c(trace::V6070, trace::Ara, PT_CALL(ara.read()));
+			}
+			if ( acked )	unacked	= 0;
+
+			if ( acked )	TRACE(I2cStart, trace::V6070, trace::Read);
+			if ( !acked ) {
+				// below the ACK threshold, nothing to read
+			} else if (trace::i2c(trace::V6070, trace::Read, PT_CALL(colorSensor.refreshAllColors()))) {
 				auto colors = colorSensor.getOldColors();
-				stream << "VEML6070" << modm::endl;
-				stream.printf("Uv: %5d\n", colors.uv);
+				uint16_t
+				uv[1]	= { colors.uv };
+				if ( v6070Zero.process(uv) ) {
+					zeroPrint(sensorName, v6070Zero);
+					zeroBlankUv();
+				}
+				if ( blankPending && !report.binary ) {	// after a dump, see unmixUpdate()
+					concentration.setBlank(uv[0]);
+					blankPending	= false;
+					stream.printf("Blank: %5d\n", concentration.blank());
+				}
+				UvSample&
+				s		= v6070Bus.claim();
+				s.ms	= modm::Clock::now().getTime();
+				s.ch[0]	= uv[0];
+				s.factor	= factor;
+				s.derived.invalidate();
+				v6070Bus.publish();
+				v6070Rate.update(s.ch, s.ms);
 			}
 
 			// Depends on RSET = 270K, note actual time is shorter
 			// than 62.5ms for RSET = 300K in datasheet table (63 ~ 62.5ms)
 			//this->timeout.restart(colorSensor.timeForNext() * 63);
-			this->timeout.restart(500);
+			this->wakeAt	= schedule(this->timeout, v6070Rate, v6070Power, trace::V6070);
+			if ( v6070Power.sleeps() ) {
+				command	= static_cast<uint8_t>(colorSensor.integrationTime) | ack | SD;
+				TRACE(I2cStart, trace::V6070, trace::Sleep);
+				if (trace::i2c(trace::V6070, trace::Sleep, PT_CALL(colorSensor.configure(command)))) {
+					shadow.written(0, command);
+					v6070Power.off(modm::Clock::now().getTime());
+				} else {
+					shadow.lost();
+				}
+			}
 			PT_WAIT_UNTIL(this->timeout.isExpired());
+			mainLoop.wake(LOOP_V6070, this->wakeAt, modm::Clock::now().getTime());
 		}
 
 		PT_YIELD();
@@ -439,12 +1690,20 @@ public:
 				if ( cli.command() == sensorName || cli.command() == "all" ) {
 					bool ok	= true;
 					v6070Cmd.getOptions();
+					// dropped: sampling goes on as it was
+					if ( v6070Cmd.failed() ) {
+						ctl = Cli::Cmd::None;
+						if ( polling )	PT_CASE_SET(PT_THREE_POLL);
+						return true;
+					}
 
 					// Restart
 					if ( v6070Cmd.restart | v6070Cmd.init |  v6070Cmd.ping ) {
 						ctl = Cli::Cmd::None;
+						TRACE(Restart, trace::V6070, 0);
 						PT_RESTART();
 					}
+					const auto	atime	= colorSensor.integrationTime;
 					// set atime
 					if ( !v6070Cmd.satime.empty() ) {
 							   if ( v6070Cmd.satime == "500ms" ) {
@@ -460,8 +1719,72 @@ public:
 							ok	= false;
 						}
 					}
+					// blank (I0) is only valid for the integration time it was taken with,
+					// one of '--zero blank' comes back with its own
+					if ( colorSensor.integrationTime != atime && concentration.hasBlank() &&
+						 !v6070Zero.hasBlank(scale::setting(colorSensor.integrationTime)) ) {
+						concentration.clearBlank();
+						stream << "Blank cleared, take a new one with '--blank'" << modm::endl;
+					}
+					if ( v6070Cmd.blank ) {
+						blankPending	= true;
+					}
+					// select calibration curve
+					if ( !v6070Cmd.sanalyte.empty() ) {
+						const int
+						j		= parseIndex(v6070Cmd.sanalyte.c_str());
+						if ( j < 0 || !concentration.selectAnalyte(j) ) {
+							stream << "Invalid value of option 'analyte'" << modm::endl;
+							ok	= false;
+						}
+					}
+					// set coefficients of the selected curve
+					if ( !v6070Cmd.scurve.empty() ) {
+						fixed::q16	k[Concentration::CURVE_ORDER];
+						if ( Concentration::parseCurve(v6070Cmd.scurve.c_str(), k) ) {
+							concentration.setCurve(k);
+						} else {
+							stream << "Invalid value of option 'curve'" << modm::endl;
+							ok	= false;
+						}
+					}
+					// ACK threshold
+					if ( !v6070Cmd.sack.empty() ) {
+							   if ( v6070Cmd.sack == "off" ) {
+							ack	= 0;
+						} else if ( v6070Cmd.sack == "102" ) {
+							ack	= modm::Veml6070Ara<MyI2cMaster>::ACK;
+						} else if ( v6070Cmd.sack == "145" ) {
+							ack	= modm::Veml6070Ara<MyI2cMaster>::ACK | modm::Veml6070Ara<MyI2cMaster>::ACK_THD_145;
+						} else {
+							stream << "Invalid value of option 'ack'" << modm::endl;
+							ok	= false;
+						}
+					}
+					// output format
+					if ( !v6070Cmd.soutput.empty() ) {
+							   if ( v6070Cmd.soutput == "raw" ) {
+							concentration.output	= Concentration::Output::Raw;
+						} else if ( v6070Cmd.soutput == "conc" ) {
+							concentration.output	= Concentration::Output::Conc;
+						} else if ( v6070Cmd.soutput == "both" ) {
+							concentration.output	= Concentration::Output::Both;
+						} else {
+							stream << "Invalid value of option 'output'" << modm::endl;
+							ok	= false;
+						}
+					}
+
+					// sampling period and phase
+					if ( !timingConfigure(v6070Rate, v6070Cmd) )	ok = false;
+					// power gating
+					if ( !powerConfigure(v6070Power, v6070Cmd) )	ok = false;
+					// dark / blank baselines
+					if ( !zeroConfigure(v6070Zero, v6070Cmd, scale::setting(colorSensor.integrationTime)) )	ok = false;
 
-					if ( ok ) {
+					if ( ok || polling ) {
+						ctl = Cli::Cmd::None;
+						TRACE(Reconfigure, trace::V6070, 0);
 						PT_CASE_SET(PT_THREE_CONFIG);
 					}
 				}
@@ -475,16 +1798,333 @@ public:
 	}
 
 private:
+	enum : uint8_t { SD = 0x01 };							// command register: shutdown
+	enum : uint8_t { ACK_FULL = 8 };						// polls per read below the ACK level
+
 	Cli&						_cli;
 	modm::ShortTimeout 			timeout;
 	modm::Veml6070<MyI2cMaster>	colorSensor;
+	modm::Veml6070Ara<MyI2cMaster>	ara;
+	bool						blankPending	= false;
+	uint8_t						ack				= 0;		// ACK bits of the command register
+	uint8_t						command			= 0;		// being written to it
+	RegisterShadow<1>			shadow;						// of the command register
+	bool						acked			= true;
+	uint8_t						unacked			= 0;		// polls since the last read
 	const char*					sensorName		= "v6070";
 	const char*					sensorsName		= "all";
 
 	int							PT_THREE_CONFIG	= 0;
+	int							PT_THREE_POLL	= 0;
+	bool						polling			= false;	// sampling, not stopped by Ctrl+C
+	uint32_t					wakeAt			= 0;		// scheduled end of the sampling wait, ms
+	uint32_t					factor			= scale::ONE;	// of the configured setting
 };
 
 ThreadThree three(cli);
+// ----------------------------------------------------------------------------
+
+// Acquisition script ('script', script.hpp): its steps go into the command
+// queue like typed lines, stepped by the main loop right after the input
+script::Program		program({ Tcs::options, V6040::options, V6070::options });
+script::Runner		runner;
+
+struct ScriptHost {
+	bool
+	command(const char* line)	{ return cli.inject(line); }
+
+	bool
+	control(char c)				{ return cli.inject(c); }
+
+	void
+	mark(uint32_t n)			{ stream.printf("Script mark %u\n", static_cast<unsigned int>(n)); }
+
+	void
+	finished()					{ stream << "Script done" << modm::endl; }
+} scriptHost;
+
+// 'script save' keeps the bytecode in the RTC backup registers, they hold
+// it over a reset (and a power cycle with VBAT). The F410 has no backup
+// SRAM, and its small flash sectors are in the middle of the code.
+// Register 0: magic, length | boot << 7, crc16; 1..19: the bytecode.
+const uint8_t
+SCRIPT_MAGIC	= 0x5C;
+
+uint16_t
+scriptCrc(const uint8_t* code, uint8_t length) {
+	uint16_t
+	crc		= 0xFFFF;
+	for (uint8_t i = 0; i < length; ++i)	crc = codec::crc16(crc, code[i]);
+	return crc;
+}
+
+/// @brief clock the PWR and RTC interfaces: the F410 gates the APB clock
+/// of the RTC, and with it the backup registers (RTCAPBEN in RCC_APB1ENR, RM0401)
+void
+scriptBackupClock() {
+#ifdef RCC_APB1ENR_RTCAPBEN
+	RCC->APB1ENR	|= RCC_APB1ENR_PWREN | RCC_APB1ENR_RTCAPBEN;
+#else
+	RCC->APB1ENR	|= RCC_APB1ENR_PWREN;
+#endif
+	(void) RCC->APB1ENR;						// the clock is on before the first access
+}
+
+void
+scriptSave(bool boot) {
+	volatile uint32_t*
+	bkp		= &RTC->BKP0R;
+	scriptBackupClock();
+	PWR->CR			|= PWR_CR_DBP;				// backup domain writable
+	bkp[0]	= 0;								// invalid until all is written
+	for (uint8_t i = 0; i < script::CAPACITY; i += 4) {
+		uint32_t
+		w		= 0;
+		for (uint8_t k = 0; k < 4 && i + k < program.length(); ++k)
+			w	|= static_cast<uint32_t>(program.code()[i + k]) << ( 8 * k );
+		bkp[1 + i / 4]	= w;
+	}
+	bkp[0]	= SCRIPT_MAGIC | ( ( program.length() | ( boot ? 0x80 : 0 ) ) << 8 ) |
+			  ( static_cast<uint32_t>(scriptCrc(program.code(), program.length())) << 16 );
+	PWR->CR			&= ~PWR_CR_DBP;
+}
+
+/// @return the saved script is to run after a reset
+bool
+scriptLoad() {
+	const volatile uint32_t*
+	bkp		= &RTC->BKP0R;
+	scriptBackupClock();
+	const uint32_t
+	header	= bkp[0];
+	const uint8_t
+	length	= ( header >> 8 ) & 0x7F;
+	uint8_t
+	code[script::CAPACITY];
+	if ( ( header & 0xFF ) != SCRIPT_MAGIC || length > script::CAPACITY )	return false;
+	for (uint8_t i = 0; i < script::CAPACITY; ++i)
+		code[i]	= static_cast<uint8_t>(bkp[1 + i / 4] >> ( 8 * ( i % 4 ) ));
+	if ( scriptCrc(code, length) != ( header >> 16 ) || !program.assign(code, length) )	return false;
+	return header & 0x8000;
+}
+
+// 'script': the lines with the next step marked, or add/clear/run/stop/save
+void
+scriptCommand() {
+	scriptCmd.getOptions();
+	if ( scriptCmd.failed() )	return;
+
+	const uint32_t
+	now		= modm::Clock::now().getTime();
+	if ( scriptCmd.action == "add" ) {
+		const script::Error
+		e		= program.add(scriptCmd.argv, scriptCmd.argc);
+		if ( e != script::Error::None )
+			stream << script::errors[static_cast<uint8_t>(e)] << modm::endl;
+	} else if ( scriptCmd.action == "clear" ) {
+		runner.stop();
+		program.clear();
+	} else if ( scriptCmd.action == "run" ) {
+		if ( program.open() )	stream << "Invalid script: repeat without end" << modm::endl;
+		else					runner.start(now);
+	} else if ( scriptCmd.action == "stop" ) {
+		runner.stop();
+	} else if ( scriptCmd.action == "save" ) {
+		if ( program.open() )	stream << "Invalid script: repeat without end" << modm::endl;
+		else					scriptSave(scriptCmd.boot);
+	} else {
+		char
+		line[script::LINE];
+		uint8_t
+		pc		= 0;
+		while ( pc < program.length() ) {
+			const uint8_t
+			next	= program.line(pc, line, sizeof(line));
+			stream.printf("%c%2u %s\n", ( runner.running() && pc == runner.pc() ) ? '>' : ' ', pc, line);
+			if ( next == 0 )	break;
+			pc		= next;
+		}
+		stream.printf("Script %u/%u bytes %s", program.length(), script::CAPACITY,
+				runner.running() ? "running" : "stopped");
+		if ( runner.running() )	stream.printf(", next step at %u ms", static_cast<unsigned int>(runner.at()));
+		stream << "\n";
+	}
+}
+// ----------------------------------------------------------------------------
+
+// 'mem': static RAM of the subsystems (fixed, so it is their peak as well)
+// and their heap use, which stays 0 in the heap-free build
+void
+memCommand() {
+	memCmd.getOptions();
+	if ( memCmd.failed() )	return;
+
+	if ( memCmd.reset ) {
+		memory::reset();
+		return;
+	}
+
+	const uint32_t
+	statics[memory::SUBSYSTEMS]	= {
+		sizeof(report) + sizeof(mainLoop) + sizeof(trace::ring) + sizeof(traceDump),
+		sizeof(cli) + sizeof(tcsCmd) + sizeof(v6040Cmd) + sizeof(v6070Cmd) + sizeof(unmixCmd) +
+			sizeof(statsCmd) + sizeof(alarmCmd) + sizeof(reportCmd) + sizeof(dumpCmd) + sizeof(memCmd) +
+			sizeof(rateCmd) + sizeof(loopCmd) + sizeof(traceCmd) + sizeof(powerCmd) + sizeof(scriptCmd) + sizeof(kalmanCmd) +
+			sizeof(program) + sizeof(runner),
+		sizeof(one) + sizeof(two) + sizeof(three) + sizeof(tcsRate) + sizeof(v6040Rate) + sizeof(v6070Rate) +
+			sizeof(tcsPower) + sizeof(v6040Power) + sizeof(v6070Power) + sizeof(gatedReads) +
+			sizeof(tcsZero) + sizeof(v6040Zero) + sizeof(v6070Zero),
+		sizeof(tcsBus) + sizeof(v6040Bus) + sizeof(v6070Bus) +
+			sizeof(tcsReaders) + sizeof(v6040Readers) + sizeof(v6070Readers),
+		sizeof(tcsStats) + sizeof(v6040Stats) + sizeof(v6070Stats),
+		sizeof(tcsAlarms) + sizeof(v6040Alarms) + sizeof(v6070Alarms),
+		sizeof(tcsHistory) + sizeof(v6040History) + sizeof(v6070History) +
+			sizeof(tcsDump) + sizeof(v6040Dump) + sizeof(v6070Dump),
+		sizeof(unmixing) + sizeof(unmixPending) + sizeof(concentration) + sizeof(kalman)
+	};
+
+	memory::Heap
+	total	= {};
+	uint32_t
+	all		= 0;
+	for (uint8_t i = 0; i < memory::SUBSYSTEMS; ++i) {
+		const memory::Heap&
+		h		= memory::heap[i];
+		stream.printf("Mem %s: static %u heap %u peak %u allocs %u\n", memory::names[i],
+				static_cast<unsigned int>(statics[i]), static_cast<unsigned int>(h.bytes),
+				static_cast<unsigned int>(h.peak), static_cast<unsigned int>(h.allocs));
+		all				+= statics[i];
+		total.bytes		+= h.bytes;
+		total.peak		+= h.peak;
+		total.allocs	+= h.allocs;
+	}
+	stream.printf("Mem total: static %u heap %u peak %u allocs %u trap %s\n",
+			static_cast<unsigned int>(all), static_cast<unsigned int>(total.bytes),
+			static_cast<unsigned int>(total.peak), static_cast<unsigned int>(total.allocs),
+			memory::trap ? "on" : "off");
+}
+// ----------------------------------------------------------------------------
+
+void
+printPower(const char* name, const power::Sensor& p, uint16_t interval, uint32_t now) {
+	const unsigned int
+	estimated	= p.estimated(interval),
+	measured	= p.measured(now);
+	stream.printf("Power %s: %s window %u ms interval %u ms duty estimated %u.%u%% measured %u.%u%% wakes %u\n",
+			name, p.gated() ? "gated" : "on", p.window(), interval, estimated / 10, estimated % 10,
+			measured / 10, measured % 10, static_cast<unsigned int>(p.wakes()));
+}
+
+// configuration, wake and sleep writes: issued, and skipped as the register
+// held the value already
+template < typename Shadow >
+void
+printWrites(const Shadow& w) {
+	stream.printf("  register writes issued %u skipped %u\n",
+			static_cast<unsigned int>(w.issued()), static_cast<unsigned int>(w.skipped()));
+}
+
+// 'power': power mode and duty cycle of the sensors, the share of time they
+// draw their active current, for the energy budget, and the register writes
+void
+powerCommand() {
+	powerCmd.getOptions();
+	if ( powerCmd.failed() )	return;
+
+	const uint32_t
+	now		= modm::Clock::now().getTime();
+	if ( powerCmd.reset ) {
+		tcsPower.reset(now);
+		v6040Power.reset(now);
+		v6070Power.reset(now);
+		return;
+	}
+	printPower("tcs",	tcsPower,	tcsRate.interval(),		now);
+	printWrites(one.writes());
+	printPower("v6040",	v6040Power,	v6040Rate.interval(),	now);
+	printWrites(two.writes());
+	printPower("v6070",	v6070Power,	v6070Rate.interval(),	now);
+	printWrites(three.writes());
+}
+// ----------------------------------------------------------------------------
+
+/// "<label> 0:n 1:n 2-3:n ... 1024+:n", the non-empty buckets
+template < typename Histogram >
+void
+printHistogram(const char* label, const Histogram& h) {
+	stream << label;
+	for (uint8_t b = 0; b < h.buckets(); ++b) {
+		const unsigned int
+		n		= h.bin(b),
+		lo		= Histogram::lower(b),
+		hi		= Histogram::upper(b);
+		if ( n == 0 )					continue;
+		if ( hi == UINT32_MAX )			stream.printf(" %u+:%u", lo, n);
+		else if ( lo == hi )			stream.printf(" %u:%u", lo, n);
+		else							stream.printf(" %u-%u:%u", lo, hi, n);
+	}
+	stream << "\n";
+}
+
+// 'loop': pass time and wake lateness histograms, the slowest sections and
+// the last overruns with their culprits
+void
+loopCommand() {
+	loopCmd.getOptions();
+	if ( loopCmd.failed() )	return;
+
+	if ( loopCmd.reset ) {
+		mainLoop.reset();
+		return;
+	}
+	if ( !loopCmd.sbudget.empty() || !loopCmd.slate.empty() ) {
+		uint32_t
+		budget		= mainLoop.budget,
+		tolerance	= mainLoop.tolerance;
+		if ( !parseNumber(loopCmd.sbudget, UINT32_MAX, budget) || !parseNumber(loopCmd.slate, UINT32_MAX, tolerance) ) {
+			stream << "Invalid value" << modm::endl;
+			return;
+		}
+		mainLoop.budget		= budget;
+		mainLoop.tolerance	= tolerance;
+		return;
+	}
+
+	using Monitor	= decltype(mainLoop);
+	const Monitor::PassHistogram&
+	pass	= mainLoop.pass();
+	stream.printf("Loop passes %u max %u us p50 <=%u p99 <=%u p999 <=%u budget %u overruns %u\n",
+			static_cast<unsigned int>(pass.count()), static_cast<unsigned int>(pass.max()),
+			static_cast<unsigned int>(pass.quantile(500)), static_cast<unsigned int>(pass.quantile(990)),
+			static_cast<unsigned int>(pass.quantile(999)), static_cast<unsigned int>(mainLoop.budget),
+			static_cast<unsigned int>(mainLoop.overruns()));
+	printHistogram("Loop us:", pass);
+	for (uint8_t i = 0; i < LOOP_SECTIONS; ++i) {
+		stream.printf("Loop %s: worst %u us blamed %u\n", loopNames[i],
+				static_cast<unsigned int>(mainLoop.worst(i)), static_cast<unsigned int>(mainLoop.blamed(i)));
+	}
+	for (uint8_t i = LOOP_TCS; i <= LOOP_V6070; ++i) {
+		const Monitor::WakeHistogram&
+		w		= mainLoop.wakeLateness(i);
+		stream.printf("Wake %s: n %u late max %u ms p99 <=%u tolerance %u\n", loopNames[i],
+				static_cast<unsigned int>(w.count()), static_cast<unsigned int>(w.max()),
+				static_cast<unsigned int>(w.quantile(990)), static_cast<unsigned int>(mainLoop.tolerance));
+		printHistogram("Wake ms:", w);
+	}
+	for (uint8_t i = 0; i < mainLoop.kept(); ++i) {
+		const Monitor::Overrun&
+		o		= mainLoop.last(i);
+		if ( o.task == Monitor::LOOP ) {
+			stream.printf("Overrun %u ms: pass %u us, culprit %s\n", static_cast<unsigned int>(o.ms),
+					static_cast<unsigned int>(o.amount), loopNames[o.culprit]);
+		} else {
+			stream.printf("Overrun %u ms: %s woke %u ms late, culprit %s\n", static_cast<unsigned int>(o.ms),
+					loopNames[o.task], static_cast<unsigned int>(o.amount), loopNames[o.culprit]);
+		}
+	}
+}
+// ----------------------------------------------------------------------------
+
 // ----------------------------------------------------------------------------
 void
 usart2PostInit() {
@@ -501,6 +2141,20 @@ enum PT_ATTRS {
 	PT_3	= 2
 };
 
+/// @brief one pass of a sensor thread with the oldest queued command for it,
+/// the command is done once the thread has reset ctl
+template < typename Thread >
+void
+update(Thread& thread, uint8_t subscriber) {
+	Cli::Cmd
+	ctl		= cli.next(subscriber);
+	const bool
+	pending	= ( ctl != Cli::Cmd::None );
+	thread.update(ctl);
+	if ( pending && ( ctl == Cli::Cmd::None ) )	cli.done(subscriber);
+}
+// ----------------------------------------------------------------------------
+
 int
 main() {
 	Board::initialize();               
@@ -516,38 +2170,120 @@ main() {
 	stream << "Trying to work with TCS34725/VEML6040 RGB and VEML6070 UV sensors (I2C boadrate=100KHz):\n\n" << modm::flush;
 
 	modm::ShortPeriodicTimer tmr(500);
-
+	modm::ShortPeriodicTimer heartbeatTmr(1000);
+	uint16_t	heartbeatSecs	= 0;
+
+	// subscribers of the command queue, in PT_ATTRS order
+	cli.subscribe("tcs");
+	cli.subscribe("v6040");
+	cli.subscribe("v6070");
+	const uint8_t
+	global		= cli.subscribe(nullptr);			// unmix, kalman, stats, alarm, report, dump, script
 	Cli::Cmd	ctl;
-	Cli::Cmd	ctls[PT_ATTRS::PT_NUMS];
-	bool		showPrompt	= false;
+
+	// a script saved with 'script save boot' starts right away
+	if ( scriptLoad() )	runner.start(modm::Clock::now().getTime());
+
+	// from here on every heap allocation is a bug (HEAP_TRAP builds)
+	memory::armTrap();
+
+	// cycle counter for the pass times of 'loop' and the trace timestamps
+	timing::start(Board::SystemClock::Frequency);
+#if TRACE_ENABLED
+	mainLoop.onOverrun	= [](const decltype(mainLoop)::Overrun& o) {
+		TRACE(Overrun, ( o.task << 4 ) | o.culprit, ( o.amount < UINT16_MAX ) ? o.amount : UINT16_MAX);
+	};
+#endif
 
 	cli.prompt();
 
 	while (true) {
+		mainLoop.begin();
+
 		//    
-		ctl	= cli.checkInput();
-		if ( (ctl != Cli::Cmd::None) && (ctl != Cli::Cmd::Error) ) {
-			for (uint8_t i=0; i<3; i++) ctls[i] = ctl;
-			showPrompt	= true;
+		memory::current	= memory::Cli;				// heap use charged to it, see 'mem'
+		if ( cli.checkInput() == Cli::Cmd::Control )	runner.stop();
+		runner.step(program, modm::Clock::now().getTime(), scriptHost);
+
+		// global commands; a running dump holds the next ones of every
+		// subscriber back, so nothing prints into it
+		ctl	= cli.next(global);
+		if ( (ctl == Cli::Cmd::Command) && (cli.command() == "unmix") ) {
+			unmixCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "stats") ) {
+			statsCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "alarm") ) {
+			alarmCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "report") ) {
+			reportCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "dump") ) {
+			if ( !dumpCommand() )	cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "rate") ) {
+			rateCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "mem") ) {
+			memCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "loop") ) {
+			loopCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "power") ) {
+			powerCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "trace") ) {
+			if ( !traceCommand() )	cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "kalman") ) {
+			kalmanCommand();
+			cli.done(global);
+		} else if ( (ctl == Cli::Cmd::Command) && (cli.command() == "script") ) {
+			scriptCommand();
+			cli.done(global);
+		} else if ( ctl != Cli::Cmd::None ) {
+			cli.done(global);							// nobody knows it
 		}
 
-		one		.update(ctls[PT_ATTRS::PT_1]);
-		two		.update(ctls[PT_ATTRS::PT_2]);
-		three	.update(ctls[PT_ATTRS::PT_3]);
-
-		//       -
-		bool	allDone	= true;
-		for (uint8_t i=0; i<3; i++)
-			allDone &=  ( ctls[i] == Cli::Cmd::None )? true: false;
-		//  
-		if ( allDone && showPrompt ) {
-			cli.done();
-			showPrompt	= false;
+		// one record per pass, the sensor threads keep sampling meanwhile
+		memory::current	= memory::History;
+		if ( dumping && !dumping->step() ) {
+			dumping			= nullptr;
+			report.binary	= false;
+			cli.hold(false);
+			cli.done(global);
 		}
 
+		mainLoop.mark(LOOP_CLI);
+
+		// the prompt comes back when all queued commands are done
+		// each sensor's samples are consumed right after its thread ran
+		memory::current	= memory::Sensors;
+		update(one,		PT_ATTRS::PT_1);
+		consumeTcs();
+		mainLoop.mark(LOOP_TCS);
+		update(two,		PT_ATTRS::PT_2);
+		consumeV6040();
+		mainLoop.mark(LOOP_V6040);
+		update(three,	PT_ATTRS::PT_3);
+		consumeV6070();
+		mainLoop.mark(LOOP_V6070);
+
+		memory::current	= memory::Other;
 		if (tmr.execute()) {
 			LedD13::toggle();
 		}
+
+		if (heartbeatTmr.execute()) {
+			if ( report.mode == Reporting::Mode::Events && report.heartbeat &&
+				 ++heartbeatSecs >= report.heartbeat ) {
+				heartbeat();
+				heartbeatSecs	= 0;
+			}
+		}
+		mainLoop.mark(LOOP_OTHER);
+		mainLoop.end(modm::Clock::now().getTime());
 	}
 
 	return 0;
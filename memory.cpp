@@ -0,0 +1,113 @@
+// ----------------------------------------------------------------------------
+// malloc/calloc/realloc/free wrappers (ld --wrap, see project.xml), the
+// accounting itself is in memory.hpp
+// ----------------------------------------------------------------------------
+
+#include <memory.hpp>
+
+#include <string.h>
+// ----------------------------------------------------------------------------
+
+extern "C" {
+
+void*	__real_malloc(size_t size);
+void*	__real_realloc(void* p, size_t size);
+void	__real_free(void* p);
+
+}
+// ----------------------------------------------------------------------------
+
+namespace {
+
+enum : uint32_t { MAGIC = 0xA110C8EDu };
+
+/// in front of every wrapped block, keeps the payload 8-byte aligned
+struct alignas(8) Header {
+	uint32_t			magic;
+	uint16_t			size;					// payload bytes, saturated
+	memory::Subsystem	subsystem;
+};
+
+void*
+allocate(size_t size) {
+	if ( memory::trap )		__builtin_trap();
+
+	Header*
+	h		= static_cast<Header*>(__real_malloc(sizeof(Header) + size));
+	if ( h == nullptr )		return nullptr;
+
+	h->magic		= MAGIC;
+	h->size			= ( size > UINT16_MAX ) ? UINT16_MAX : static_cast<uint16_t>(size);
+	h->subsystem	= memory::current;
+
+	memory::Heap&
+	u		= memory::heap[h->subsystem];
+	++u.allocs;
+	u.bytes	+= h->size;
+	if ( u.bytes > u.peak )	u.peak = u.bytes;
+	return h + 1;
+}
+
+/// @return the header of a wrapped block, nullptr for one malloc'ed by
+/// newlib itself (_malloc_r) and freed through free()
+Header*
+header(void* p) {
+	Header*
+	h		= static_cast<Header*>(p) - 1;
+	return ( h->magic == MAGIC ) ? h : nullptr;
+}
+
+void
+release(void* p) {
+	if ( p == nullptr )	return;
+	Header*
+	h		= header(p);
+	if ( h == nullptr ) {
+		__real_free(p);
+		return;
+	}
+	memory::heap[h->subsystem].bytes	-= h->size;
+	h->magic	= 0;
+	__real_free(h);
+}
+
+}	// namespace
+// ----------------------------------------------------------------------------
+
+extern "C" {
+
+void*
+__wrap_malloc(size_t size)						{ return allocate(size); }
+
+void
+__wrap_free(void* p)							{ release(p); }
+
+void*
+__wrap_calloc(size_t n, size_t size) {
+	if ( size && n > SIZE_MAX / size )	return nullptr;
+	void*
+	p		= allocate(n * size);
+	if ( p )	memset(p, 0, n * size);
+	return p;
+}
+
+void*
+__wrap_realloc(void* p, size_t size) {
+	if ( p == nullptr )	return allocate(size);
+	if ( size == 0 ) {
+		release(p);
+		return nullptr;
+	}
+	const Header*
+	h		= header(p);
+	if ( h == nullptr )	return __real_realloc(p, size);
+	void*
+	q		= allocate(size);
+	if ( q == nullptr )	return nullptr;
+	memcpy(q, p, ( h->size < size ) ? h->size : size);
+	release(p);
+	return q;
+}
+
+}
+// ----------------------------------------------------------------------------
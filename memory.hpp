@@ -0,0 +1,91 @@
+// ----------------------------------------------------------------------------
+
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+// ----------------------------------------------------------------------------
+
+// Heap-free build (default): the CLI keeps command lines and option values
+// in fixed-capacity strings (static_string.hpp) instead of std::string and
+// std::map, so the firmware does not touch the heap after startup.
+// -DHEAP_FREE=0 builds the former std::string CLI.
+#ifndef HEAP_FREE
+#define HEAP_FREE	1
+#endif
+
+// Trap on any heap allocation once main() has armed the trap (default in the
+// heap-free build): a heap user that slipped in stops the device at the
+// culprit instead of fragmenting the heap over months.
+#ifndef HEAP_TRAP
+#define HEAP_TRAP	HEAP_FREE
+#endif
+// ----------------------------------------------------------------------------
+
+/// @brief Heap accounting per subsystem
+///
+/// memory.cpp wraps malloc/calloc/realloc/free (linker option --wrap, see
+/// project.xml): every allocation is charged to the subsystem of the
+/// innermost Scope and remembered in a small header, so free() credits the
+/// same subsystem. Without the wrap (host builds) everything stays zero.
+namespace memory {
+
+enum Subsystem : uint8_t {
+	Other,
+	Cli,
+	Sensors,
+	Bus,
+	Stats,
+	Alarms,
+	History,
+	Unmix,
+	SUBSYSTEMS
+};
+
+inline const char* const	names[SUBSYSTEMS]	= {
+	"other", "cli", "sensors", "bus", "stats", "alarms", "history", "unmix"
+};
+
+struct Heap {
+	uint32_t		allocs;						// calls since reset
+	uint32_t		bytes;						// in use
+	uint32_t		peak;						// most bytes in use since reset
+};
+
+inline Heap			heap[SUBSYSTEMS]	= {};
+inline Subsystem	current				= Other;
+inline bool			trap				= false;
+
+/// @brief arm the trap (HEAP_TRAP builds) once startup is done
+inline void
+armTrap()								{ trap = HEAP_TRAP; }
+
+/// @brief forget the counts and peaks, keep the bytes in use
+inline void
+reset() {
+	for (uint8_t i = 0; i < SUBSYSTEMS; ++i) {
+		heap[i].allocs	= 0;
+		heap[i].peak	= heap[i].bytes;
+	}
+}
+
+/// @brief charge the heap use of a block of code to a subsystem
+class Scope {
+public:
+	explicit
+	Scope(Subsystem s): _previous(current)	{ current = s; }
+
+	~Scope()								{ current = _previous; }
+
+	Scope(const Scope&)				= delete;
+	Scope& operator=(const Scope&)	= delete;
+
+private:
+	Subsystem		_previous;
+};
+
+}	// namespace memory
+// ----------------------------------------------------------------------------
+
+#endif	// MEMORY_HPP
@@ -0,0 +1,162 @@
+// ----------------------------------------------------------------------------
+
+#ifndef POWER_HPP
+#define POWER_HPP
+
+#include <stdint.h>
+// ----------------------------------------------------------------------------
+
+/// @brief Duty-cycled acquisition: power gating of the sensors
+namespace power {
+
+enum class Mode : uint8_t {
+	On,											// powered from configuration on
+	Gated										// shut down between samples
+};
+
+/// @brief Power state and on time of one sensor
+///
+/// Gated: the sensor is woken up window() ms before a read (start-up and
+/// one integration) and shut down right after it. When the sleep until
+/// the next wake-up would be shorter than a window it stays on, two more
+/// transactions would not save anything.
+///
+/// on()/off() are called when the power-up/down transaction succeeded, so
+/// measured() is the share of time the sensor really drew its active
+/// current, estimated() what the schedule is meant to give.
+class Sensor {
+public:
+	Mode			mode		= Mode::On;
+
+	bool
+	gated() const				{ return mode == Mode::Gated; }
+
+	bool
+	isOn() const				{ return _on; }
+
+	/// @param integration	ms of one conversion
+	/// @param startup		ms from power-up to the start of the first conversion
+	void
+	setWindow(uint16_t integration, uint16_t startup = 0) {
+		// + 1/8 for the tolerance of the internal oscillator, the read must
+		// not take the conversion of the last window
+		_window	= startup + integration + integration / 8 + 1;
+	}
+
+	uint16_t
+	window() const				{ return _window; }
+
+	void
+	on(uint32_t ms) {
+		if ( _on )	return;
+		_on		= true;
+		_since	= ms;
+		++_wakes;
+	}
+
+	void
+	off(uint32_t ms) {
+		if ( !_on )	return;
+		_on		= false;
+		_onMs	+= ms - _since;
+	}
+
+	/// @brief plan the next read at `readAt`
+	/// @return when the thread has to wake up: a window before the read if
+	/// the sensor sleeps meanwhile (sleeps()), else the read itself
+	uint32_t
+	plan(uint32_t now, uint32_t readAt) {
+		_sleep	= gated() && ( readAt - now >= 2u * _window );
+		return _sleep ? readAt - _window : readAt;
+	}
+
+	/// shut down until the planned wake-up
+	bool
+	sleeps() const				{ return gated() && _sleep && _on; }
+
+	/// @brief start measuring again
+	void
+	reset(uint32_t ms) {
+		_start	= ms;
+		_since	= ms;
+		_onMs	= 0;
+		_wakes	= _on ? 1 : 0;
+	}
+
+	/// share of the time since reset() the sensor was on, permille
+	uint16_t
+	measured(uint32_t ms) const {
+		const uint32_t
+		elapsed	= ms - _start;
+		if ( elapsed == 0 )		return _on ? 1000 : 0;
+		const uint64_t
+		onMs	= _onMs + ( _on ? ms - _since : 0 );
+		return static_cast<uint16_t>(onMs * 1000 / elapsed);
+	}
+
+	/// share the schedule gives at a sampling `interval` in ms, permille
+	uint16_t
+	estimated(uint16_t interval) const {
+		if ( !gated() || interval < 2u * _window )	return 1000;
+		return static_cast<uint16_t>(static_cast<uint32_t>(_window) * 1000 / interval);
+	}
+
+	/// power-ups since reset()
+	uint32_t
+	wakes() const				{ return _wakes; }
+
+private:
+	uint16_t		_window		= 0;
+	bool			_on			= false;
+	bool			_sleep		= false;
+	uint32_t		_since		= 0;		// on since, ms
+	uint32_t		_onMs		= 0;		// on time before _since
+	uint32_t		_start		= 0;
+	uint32_t		_wakes		= 0;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Read times of the gated sensors
+///
+/// A read is pulled in to an earlier planned read of another gated sensor
+/// within `slack` ms. The sensors then read together and their wake
+/// windows end together: the shorter ones lie within the longest, the bus
+/// and the MCU wake up once for all of them instead of once per sensor.
+/// The interval of the sensor that was pulled in is `slack` shorter at most.
+template < uint8_t Sensors >
+class Group {
+public:
+	/// @param earliest	the read can not be before (now + window)
+	/// @param due		when the sampling rate wants the read
+	/// @return the read time
+	uint32_t
+	align(uint8_t sensor, uint32_t earliest, uint32_t due, uint16_t slack) {
+		uint32_t
+		at		= due;
+		for (uint8_t i = 0; i < Sensors; ++i) {
+			if ( i == sensor || !( _planned & ( 1u << i ) ) )	continue;
+			const uint32_t
+			t		= _readAt[i];
+			// within [earliest, due], wrap-safe, and earlier than found so far
+			if ( static_cast<int32_t>(t - earliest) >= 0 && static_cast<int32_t>(due - t) >= 0 &&
+				 due - t <= slack && static_cast<int32_t>(at - t) > 0 )
+				at	= t;
+		}
+		_readAt[sensor]	= at;
+		_planned		|= 1u << sensor;
+		return at;
+	}
+
+	/// @brief the sensor has no planned read (not gated)
+	void
+	drop(uint8_t sensor)		{ _planned &= ~( 1u << sensor ); }
+
+private:
+	uint32_t		_readAt[Sensors]	= {};
+	uint8_t			_planned			= 0;
+};
+
+}	// namespace power
+// ----------------------------------------------------------------------------
+
+#endif	// POWER_HPP
@@ -0,0 +1,184 @@
+// ----------------------------------------------------------------------------
+
+#ifndef RATE_HPP
+#define RATE_HPP
+
+#include <stdint.h>
+// ----------------------------------------------------------------------------
+
+/// @brief Sampling interval of one sensor, fixed or driven by the signal
+///
+/// Fixed: every `period` ms, either `period` after the last sample (free
+/// running) or on the grid phase + k * period of the clock, so sensors with
+/// the same period and different phases take turns on the bus. Adaptive: the interval starts at `period`,
+/// halves as soon as a channel moves faster than `slope` counts/s or its
+/// running variance exceeds `noise`^2 (reactions), and grows by a quarter
+/// after `hold` quiet checks in a row (stable periods). It stays within
+/// [lowest(), max]: lowest() is `min`, but never shorter than the
+/// integration time of the sensor (setFloor()), faster polling would only
+/// read the same conversion again.
+///
+/// The slope is taken over at least `period` ms, not between neighbouring
+/// samples: otherwise sampling faster would turn the same noise into a
+/// steeper slope and the interval would run down to its floor. The variance
+/// is an exponential moving one (weight 1/8), integers only.
+template < uint8_t Channels >
+class AdaptiveRate {
+public:
+	enum : uint16_t { FREE = UINT16_MAX };		// no phase
+
+	enum class Mode : uint8_t {
+		Fixed,
+		Adaptive
+	};
+
+	struct Policy {
+		Mode			mode		= Mode::Fixed;
+		uint16_t		period		= 500;		// ms, fixed interval / adaptive start
+		uint16_t		phase		= FREE;		// ms into the period (fixed mode)
+		uint16_t		min			= 0;		// ms, raised to the integration time
+		uint16_t		max			= 5000;		// ms
+		uint16_t		slope		= 0;		// counts/s, 0 = not used
+		uint16_t		noise		= 0;		// counts (standard deviation), 0 = not used
+		uint8_t			hold		= 8;		// quiet checks before growing
+	};
+
+	AdaptiveRate()				{ restart(); }
+
+	/// @brief new policy, adaptive mode starts over at the period
+	void
+	setPolicy(const Policy& p)	{
+		_policy	= p;
+		restart();
+	}
+
+	const Policy&
+	policy() const				{ return _policy; }
+
+	/// @brief integration time of the sensor in ms (the shortest interval)
+	void
+	setFloor(uint16_t ms)		{
+		_floor		= ms;
+		_interval	= clamp(_interval);
+	}
+
+	uint16_t
+	lowest() const				{ return ( _policy.min > _floor ) ? _policy.min : _floor; }
+
+	/// @brief ms until the next sample
+	uint16_t
+	interval() const			{ return ( _policy.mode == Mode::Fixed ) ? _policy.period : _interval; }
+
+	/// @brief ms from `now` (just after a sample) to the next sample
+	uint16_t
+	wait(uint32_t now) const {
+		if ( _policy.mode != Mode::Fixed || _policy.phase == FREE )	return interval();
+		const uint32_t
+		p		= _policy.period,
+		into	= ( now % p + p - _policy.phase % p ) % p;	// since the last grid point
+		return p - into;
+	}
+
+	/// fastest channel change of the last check, counts/s
+	uint32_t
+	lastSlope() const			{ return _slope; }
+
+	/// largest running variance of the channels, counts^2
+	uint32_t
+	variance() const			{
+		uint32_t
+		v		= 0;
+		for (uint8_t i = 0; i < Channels; ++i)
+			if ( _var[i] > v )	v = _var[i];
+		return v;
+	}
+
+	/// @brief feed a sample, adapts the interval in adaptive mode
+	void
+	update(const uint16_t (&x)[Channels], uint32_t ms) {
+		if ( !_primed ) {
+			for (uint8_t i = 0; i < Channels; ++i) {
+				_anchor[i]	= x[i];
+				_mean[i]	= static_cast<int32_t>(x[i]) << FRAC;
+				_var[i]		= 0;
+			}
+			_anchorMs	= ms;
+			_primed		= true;
+			return;
+		}
+
+		bool
+		noisy	= false;
+		const uint32_t
+		limit	= static_cast<uint32_t>(_policy.noise) * _policy.noise;
+		for (uint8_t i = 0; i < Channels; ++i) {
+			const int32_t
+			dev		= ( static_cast<int32_t>(x[i]) << FRAC ) - _mean[i];
+			_mean[i]	+= dev / (1 << WEIGHT);
+			const uint32_t
+			a		= static_cast<uint32_t>( dev < 0 ? -dev : dev ) >> FRAC;
+			_var[i]	= _var[i] - (_var[i] >> WEIGHT) + ((a * a) >> WEIGHT);
+			if ( _policy.noise && _var[i] > limit )	noisy = true;
+		}
+
+		// slope check once per window of `period` ms (or per sample if slower)
+		const uint32_t
+		dt		= ms - _anchorMs;
+		const bool
+		check	= ( dt >= _policy.period ) || noisy;
+		if ( dt >= _policy.period ) {
+			uint32_t
+			change	= 0;
+			for (uint8_t i = 0; i < Channels; ++i) {
+				const uint32_t
+				d		= ( x[i] > _anchor[i] ) ? x[i] - _anchor[i] : _anchor[i] - x[i];
+				if ( d > change )	change = d;
+				_anchor[i]	= x[i];
+			}
+			_slope		= change * 1000 / ( dt ? dt : 1 );
+			_anchorMs	= ms;
+		}
+
+		if ( _policy.mode != Mode::Adaptive || !check )	return;
+
+		if ( noisy || ( _policy.slope && _slope > _policy.slope ) ) {
+			_interval	= clamp(_interval / 2);
+			_quiet		= 0;
+		} else if ( ++_quiet >= _policy.hold ) {
+			_interval	= clamp(_interval + ( _interval / 4 ? _interval / 4 : 1 ));
+			_quiet		= 0;
+		}
+	}
+
+private:
+	enum { FRAC = 4, WEIGHT = 3 };
+
+	void
+	restart()					{
+		_interval	= clamp(_policy.period);
+		_quiet		= 0;
+	}
+
+	uint16_t
+	clamp(uint32_t ms) const	{
+		const uint16_t
+		lo		= lowest();
+		if ( ms < lo )				ms = lo;
+		if ( ms > _policy.max )		ms = ( _policy.max > lo ) ? _policy.max : lo;
+		return ms ? static_cast<uint16_t>(ms) : 1;
+	}
+
+	Policy			_policy;
+	uint16_t		_floor		= 0;
+	uint16_t		_interval;
+	uint8_t			_quiet;
+	bool			_primed		= false;
+	uint16_t		_anchor[Channels];			// values at the start of the slope window
+	uint32_t		_anchorMs	= 0;
+	uint32_t		_slope		= 0;
+	int32_t			_mean[Channels];			// Q4
+	uint32_t		_var[Channels];				// counts^2
+};
+// ----------------------------------------------------------------------------
+
+#endif	// RATE_HPP
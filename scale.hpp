@@ -0,0 +1,121 @@
+// ----------------------------------------------------------------------------
+
+#ifndef SCALE_HPP
+#define SCALE_HPP
+
+#include <stdint.h>
+
+#include <modm/driver/color/tcs3472.hpp>
+#include <modm/driver/color/veml6040.hpp>
+#include <modm/driver/color/veml6070.hpp>
+// ----------------------------------------------------------------------------
+
+/// @brief Readings normalised to a common unit per sensor
+///
+/// Counts grow with the integration time (and the gain of the TCS3472).
+/// A reading is multiplied by the factor that maps it to the counts at the
+/// most sensitive setting of its sensor: TCS3472 700 ms (256 cycles) and
+/// 60x, VEML6040 1280 ms, VEML6070 4 T. No factor is below 1, so no
+/// resolution is lost, and 65535 counts times the largest one (15360)
+/// still fit 32 bits.
+///
+/// The factors are Q16 constants in tables indexed by IntegrationTime and
+/// Gain. The factor of a setting is looked up when the sensor is
+/// configured, a sample costs one 32x32->64 multiply and a shift.
+namespace scale {
+
+enum : uint8_t { SHIFT = 16 };
+
+enum : uint32_t { ONE = 1ul << SHIFT };
+
+/// @brief Q16 of num / den, rounded (for the tables)
+constexpr uint32_t
+ratio(uint32_t num, uint32_t den) {
+	return static_cast<uint32_t>(( ( static_cast<uint64_t>(num) << SHIFT ) + den / 2 ) / den);
+}
+
+/// @brief raw counts in the common unit
+constexpr uint32_t
+normalise(uint16_t raw, uint32_t factor) {
+	return static_cast<uint32_t>(( static_cast<uint64_t>(raw) * factor ) >> SHIFT);
+}
+// ----------------------------------------------------------------------------
+
+// TCS3472: 256 / (256 - ATIME) * 60 / gain, [Gain][IntegrationTime index]
+constexpr uint32_t
+tcs(uint8_t atime, uint8_t gain)	{ return ratio(256u * 60u, ( 256u - atime ) * gain); }
+
+constexpr uint32_t
+tcsFactor[4][5]	= {
+	// 2.4 ms			24 ms				101 ms				154 ms				700 ms
+	{ tcs(0xFF, 1),		tcs(0xF6, 1),		tcs(0xD5, 1),		tcs(0xC0, 1),		tcs(0x00, 1) },		// X1
+	{ tcs(0xFF, 4),		tcs(0xF6, 4),		tcs(0xD5, 4),		tcs(0xC0, 4),		tcs(0x00, 4) },		// X4
+	{ tcs(0xFF, 16),	tcs(0xF6, 16),		tcs(0xD5, 16),		tcs(0xC0, 16),		tcs(0x00, 16) },	// X16
+	{ tcs(0xFF, 60),	tcs(0xF6, 60),		tcs(0xD5, 60),		tcs(0xC0, 60),		tcs(0x00, 60) },	// X60
+};
+
+constexpr uint8_t
+tcsIndex(modm::tcs3472::IntegrationTime t) {
+	using T	= modm::tcs3472::IntegrationTime;
+	return	( t == T::MSEC_2 )		? 0 :
+			( t == T::MSEC_24 )		? 1 :
+			( t == T::MSEC_101 )	? 2 :
+			( t == T::MSEC_154 )	? 3 : 4;
+}
+
+// VEML6040: 1280 ms / IT, [IT >> 4]
+constexpr uint32_t
+v6040Factor[6]	= { ratio(32, 1), ratio(16, 1), ratio(8, 1), ratio(4, 1), ratio(2, 1), ratio(1, 1) };
+
+// VEML6070: 4 T / IT, [IT >> 2]
+constexpr uint32_t
+v6070Factor[4]	= { ratio(8, 1), ratio(4, 1), ratio(2, 1), ratio(1, 1) };
+
+static_assert(tcsFactor[3][4] == ONE && v6040Factor[5] == ONE && v6070Factor[3] == ONE,
+		"the most sensitive setting is the unit");
+static_assert(static_cast<uint64_t>(UINT16_MAX) * tcsFactor[0][0] >> SHIFT <= UINT32_MAX,
+		"normalised counts fit 32 bits");
+// ----------------------------------------------------------------------------
+
+// Settings of a sensor as an index, for tables kept per setting (baseline.hpp)
+enum : uint8_t {
+	TCS_SETTINGS	= 4 * 5,
+	V6040_SETTINGS	= 6,
+	V6070_SETTINGS	= 4
+};
+
+constexpr uint8_t
+setting(modm::tcs3472::Gain gain, modm::tcs3472::IntegrationTime t) {
+	return ( static_cast<uint8_t>(gain) & 0x03 ) * 5 + tcsIndex(t);
+}
+
+constexpr uint8_t
+setting(modm::veml6040::IntegrationTime t) {
+	return ( static_cast<uint8_t>(t) >> 4 ) % V6040_SETTINGS;
+}
+
+constexpr uint8_t
+setting(modm::veml6070::IntegrationTime t) {
+	return ( static_cast<uint8_t>(t) >> 2 ) & 0x03;
+}
+// ----------------------------------------------------------------------------
+
+constexpr uint32_t
+factor(modm::tcs3472::Gain gain, modm::tcs3472::IntegrationTime t) {
+	return tcsFactor[static_cast<uint8_t>(gain) & 0x03][tcsIndex(t)];
+}
+
+constexpr uint32_t
+factor(modm::veml6040::IntegrationTime t) {
+	return v6040Factor[setting(t)];
+}
+
+constexpr uint32_t
+factor(modm::veml6070::IntegrationTime t) {
+	return v6070Factor[setting(t)];
+}
+
+}	// namespace scale
+// ----------------------------------------------------------------------------
+
+#endif	// SCALE_HPP
@@ -0,0 +1,497 @@
+// ----------------------------------------------------------------------------
+
+#ifndef SCRIPT_HPP
+#define SCRIPT_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+
+#include <codec.hpp>
+// ----------------------------------------------------------------------------
+
+/// @brief On-device acquisition scripts
+///
+/// A measurement protocol (blank, inject, sample at 40 ms for 10 s, then at
+/// 320 ms for 5 min, ...) is uploaded line by line with 'script add' and
+/// runs on the device, the steps are timed by the main loop instead of
+/// the host and the UART. Source lines:
+///
+///		tcs | v6040 | v6070 | all <options>		a sensor command
+///		wait <ms>								the next step <ms> after this one
+///		repeat <n> ... end						the lines between n times (0 = forever)
+///		mark <n>								prints "Script mark <n>" (a step for the host)
+///		halt									Ctrl+C, the sensors stop polling
+///
+/// Each line is compiled to bytecode when it is added: an op byte, then
+/// varint values (codec.hpp), a sensor command as its words, each an index
+/// into `words` or a number. The options of a command are the ones of its
+/// getopt_long table (Tcs::options, ... in cli.hpp), long or short, one per
+/// word: an option is kept as the word of its long name, or as OPTION and
+/// its getopt character if `words` has none, and listed by its long name.
+/// The 76 bytes fit the RTC backup registers next to a header, that is
+/// where 'script save' keeps them over a reset.
+///
+/// Waits add up from the start of the script, not from when the step ran:
+/// a late pass of the main loop does not shift the steps after it.
+namespace script {
+
+enum : uint8_t {
+	CAPACITY	= 76,							// bytes of bytecode
+	DEPTH		= 3,							// nested repeats
+	STEPS		= 16,							// ops run by one step() at most
+	LINE		= 80,							// source line (Cli::CMD_LINE_LENGTH)
+	ARGS		= 10,							// words of a line (Cli::CMD_MAX_ARGC)
+	OPTION		= 0xFE,							// word: the getopt character of an option follows
+	NUMBER		= 0xFF							// word: a varint follows
+};
+
+enum Op : uint8_t {
+	Command		= 0x10,							// | words (1..9), the words
+	Wait		= 0x20,							// varint ms
+	Repeat		= 0x30,							// varint count, 0 = forever
+	End			= 0x40,							// end of the repeat body
+	Mark		= 0x50,							// varint n
+	Halt		= 0x60							// Ctrl+C
+};
+
+/// words of the sensor commands; saved scripts refer to them by index, so
+/// new ones go to the end
+inline const char* const	words[]	= {
+	"tcs", "v6040", "v6070", "all",
+	"--atime", "--again", "--wtime", "--wlong", "--period", "--phase", "--power",
+	"--blank", "--analyte", "--output", "--ack", "--restart", "--init", "--ping",
+	"2ms", "24ms", "101ms", "154ms", "700ms", "204ms", "614ms",
+	"X1", "X4", "X16", "X60",
+	"40ms", "80ms", "160ms", "320ms", "640ms", "1280ms",
+	"62.5ms", "125ms", "250ms", "500ms",
+	"free", "on", "gated", "off", "raw", "conc", "both",
+	"dark", "blank", "--zero", "--samples"
+};
+
+enum : uint8_t {
+	WORDS		= sizeof(words) / sizeof(words[0]),
+	SENSORS		= 4								// the first words name the command
+};
+
+/// option table of a command, ends with {0,0,0,0}
+typedef const struct option*	Options;
+
+enum class Error : uint8_t {
+	None,
+	Word,										// not a command, keyword or known word
+	Value,										// missing or not a number
+	Full,
+	Nesting										// end without repeat, repeats too deep
+};
+
+inline const char* const	errors[]	= {
+	"", "Invalid word", "Invalid value", "Script full", "Invalid repeat/end"
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Compiled script
+class Program {
+public:
+	/// @param options	of tcs, v6040 and v6070, in the order of `words`
+	explicit
+	Program(const Options (&options)[SENSORS - 1]) {
+		for (uint8_t s = 0; s < SENSORS - 1; ++s)	_options[s] = options[s];
+	}
+
+	/// @brief compile one source line, appended if it fits
+	Error
+	add(const char* const* argv, uint8_t argc) {
+		uint8_t
+		code[LINE];
+		uint8_t
+		n		= 0;
+		auto
+		put		= [&code, &n](uint8_t b) { if ( n < sizeof(code) )	code[n++] = b; };
+		uint32_t
+		value	= 0;
+
+		if ( argc == 0 )	return Error::Word;
+		const char*
+		w		= argv[0];
+		uint8_t
+		open	= _open;
+		if ( strcmp(w, "wait") == 0 || strcmp(w, "repeat") == 0 || strcmp(w, "mark") == 0 ) {
+			if ( argc != 2 || !number(argv[1], value) )	return Error::Value;
+			if ( w[0] == 'r' ) {
+				if ( open == DEPTH )	return Error::Nesting;
+				++open;
+			}
+			put(( w[0] == 'w' ) ? Wait : ( w[0] == 'r' ) ? Repeat : Mark);
+			codec::varint(value, put);
+		} else if ( strcmp(w, "end") == 0 || strcmp(w, "halt") == 0 ) {
+			if ( argc != 1 )	return Error::Value;
+			if ( w[0] == 'e' ) {
+				if ( open == 0 )	return Error::Nesting;
+				--open;
+			}
+			put(( w[0] == 'e' ) ? End : Halt);
+		} else {
+			const uint8_t
+			sensor	= find(w);
+			if ( sensor >= SENSORS || argc >= ARGS )	return Error::Word;
+			put(Command | argc);
+			put(sensor);
+			for (uint8_t i = 1; i < argc; ++i) {
+				const uint8_t
+				k		= find(argv[i]);
+				if ( argv[i][0] == '-' ) {
+					const struct option*
+					o		= option(sensor, argv[i]);
+					if ( !o )	return Error::Word;
+					const uint8_t
+					named	= findOption(o->name);
+					if ( named < WORDS ) {
+						put(named);
+					} else {
+						put(OPTION);
+						put(static_cast<uint8_t>(o->val));
+					}
+				} else if ( k < WORDS ) {
+					put(k);
+				} else if ( number(argv[i], value) ) {
+					put(NUMBER);
+					codec::varint(value, put);
+				} else {
+					return Error::Word;
+				}
+			}
+		}
+		if ( _length + n > CAPACITY )	return Error::Full;
+		memcpy(_code + _length, code, n);
+		_length	+= n;
+		_open	= open;
+		return Error::None;
+	}
+
+	void
+	clear() {
+		_length	= 0;
+		_open	= 0;
+	}
+
+	/// @brief take saved bytecode, checked op by op
+	bool
+	assign(const uint8_t* code, uint8_t length) {
+		if ( length > CAPACITY )	return false;
+		memcpy(_code, code, length);
+		_length	= length;
+		_open	= 0;
+		uint8_t
+		pc		= 0;
+		while ( pc < _length ) {
+			Op
+			op;
+			uint32_t
+			value;
+			pc		= decode(pc, op, value);
+			if ( pc == 0 )	break;
+			if ( op == Repeat && ++_open > DEPTH )	break;
+			if ( op == End && _open-- == 0 )		break;
+		}
+		if ( pc == _length && _open == 0 )	return true;
+		clear();
+		return false;
+	}
+
+	const uint8_t*
+	code() const				{ return _code; }
+
+	uint8_t
+	length() const				{ return _length; }
+
+	/// repeats without their end
+	uint8_t
+	open() const				{ return _open; }
+
+	/// @brief the op at pc
+	/// @param value	of Wait/Repeat/Mark, words of Command
+	/// @return pc of the next op, 0 if the op is broken
+	uint8_t
+	decode(uint8_t pc, Op& op, uint32_t& value) const {
+		if ( pc >= _length )	return 0;
+		const uint8_t
+		b		= _code[pc++];
+		op		= static_cast<Op>(b & 0xF0);
+		value	= 0;
+		switch ( op ) {
+		case Command: {
+			value	= b & 0x0F;
+			if ( value == 0 || value >= ARGS || pc >= _length || _code[pc] >= SENSORS )	return 0;
+			const uint8_t
+			sensor	= _code[pc];
+			for (uint32_t i = 0; i < value && pc; ++i) {
+				uint32_t
+				v;
+				if ( pc >= _length )			return 0;
+				if ( _code[pc] == NUMBER )		pc = number(pc + 1, v);
+				else if ( _code[pc] == OPTION )	pc = ( pc + 1 < _length && option(sensor, _code[pc + 1]) ) ? pc + 2 : 0;
+				else if ( _code[pc] < WORDS )	++pc;
+				else							return 0;
+			}
+			return pc;
+		}
+		case Wait:
+		case Repeat:
+		case Mark:
+			return ( b & 0x0F ) ? 0 : number(pc, value);
+		case End:
+		case Halt:
+			return ( b & 0x0F ) ? 0 : pc;
+		default:
+			return 0;
+		}
+	}
+
+	/// @brief source line of the op at pc, '\0'-terminated in s
+	/// @return pc of the next op, 0 at the end
+	uint8_t
+	line(uint8_t pc, char* s, uint8_t size) const {
+		Op
+		op;
+		uint32_t
+		value;
+		const uint8_t
+		next	= decode(pc, op, value);
+		uint8_t
+		n		= 0;
+		auto
+		append	= [s, size, &n](const char* w, bool word = true) {
+			if ( word && n && n + 1 < size )	s[n++] = ' ';
+			while ( *w && n + 1 < size )	s[n++] = *w++;
+		};
+		char
+		digits[11];
+		s[0]	= '\0';
+		if ( next == 0 )	return 0;
+		switch ( op ) {
+		case Command: {
+			const uint8_t
+			sensor	= _code[++pc];
+			for (uint32_t i = 0; i < value; ++i) {
+				if ( _code[pc] == NUMBER ) {
+					uint32_t
+					v;
+					pc		= number(pc + 1, v);
+					append(format(v, digits));
+				} else if ( _code[pc] == OPTION ) {
+					append("--");
+					append(option(sensor, _code[pc + 1])->name, false);
+					pc		+= 2;
+				} else {
+					append(words[_code[pc++]]);
+				}
+			}
+			break;
+		}
+		case Wait:		append("wait");		append(format(value, digits));	break;
+		case Repeat:	append("repeat");	append(format(value, digits));	break;
+		case Mark:		append("mark");		append(format(value, digits));	break;
+		case End:		append("end");		break;
+		case Halt:		append("halt");		break;
+		}
+		s[n]	= '\0';
+		return next;
+	}
+
+private:
+	static uint8_t
+	find(const char* w) {
+		uint8_t
+		k		= 0;
+		while ( k < WORDS && strcmp(w, words[k]) != 0 )	++k;
+		return k;
+	}
+
+	/// word of the long option name
+	static uint8_t
+	findOption(const char* name) {
+		uint8_t
+		k		= 0;
+		while ( k < WORDS && ( strncmp(words[k], "--", 2) != 0 || strcmp(words[k] + 2, name) != 0 ) )	++k;
+		return k;
+	}
+
+	/// @brief option of a sensor command, "--name" or "-c"; any sensor's for "all"
+	/// @return nullptr if the command has no such option
+	const struct option*
+	option(uint8_t sensor, const char* w) const {
+		for (uint8_t s = 0; s < SENSORS - 1; ++s) {
+			if ( s != sensor && sensor != SENSORS - 1 )	continue;
+			for (Options o = _options[s]; o->name; ++o) {
+				if ( ( w[1] == '-' ) ? strcmp(w + 2, o->name) == 0
+									 : ( w[1] == o->val && w[1] != '\0' && w[2] == '\0' ) )	return o;
+			}
+		}
+		return nullptr;
+	}
+
+	/// @brief option of a sensor command by its getopt character
+	const struct option*
+	option(uint8_t sensor, uint8_t c) const {
+		for (uint8_t s = 0; s < SENSORS - 1; ++s) {
+			if ( s != sensor && sensor != SENSORS - 1 )	continue;
+			for (Options o = _options[s]; o->name; ++o)
+				if ( o->val == c )	return o;
+		}
+		return nullptr;
+	}
+
+	/// decimal, no sign, fits 32 bits
+	static bool
+	number(const char* s, uint32_t& v) {
+		v		= 0;
+		if ( *s == '\0' )	return false;
+		for (; *s; ++s) {
+			if ( *s < '0' || *s > '9' || v > ( UINT32_MAX - 9 ) / 10 )	return false;
+			v	= v * 10 + static_cast<uint32_t>(*s - '0');
+		}
+		return true;
+	}
+
+	/// @brief varint at pc
+	/// @return pc after it, 0 if it runs past the end
+	uint8_t
+	number(uint8_t pc, uint32_t& v) const {
+		v		= 0;
+		for (uint8_t shift = 0; pc < _length && shift < 32; shift += 7) {
+			const uint8_t
+			b		= _code[pc++];
+			v		|= static_cast<uint32_t>(b & 0x7F) << shift;
+			if ( !( b & 0x80 ) )	return pc;
+		}
+		return 0;
+	}
+
+	static const char*
+	format(uint32_t v, char (&s)[11]) {
+		uint8_t
+		i		= sizeof(s) - 1;
+		s[i]	= '\0';
+		do {
+			s[--i]	= static_cast<char>('0' + v % 10);
+			v		/= 10;
+		} while ( v );
+		return s + i;
+	}
+
+	Options			_options[SENSORS - 1];
+	uint8_t			_code[CAPACITY];
+	uint8_t			_length		= 0;
+	uint8_t			_open		= 0;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Runs a Program, stepped by the main loop
+///
+/// `Host` provides
+///		bool	command(const char* line)	queue a command line, false = queue full
+///		bool	control(char c)				queue a control (Ctrl+C), false = queue full
+///		void	mark(uint32_t n)
+///		void	finished()
+/// An op the host can not take yet is tried again with the next step().
+class Runner {
+public:
+	void
+	start(uint32_t now) {
+		_pc			= 0;
+		_depth		= 0;
+		_at			= now;
+		_started	= now;
+		_running	= true;
+	}
+
+	void
+	stop()						{ _running = false; }
+
+	bool
+	running() const				{ return _running; }
+
+	/// next op to run
+	uint8_t
+	pc() const					{ return _pc; }
+
+	/// ms since start() of the next step
+	uint32_t
+	at() const					{ return _at - _started; }
+
+	template < typename Host >
+	void
+	step(const Program& p, uint32_t now, Host& host) {
+		for (uint8_t n = 0; n < STEPS && _running; ++n) {
+			if ( static_cast<int32_t>(now - _at) < 0 )	return;
+			if ( _pc >= p.length() ) {
+				_running	= false;
+				host.finished();
+				return;
+			}
+			Op
+			op;
+			uint32_t
+			value;
+			uint8_t
+			next	= p.decode(_pc, op, value);
+			switch ( op ) {
+			case Command: {
+				char
+				s[LINE];
+				p.line(_pc, s, sizeof(s));
+				if ( !host.command(s) )	return;
+				break;
+			}
+			case Wait:
+				_at		+= value;
+				break;
+			case Repeat:
+				if ( _depth == DEPTH )	next = 0;
+				else					_loops[_depth++] = { next, value };
+				break;
+			case End:
+				if ( _depth == 0 ) {
+					next	= 0;
+				} else {
+					Loop&
+					l		= _loops[_depth - 1];
+					if ( l.left == 0 || --l.left > 0 )	next = l.body;
+					else								--_depth;
+				}
+				break;
+			case Mark:
+				host.mark(value);
+				break;
+			case Halt:
+				if ( !host.control('\x03') )	return;
+				break;
+			}
+			if ( next == 0 ) {						// checked when added or loaded
+				_running	= false;
+				host.finished();
+				return;
+			}
+			_pc		= next;
+		}
+	}
+
+private:
+	struct Loop {
+		uint8_t		body;						// pc of the first op
+		uint32_t	left;						// runs, 0 = forever
+	};
+
+	Loop			_loops[DEPTH];
+	uint8_t			_depth		= 0;
+	uint8_t			_pc			= 0;
+	bool			_running	= false;
+	uint32_t		_at			= 0;			// ms of the next step
+	uint32_t		_started	= 0;
+};
+
+}	// namespace script
+// ----------------------------------------------------------------------------
+
+#endif	// SCRIPT_HPP
@@ -0,0 +1,66 @@
+// ----------------------------------------------------------------------------
+
+#ifndef SHADOW_HPP
+#define SHADOW_HPP
+
+#include <stdint.h>
+// ----------------------------------------------------------------------------
+
+/// @brief Shadow copies of the configuration registers of a device
+///
+/// A driver asks needed() before it writes a register: the write is only
+/// issued if the register content is unknown or differs, otherwise it is
+/// skipped and counted. After the write written() (or lost(), if it failed
+/// and the content is unknown now) keeps the copy up to date. A reset of
+/// the device (initialize, restart) loses all of them, the first
+/// configuration after it writes everything.
+///
+/// One byte of value and one bit of validity per register, the check is a
+/// compare, so it costs nothing against an I2C transaction.
+template < uint8_t Registers >
+class RegisterShadow {
+	static_assert(Registers <= 8, "one validity bit per register");
+
+public:
+	/// @return true if a write of value to the register has to be issued
+	bool
+	needed(uint8_t reg, uint8_t value) {
+		if ( ( _valid & ( 1 << reg ) ) && _values[reg] == value ) {
+			++_skipped;
+			return false;
+		}
+		return true;
+	}
+
+	/// @brief the write went through
+	void
+	written(uint8_t reg, uint8_t value) {
+		_values[reg]	= value;
+		_valid			|= ( 1 << reg );
+		++_issued;
+	}
+
+	/// @brief the content of a register is unknown (a failed write, or one
+	/// done by a driver without a shadow)
+	void
+	lost(uint8_t reg)			{ _valid &= ~( 1 << reg ); }
+
+	void
+	lost()						{ _valid = 0; }
+
+	/// writes issued and skipped
+	uint32_t
+	issued() const				{ return _issued; }
+
+	uint32_t
+	skipped() const				{ return _skipped; }
+
+private:
+	uint8_t			_values[Registers]	= {};
+	uint8_t			_valid				= 0;
+	uint32_t		_issued				= 0;
+	uint32_t		_skipped			= 0;
+};
+// ----------------------------------------------------------------------------
+
+#endif	// SHADOW_HPP
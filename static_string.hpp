@@ -0,0 +1,113 @@
+// ----------------------------------------------------------------------------
+
+#ifndef STATIC_STRING_HPP
+#define STATIC_STRING_HPP
+
+#include <stdint.h>
+#include <string.h>
+// ----------------------------------------------------------------------------
+
+/// @brief std::string replacement of fixed capacity (the part the CLI uses)
+///
+/// Up to `N` characters in place, no heap. What does not fit is cut off and
+/// remembered: truncated() tells an option value that was too long from a
+/// valid shorter one.
+template < uint8_t N >
+class StaticString {
+public:
+	StaticString()					{ clear(); }
+
+	StaticString(const char* s)		{ assign(s); }
+
+	StaticString&
+	operator=(const char* s)		{ assign(s); return *this; }
+
+	StaticString&
+	operator+=(char c) {
+		if ( _length < N )	{
+			_s[_length++]	= c;
+			_s[_length]		= '\0';
+		} else {
+			_truncated		= true;
+		}
+		return *this;
+	}
+
+	void
+	assign(const char* s) {
+		const size_t
+		n			= s ? strlen(s) : 0;
+		_length		= ( n > N ) ? N : static_cast<uint8_t>(n);
+		_truncated	= ( n > N );
+		memcpy(_s, s, _length);
+		_s[_length]	= '\0';
+	}
+
+	void
+	clear()							{
+		_length		= 0;
+		_truncated	= false;
+		_s[0]		= '\0';
+	}
+
+	void
+	pop_back()						{ if ( _length )	_s[--_length] = '\0'; }
+
+	bool
+	empty() const					{ return _length == 0; }
+
+	uint8_t
+	length() const					{ return _length; }
+
+	uint8_t
+	size() const					{ return _length; }
+
+	static constexpr uint8_t
+	capacity()						{ return N; }
+
+	bool
+	truncated() const				{ return _truncated; }
+
+	const char*
+	c_str() const					{ return _s; }
+
+	char
+	operator[](uint8_t i) const		{ return _s[i]; }
+
+	bool
+	operator==(const char* s) const	{ return strcmp(_s, s) == 0; }
+
+	bool
+	operator!=(const char* s) const	{ return strcmp(_s, s) != 0; }
+
+private:
+	char			_s[N + 1];
+	uint8_t			_length;
+	bool			_truncated;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief non-owning view of a C string that compares by content
+class StringRef {
+public:
+	explicit
+	StringRef(const char* s): _s(s)	{}
+
+	const char*
+	c_str() const					{ return _s; }
+
+	bool
+	empty() const					{ return _s[0] == '\0'; }
+
+	bool
+	operator==(const char* s) const	{ return strcmp(_s, s) == 0; }
+
+	bool
+	operator!=(const char* s) const	{ return strcmp(_s, s) != 0; }
+
+private:
+	const char*		_s;
+};
+// ----------------------------------------------------------------------------
+
+#endif	// STATIC_STRING_HPP
@@ -0,0 +1,168 @@
+// ----------------------------------------------------------------------------
+
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <stdint.h>
+// ----------------------------------------------------------------------------
+
+/// @brief Running statistics of one channel (Welford, integer only)
+///
+/// mean is kept as Q24.8 and the sum of squared deviations M2 as Q8,
+/// so a sample costs one division and a few integer multiplies. The mean
+/// is the exact sum over n, rounded, not updated by delta / n: that one
+/// stops moving once |delta| < n and M2 would inherit the error.
+class RunningStat {
+public:
+	enum { FRAC = 8 };
+
+	RunningStat()				{ reset(); }
+
+	void
+	reset()						{
+		_sum	= 0;
+		_mean	= 0;
+		_m2		= 0;
+		_min	= UINT16_MAX;
+		_max	= 0;
+	}
+
+	/// @param n number of samples including x
+	void
+	add(uint16_t x, uint32_t n) {
+		const int32_t
+		xq		= static_cast<int32_t>(x) << FRAC;
+		const int32_t
+		delta	= xq - _mean;
+		_sum	+= x;
+		_mean	= static_cast<int32_t>(( ( _sum << FRAC ) + n / 2 ) / n);
+		_m2		+= static_cast<uint64_t>(static_cast<int64_t>(delta) * (xq - _mean)) >> FRAC;
+
+		if ( x < _min )	_min = x;
+		if ( x > _max )	_max = x;
+	}
+
+	/// @brief mean, Q24.8
+	int32_t
+	mean() const				{ return _mean; }
+
+	/// @brief sample variance, Q8
+	uint64_t
+	variance(uint32_t n) const	{ return ( n > 1 ) ? _m2 / (n - 1) : 0; }
+
+	/// @brief standard deviation, Q8 (sqrt of the variance in Q16)
+	uint32_t
+	stddev(uint32_t n) const	{ return isqrt(variance(n) << FRAC); }
+
+	uint16_t
+	min() const					{ return _min; }
+
+	uint16_t
+	max() const					{ return _max; }
+
+	static uint32_t
+	isqrt(uint64_t v) {
+		uint64_t	r	= 0;
+		uint64_t	bit	= 1ULL << 62;
+		while ( bit > v )	bit >>= 2;
+		while ( bit ) {
+			if ( v >= r + bit ) {
+				v	-= r + bit;
+				r	= (r >> 1) + bit;
+			} else {
+				r	>>= 1;
+			}
+			bit	>>= 2;
+		}
+		return static_cast<uint32_t>(r);
+	}
+
+private:
+	uint64_t		_sum;
+	int32_t			_mean;
+	uint64_t		_m2;
+	uint16_t		_min;
+	uint16_t		_max;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Running statistics of all channels of one sensor
+///
+/// window = 0: accumulate since the last reset.
+/// window = N: tumbling window, every N samples the finished window is
+/// kept in last() and accumulation restarts. No sample history is stored.
+template < uint8_t Channels >
+class Statistics {
+public:
+	struct Window {
+		RunningStat		ch[Channels];
+		uint32_t		count;
+		uint32_t		startMs;
+		uint32_t		endMs;
+
+		/// @brief samples per second, Q8
+		uint32_t
+		rate() const			{
+			const uint32_t
+			dt		= endMs - startMs;
+			return ( count > 1 && dt ) ? static_cast<uint32_t>((static_cast<uint64_t>(count - 1) * 1000 << RunningStat::FRAC) / dt) : 0;
+		}
+	};
+
+	Statistics():
+		_window(0),
+		_hasLast(false)			{
+		reset(0);
+	}
+
+	void
+	reset(uint32_t nowMs)		{
+		for (uint8_t i = 0; i < Channels; ++i)	_now.ch[i].reset();
+		_now.count		= 0;
+		_now.startMs	= nowMs;
+		_now.endMs		= nowMs;
+		_hasLast		= false;
+	}
+
+	void
+	setWindow(uint32_t n, uint32_t nowMs) {
+		_window	= n;
+		reset(nowMs);
+	}
+
+	uint32_t
+	window() const				{ return _window; }
+
+	void
+	add(const uint16_t (&x)[Channels], uint32_t nowMs) {
+		if ( _now.count == 0 )	_now.startMs = nowMs;
+		++_now.count;
+		_now.endMs	= nowMs;
+		for (uint8_t i = 0; i < Channels; ++i)
+			_now.ch[i].add(x[i], _now.count);
+
+		if ( _window && _now.count >= _window ) {
+			_last		= _now;
+			_hasLast	= true;
+			for (uint8_t i = 0; i < Channels; ++i)	_now.ch[i].reset();
+			_now.count	= 0;
+		}
+	}
+
+	/// @brief window being accumulated
+	const Window&
+	current() const				{ return _now; }
+
+	/// @brief last finished window (only with window > 0)
+	const Window*
+	last() const				{ return _hasLast ? &_last : nullptr; }
+
+private:
+	Window			_now;
+	Window			_last;
+	uint32_t		_window;
+	bool			_hasLast;
+};
+// ----------------------------------------------------------------------------
+
+#endif	// STATS_HPP
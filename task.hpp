@@ -0,0 +1,320 @@
+// ----------------------------------------------------------------------------
+
+#ifndef TASK_HPP
+#define TASK_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <coroutine>
+#include <utility>
+
+#include <modm/processing.hpp>
+// ----------------------------------------------------------------------------
+
+// Coroutine frames live in a static arena of TASK_FRAMES blocks of
+// TASK_FRAME_SIZE bytes, never on the heap. The compiler decides the size of
+// a frame; TaskArena::largest() tells what the tasks of a build asked for.
+#ifndef TASK_FRAMES
+#define TASK_FRAMES			4
+#endif
+
+#ifndef TASK_FRAME_SIZE
+#define TASK_FRAME_SIZE		256
+#endif
+// ----------------------------------------------------------------------------
+
+/// @brief Static storage of the coroutine frames
+class TaskArena {
+public:
+	/// @return a free block of at least `size` bytes or nullptr
+	static void*
+	allocate(size_t size) {
+		if ( size > _largest )	_largest = size;
+		if ( size <= TASK_FRAME_SIZE ) {
+			for (uint8_t i = 0; i < TASK_FRAMES; ++i) {
+				if ( !( _used & ( 1u << i ) ) ) {
+					_used	|= 1u << i;
+					return _blocks[i].bytes;
+				}
+			}
+		}
+		++_failed;
+		return nullptr;
+	}
+
+	static void
+	release(void* p) {
+		for (uint8_t i = 0; i < TASK_FRAMES; ++i)
+			if ( p == _blocks[i].bytes )	_used &= ~( 1u << i );
+	}
+
+	/// frames in use
+	static uint8_t
+	used() {
+		uint8_t
+		n		= 0;
+		for (uint8_t i = 0; i < TASK_FRAMES; ++i)
+			if ( _used & ( 1u << i ) )	++n;
+		return n;
+	}
+
+	/// largest frame asked for, bytes
+	static size_t
+	largest()					{ return _largest; }
+
+	/// tasks that did not get a frame (too large or no block left)
+	static uint16_t
+	failed()					{ return _failed; }
+
+private:
+	static_assert(TASK_FRAMES <= 32, "TASK_FRAMES must fit the use mask");
+
+	struct alignas(8) Block {
+		uint8_t			bytes[TASK_FRAME_SIZE];
+	};
+
+	inline static Block		_blocks[TASK_FRAMES];
+	inline static uint32_t	_used		= 0;
+	inline static size_t	_largest	= 0;
+	inline static uint16_t	_failed		= 0;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Sensor task as a C++20 coroutine, an alternative to a protothread
+///
+/// Written as a plain function returning Task, with co_await where the
+/// protothread has PT_WAIT_UNTIL/PT_CALL:
+///
+///		Task
+///		sensor(Cli::Cmd& ctl) {
+///			while ( !co_await task::call([&]{ return colorSensor.ping(); }) )
+///				co_await task::sleep(timeout, 150);
+///			...
+///		}
+///
+/// and driven like one, update() once per main loop pass. Local variables
+/// and loops survive a suspension, so there is no ptState to poke: a
+/// reconfiguration is a `continue` of the configuration loop instead of a
+/// PT_CASE_SET() jump.
+///
+/// The awaited condition is kept in the promise and checked by update()
+/// itself, the coroutine is only resumed once it holds: a pass that has
+/// nothing to do costs one indirect call, not a switch over all the lines
+/// of the task. The frame comes from TaskArena; if none is left the Task is
+/// empty (valid() false) and update() returns false, nothing is allocated.
+class Task {
+public:
+	struct promise_type {
+		static void*
+		operator new(size_t size) noexcept	{ return TaskArena::allocate(size); }
+
+		static void
+		operator delete(void* p) noexcept	{ TaskArena::release(p); }
+
+		static Task
+		get_return_object_on_allocation_failure()	{ return Task(); }
+
+		Task
+		get_return_object()			{ return Task(Handle::from_promise(*this)); }
+
+		std::suspend_always
+		initial_suspend() noexcept	{ return {}; }
+
+		std::suspend_always
+		final_suspend() noexcept	{ return {}; }
+
+		void
+		return_void()				{}
+
+		void
+		unhandled_exception()		{ __builtin_trap(); }
+
+		/// @brief suspend until awaiter->ready()
+		template < typename Awaiter >
+		void
+		wait(Awaiter* awaiter) {
+			_ready		= [](void* a) { return static_cast<Awaiter*>(a)->ready(); };
+			_awaiter	= awaiter;
+		}
+
+	private:
+		friend class Task;
+
+		bool			(*_ready)(void*)	= nullptr;
+		void*			_awaiter			= nullptr;
+	};
+
+	using Handle	= std::coroutine_handle<promise_type>;
+
+	Task() = default;
+
+	Task(Task&& other): _handle(other._handle)	{ other._handle = nullptr; }
+
+	Task&
+	operator=(Task&& other) {
+		if ( this != &other ) {
+			if ( _handle )	_handle.destroy();
+			_handle			= other._handle;
+			other._handle	= nullptr;
+		}
+		return *this;
+	}
+
+	Task(const Task&)				= delete;
+	Task& operator=(const Task&)	= delete;
+
+	~Task()						{ if ( _handle )	_handle.destroy(); }
+
+	/// @return false if the task did not get a frame
+	bool
+	valid() const				{ return static_cast<bool>(_handle); }
+
+	/// @brief run the task up to its next co_await whose condition is not met
+	/// @return true while the task is running (as Protothread::update())
+	bool
+	update() {
+		if ( !_handle || _handle.done() )	return false;
+		promise_type&
+		p		= _handle.promise();
+		if ( p._ready && !p._ready(p._awaiter) )	return true;
+		p._ready	= nullptr;
+		_handle.resume();
+		return !_handle.done();
+	}
+
+	bool
+	isRunning() const			{ return _handle && !_handle.done(); }
+
+private:
+	explicit
+	Task(Handle h): _handle(h)	{}
+
+	Handle			_handle;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Awaitables of a Task
+namespace task {
+
+/// @brief base of the awaitables: Awaiter::ready() is checked once when
+/// awaited and then once per update() until it holds
+template < typename Awaiter >
+struct Await {
+	bool
+	await_ready()				{ return static_cast<Awaiter*>(this)->ready(); }
+
+	void
+	await_suspend(Task::Handle h)	{ h.promise().wait(static_cast<Awaiter*>(this)); }
+};
+
+/// co_await yield(): resume with the next update()
+struct Yield : Await<Yield> {
+	bool
+	ready() {
+		const bool
+		polled	= _polled;
+		_polled	= true;
+		return polled;
+	}
+
+	void
+	await_resume()				{}
+
+	bool			_polled		= false;
+};
+
+inline Yield
+yield()							{ return {}; }
+
+/// co_await until(cond): resume once cond() is true
+template < typename Fn >
+struct Until : Await<Until<Fn>> {
+	explicit
+	Until(Fn fn): _fn(fn)		{}
+
+	bool
+	ready()						{ return _fn(); }
+
+	void
+	await_resume()				{}
+
+	Fn				_fn;
+};
+
+template < typename Fn >
+Until<Fn>
+until(Fn fn)					{ return Until<Fn>(fn); }
+
+/// co_await sleep(timeout, ms): restart a modm timeout, resume once expired
+template < typename Timeout >
+struct Sleep : Await<Sleep<Timeout>> {
+	Sleep(Timeout& timeout, uint32_t ms): _timeout(timeout)	{ _timeout.restart(ms); }
+
+	bool
+	ready()						{ return _timeout.isExpired(); }
+
+	void
+	await_resume()				{}
+
+	Timeout&		_timeout;
+};
+
+template < typename Timeout >
+Sleep<Timeout>
+sleep(Timeout& timeout, uint32_t ms)	{ return Sleep<Timeout>(timeout, ms); }
+
+/// @brief co_await call(fn): a modm resumable function (an I2C transaction
+/// of a driver), fn() is its call and is repeated once per update() until
+/// the function stops, as PT_CALL() does
+/// @return the result of the resumable function
+template < typename Fn >
+struct Call : Await<Call<Fn>> {
+	using Result	= decltype(std::declval<Fn&>()());
+	using Value		= decltype(std::declval<Result&>().getResult());
+
+	explicit
+	Call(Fn fn): _fn(fn), _result(modm::rf::Running, Value())	{}
+
+	bool
+	ready() {
+		_result		= _fn();
+		return _result.getState() <= modm::rf::NestingError;
+	}
+
+	Value
+	await_resume()				{ return _result.getResult(); }
+
+	Fn				_fn;
+	Result			_result;
+};
+
+template < typename Fn >
+Call<Fn>
+call(Fn fn)						{ return Call<Fn>(fn); }
+
+/// @brief co_await command(ctl): resume once the CLI has a command for the
+/// task (ctl != Cmd::None)
+/// @return the command, the task resets ctl once it is done with it
+template < typename Cmd >
+struct Command : Await<Command<Cmd>> {
+	explicit
+	Command(const Cmd& ctl): _ctl(ctl)	{}
+
+	bool
+	ready()						{ return _ctl != Cmd::None; }
+
+	Cmd
+	await_resume()				{ return _ctl; }
+
+	const Cmd&		_ctl;
+};
+
+template < typename Cmd >
+Command<Cmd>
+command(const Cmd& ctl)			{ return Command<Cmd>(ctl); }
+
+}	// namespace task
+// ----------------------------------------------------------------------------
+
+#endif	// TASK_HPP
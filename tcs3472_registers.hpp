@@ -0,0 +1,122 @@
+// ----------------------------------------------------------------------------
+
+#ifndef TCS3472_REGISTERS_HPP
+#define TCS3472_REGISTERS_HPP
+
+#include <stdint.h>
+
+#include <modm/architecture/interface/i2c_device.hpp>
+#include <shadow.hpp>
+
+namespace modm
+{
+/**
+ * \brief	Configuration and shutdown of the TCS3472, with a register shadow
+ *
+ * The driver writes gain, integration and wait time every time it is
+ * configured, and powers the sensor up in initialize() (PON, AEN in the
+ * ENABLE register) but has no way back. These writes are done here
+ * instead, each one only if the register does not hold the value already
+ * (shadow.hpp).
+ *
+ * Clearing ENABLE stops the RGBC cycle and the oscillator: the sensor goes
+ * to sleep (2.5 uA instead of 235 uA) and keeps its configuration and the
+ * last conversion. The driver's initialize() wakes it up again, the first
+ * conversion starts after 2.4 ms.
+ *
+ * \tparam	I2CMaster	I2C interface which needs an \em initialized
+ * 						modm::i2c::Master
+ */
+template < typename I2cMaster >
+class Tcs3472Registers : public modm::I2cDevice< I2cMaster, 2 >
+{
+public:
+	enum : uint8_t
+	{
+		COMMAND		= 0x80,	//!< command bit of the register address
+		ENABLE		= 0x00,	//!< PON, AEN
+		ATIME		= 0x01,	//!< integration time
+		WTIME		= 0x03,	//!< wait time
+		CONTROL		= 0x0F,	//!< gain
+		PON_AEN		= 0x03,	//!< ENABLE as initialize() leaves it
+	};
+
+	Tcs3472Registers(uint8_t address = 0x29)
+	: I2cDevice<I2cMaster,2>(address), buffer{0, 0}
+	{
+	}
+
+	//! \brief	gain, integration and wait time, the changed ones
+	modm::ResumableResult<bool>
+	configure(uint8_t gain, uint8_t atime, uint8_t wtime)
+	{
+		RF_BEGIN();
+
+		if ( RF_CALL(write(CONTROL, gain)) and
+			 RF_CALL(write(ATIME, atime)) and
+			 RF_CALL(write(WTIME, wtime)) ) {
+			RF_RETURN(true);
+		}
+
+		RF_END_RETURN(false);
+	}
+
+	//! \brief	clear PON/AEN: sleep
+	modm::ResumableResult<bool>
+	shutdown()
+	{
+		return write(ENABLE, 0);
+	}
+
+	//! \brief	the driver's initialize() powered the sensor up; after a
+	//!			reset (restart) the other registers are unknown as well
+	void
+	initialized(bool reset)
+	{
+		if ( reset )	shadow.lost();
+		shadow.written(slot(ENABLE), PON_AEN);
+	}
+
+	//! \brief	writes issued and skipped (unchanged)
+	const RegisterShadow<4>&
+	writes() const
+	{
+		return shadow;
+	}
+
+private:
+	static constexpr uint8_t
+	slot(uint8_t reg)
+	{
+		return ( reg == CONTROL ) ? 3 : ( reg == WTIME ) ? 2 : reg;
+	}
+
+	modm::ResumableResult<bool>
+	write(uint8_t reg, uint8_t value)
+	{
+		RF_BEGIN();
+
+		// the register holds the value already
+		if ( !shadow.needed(slot(reg), value) ) {
+			RF_RETURN(true);
+		}
+
+		buffer[0]	= COMMAND | reg;
+		buffer[1]	= value;
+		this->transaction.configureWrite(buffer, 2);
+
+		if ( RF_CALL( this->runTransaction() ) ) {
+			shadow.written(slot(reg), value);
+			RF_RETURN(true);
+		}
+		shadow.lost(slot(reg));
+
+		RF_END_RETURN(false);
+	}
+
+	uint8_t				buffer[2];
+	RegisterShadow<4>	shadow;		//!< ENABLE, ATIME, WTIME, CONTROL
+};
+}
+
+#endif // TCS3472_REGISTERS_HPP
@@ -0,0 +1,279 @@
+// ----------------------------------------------------------------------------
+
+#ifndef TIMING_HPP
+#define TIMING_HPP
+
+#include <stdint.h>
+
+#include <modm/board.hpp>
+
+#if !defined(DWT)
+#include <chrono>
+#endif
+// ----------------------------------------------------------------------------
+
+/// @brief Main loop timing: pass time, wake lateness and overruns
+namespace timing {
+
+/// @brief free-running 32-bit tick counter: the DWT cycle counter of the
+/// Cortex-M, a ns clock on the host (replay)
+inline uint32_t		ticksPerUs	= 1000;
+
+/// @brief start the tick counter
+/// @param hz	core clock
+inline void
+start(uint32_t hz) {
+#if defined(DWT)
+	CoreDebug->DEMCR	|= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT			= 0;
+	DWT->CTRL			|= DWT_CTRL_CYCCNTENA_Msk;
+	ticksPerUs			= ( hz >= 1000000 ) ? hz / 1000000 : 1;
+#else
+	(void) hz;
+#endif
+}
+
+inline uint32_t
+ticks() {
+#if defined(DWT)
+	return DWT->CYCCNT;
+#else
+	return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+// ----------------------------------------------------------------------------
+
+/// @brief histogram with power-of-2 buckets
+///
+/// Bucket 0 counts 0, bucket b counts [2^(b-1), 2^b), the last one
+/// everything above. A few hundred bytes cover us to seconds with the
+/// resolution a jitter report needs.
+template < uint8_t Buckets >
+class LogHistogram {
+public:
+	LogHistogram()				{ clear(); }
+
+	void
+	add(uint32_t v) {
+		++_bins[bucket(v)];
+		++_count;
+		if ( v > _max )	_max = v;
+	}
+
+	void
+	clear() {
+		for (uint8_t b = 0; b < Buckets; ++b)	_bins[b] = 0;
+		_count	= 0;
+		_max	= 0;
+	}
+
+	static uint8_t
+	bucket(uint32_t v) {
+		const uint8_t
+		b		= v ? static_cast<uint8_t>(32 - __builtin_clz(v)) : 0;
+		return ( b < Buckets ) ? b : Buckets - 1;
+	}
+
+	/// smallest value of bucket b
+	static uint32_t
+	lower(uint8_t b)			{ return b ? 1u << (b - 1) : 0; }
+
+	/// largest value of bucket b (UINT32_MAX for the last one)
+	static uint32_t
+	upper(uint8_t b)			{ return ( b + 1 < Buckets ) ? ( 1u << b ) - 1 : UINT32_MAX; }
+
+	static constexpr uint8_t
+	buckets()					{ return Buckets; }
+
+	uint32_t
+	bin(uint8_t b) const		{ return _bins[b]; }
+
+	uint32_t
+	count() const				{ return _count; }
+
+	uint32_t
+	max() const					{ return _max; }
+
+	/// @return upper bound of the bucket that holds the `permille` quantile,
+	/// never above max()
+	uint32_t
+	quantile(uint16_t permille) const {
+		if ( _count == 0 )		return 0;
+		const uint64_t
+		rank	= ( static_cast<uint64_t>(_count) * permille + 999 ) / 1000;
+		uint64_t
+		seen	= 0;
+		for (uint8_t b = 0; b < Buckets; ++b) {
+			seen	+= _bins[b];
+			if ( seen >= rank )	return ( upper(b) < _max ) ? upper(b) : _max;
+		}
+		return _max;
+	}
+
+private:
+	uint32_t		_bins[Buckets];
+	uint32_t		_count;
+	uint32_t		_max;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief Timing of the main loop and of the tasks it runs
+///
+/// The loop is cut into `Tasks` sections (cli, one per sensor thread, ...):
+/// begin() at the top, mark(task) after each section, end() at the bottom.
+/// Pass times (us) go into one histogram, the longest time of each section
+/// is kept. A task that sleeps until a deadline reports it with wake():
+/// how late it woke (ms, the clock of the timeouts) goes into a histogram
+/// per task.
+///
+/// A pass longer than `budget` us or a wake later than `tolerance` ms is an
+/// overrun. It is blamed on the slowest section of the pass (for a late
+/// wake: of this pass so far and the previous one, whatever kept the loop
+/// from coming back in time), counted per culprit and the last OVERRUNS of
+/// them are kept. Nothing is printed from here: the report is read through
+/// the CLI, printing would stall the loop it measures.
+template < uint8_t Tasks >
+class LoopMonitor {
+public:
+	enum : uint8_t {
+		LOOP		= Tasks,				// Overrun::task of a long pass
+		OVERRUNS	= 4,
+		PASS_BUCKETS	= 20,				// us, up to 0.5 s
+		WAKE_BUCKETS	= 12				// ms, up to 2 s
+	};
+
+	struct Overrun {
+		uint32_t		ms;					// clock at detection
+		uint32_t		amount;				// pass us (LOOP) | ms late
+		uint8_t			task;				// LOOP | the late task
+		uint8_t			culprit;			// slowest section
+	};
+
+	using PassHistogram	= LogHistogram<PASS_BUCKETS>;
+	using WakeHistogram	= LogHistogram<WAKE_BUCKETS>;
+
+	LoopMonitor()				{ reset(); }
+
+	/// @brief forget everything measured, keep budget and tolerance
+	void
+	reset() {
+		_pass.clear();
+		for (uint8_t i = 0; i < Tasks; ++i) {
+			_wake[i].clear();
+			_worst[i]	= 0;
+			_blamed[i]	= 0;
+			_current[i]	= 0;
+			_previous[i]	= 0;
+		}
+		_overruns	= 0;
+	}
+
+	void
+	begin()						{ _start = _mark = ticks(); }
+
+	/// @brief section `task` is done
+	void
+	mark(uint8_t task) {
+		const uint32_t
+		now		= ticks(),
+		us		= ( now - _mark ) / ticksPerUs;
+		_mark	= now;
+		_current[task]	+= us;
+		if ( _current[task] > _worst[task] )	_worst[task] = _current[task];
+	}
+
+	/// @param ms	clock of the timeouts
+	void
+	end(uint32_t ms) {
+		const uint32_t
+		us		= ( _mark - _start ) / ticksPerUs;
+		_pass.add(us);
+		if ( budget && us > budget )	overrun(ms, us, LOOP, slowest(false));
+		for (uint8_t i = 0; i < Tasks; ++i) {
+			_previous[i]	= _current[i];
+			_current[i]		= 0;
+		}
+	}
+
+	/// @brief task woke up from a sleep that was due at `scheduled`
+	void
+	wake(uint8_t task, uint32_t scheduled, uint32_t ms) {
+		const uint32_t
+		late	= ( ms > scheduled ) ? ms - scheduled : 0;
+		_wake[task].add(late);
+		if ( late > tolerance )	overrun(ms, late, task, slowest(true));
+	}
+
+	const PassHistogram&
+	pass() const				{ return _pass; }
+
+	const WakeHistogram&
+	wakeLateness(uint8_t task) const	{ return _wake[task]; }
+
+	/// longest time of a section in one pass, us
+	uint32_t
+	worst(uint8_t task) const	{ return _worst[task]; }
+
+	/// overruns blamed on a section
+	uint32_t
+	blamed(uint8_t task) const	{ return _blamed[task]; }
+
+	uint32_t
+	overruns() const			{ return _overruns; }
+
+	/// @brief i-th last overrun (0 = the latest), i < kept()
+	const Overrun&
+	last(uint8_t i) const		{ return _last[( _overruns - 1 - i ) % OVERRUNS]; }
+
+	uint8_t
+	kept() const				{ return ( _overruns < OVERRUNS ) ? static_cast<uint8_t>(_overruns) : uint8_t(OVERRUNS); }
+
+	uint32_t		budget		= 10000;	// us per pass, 0 = off
+	uint32_t		tolerance	= 5;		// ms late
+	void			(*onOverrun)(const Overrun&)	= nullptr;	// e.g. a trace point
+
+private:
+	uint8_t
+	slowest(bool previous) const {
+		uint8_t
+		s		= 0;
+		uint32_t
+		t		= 0;
+		for (uint8_t i = 0; i < Tasks; ++i) {
+			const uint32_t
+			d		= ( previous && _previous[i] > _current[i] ) ? _previous[i] : _current[i];
+			if ( d > t ) {
+				t	= d;
+				s	= i;
+			}
+		}
+		return s;
+	}
+
+	void
+	overrun(uint32_t ms, uint32_t amount, uint8_t task, uint8_t culprit) {
+		Overrun&
+		o		= _last[_overruns % OVERRUNS];
+		o		= { ms, amount, task, culprit };
+		++_overruns;
+		++_blamed[culprit];
+		if ( onOverrun )	onOverrun(o);
+	}
+
+	PassHistogram	_pass;
+	WakeHistogram	_wake[Tasks];
+	uint32_t		_worst[Tasks];
+	uint32_t		_blamed[Tasks];
+	uint32_t		_current[Tasks];		// us of each section, this pass
+	uint32_t		_previous[Tasks];		// and the last one
+	uint32_t		_start		= 0;
+	uint32_t		_mark		= 0;
+	uint32_t		_overruns;
+	Overrun			_last[OVERRUNS];
+};
+
+}	// namespace timing
+// ----------------------------------------------------------------------------
+
+#endif	// TIMING_HPP
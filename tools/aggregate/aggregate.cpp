@@ -0,0 +1,683 @@
+// ----------------------------------------------------------------------------
+// Live aggregation of many concentrators on their serial ports
+//
+// Usage: aggregate [-j threads] [-w window_ms] [-b baud] [-t s] [-o out]
+//				   [-F fakes [-p period_ms]] [<tty>...]
+//
+// Opens every <tty> non-blocking in raw mode and spreads them over `threads`
+// workers, each waiting on its own epoll set (edge triggered, reads until
+// EAGAIN): with 100+ devices a worker wakes once for all ports that have
+// data, not once per port. A worker parses the text sample records of its
+// devices (the format of 'report', see tools/ingest) and stamps each with
+// the host time of the read that completed it. The merger takes the
+// frames from the workers every window/4 and writes them ordered by time
+// once they are older than the window, one line per frame:
+//		<ms since start> <device> <tcs|v6040|v6070> <counts...> [hue | A C]
+// (hue if the device outputs it, 'report --fields'; sat and val are not kept).
+// A frame that comes in after younger ones were written (its worker was
+// held up longer than the window) is written at once and counted as late.
+// Binary 'dump' blocks are decoded to skip them (ingest/dumpdecode are
+// for those). A device that goes away (EIO, hang-up) is reopened every s.
+//
+// The text records carry no device time: frames of one device are in
+// their order, across devices the order is that of arrival, blurred by
+// the latency timer of USB-serial adapters (typ. 16 ms).
+//
+// Per device on stderr at the end (and on SIGUSR1): frames, bytes, lines
+// that were not understood, times it went away, the delay from read to
+// output (mean, max), the largest gap between two frames and late frames;
+// then the CPU time of the process. -F N creates N ptys as stand-ins for devices and
+// writes a record every period_ms to each (phases spread over the period).
+// ----------------------------------------------------------------------------
+
+#include <codec.hpp>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+// ----------------------------------------------------------------------------
+
+namespace {
+
+enum Stream : uint8_t {
+	TCS, V6040, V6070,
+	STREAMS,
+	DUMP									// skipping a dump block
+};
+
+const char* const	streamNames[STREAMS]	= {"tcs", "v6040", "v6070"};
+
+struct Options {
+	unsigned int	threads		= std::min(4u, std::max(1u, std::thread::hardware_concurrency()));
+	uint32_t		window		= 50;			// ms
+	uint32_t		baud		= 115200;
+	double			seconds		= 0;			// 0: until SIGINT/SIGTERM
+	uint32_t		fakes		= 0;
+	uint32_t		period		= 100;			// ms, fake devices
+	std::string		out;
+};
+
+Options				options;
+std::atomic<bool>	running{true};
+std::atomic<bool>	statsRequested{false};
+
+uint64_t
+nowUs() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+uint64_t			startUs;
+// ----------------------------------------------------------------------------
+
+struct Frame {
+	uint64_t		us;						// host time of the read
+	uint32_t		device;
+	Stream			stream;
+	uint32_t		ch[4];					// raw, or normalised up to ~1e9 ('report --units norm')
+	uint16_t		hue;					// UINT16_MAX if absent
+	float			a;						// v6070 absorbance / concentration, NaN if absent
+	float			c;
+};
+
+struct Later {
+	bool
+	operator()(const Frame& x, const Frame& y) const {
+		return ( x.us != y.us ) ? x.us > y.us : x.device > y.device;
+	}
+};
+
+/// @brief one serial port, owned by one worker
+struct Device {
+	std::string		path;
+	uint32_t		index;
+	int				fd			= -1;
+	uint64_t		retryUs		= 0;		// reopen after
+
+	// parser
+	std::string		line;					// incomplete line
+	Stream			sensor		= STREAMS;	// last header
+	std::unique_ptr<codec::BlockDecoder>	dump;
+
+	// worker side counters
+	std::atomic<uint64_t>	bytes{0};
+	std::atomic<uint64_t>	bad{0};
+	std::atomic<uint32_t>	lost{0};		// went away
+
+	// merger side
+	uint64_t		delaySum	= 0;
+	uint64_t		delayMax	= 0;
+	uint64_t		lastUs		= 0;
+	uint64_t		gapMax		= 0;
+	uint64_t		late		= 0;
+	uint64_t		written		= 0;
+};
+
+std::vector<std::unique_ptr<Device>>	devices;
+// ----------------------------------------------------------------------------
+
+bool
+setRaw(int fd, uint32_t baud) {
+	struct termios
+	tio;
+	if ( tcgetattr(fd, &tio) != 0 )	return false;
+	cfmakeraw(&tio);
+	tio.c_cflag	|= CLOCAL | CREAD;
+	const speed_t
+	speed	= ( baud == 9600 ) ? B9600 : ( baud == 19200 ) ? B19200 : ( baud == 38400 ) ? B38400 :
+			  ( baud == 57600 ) ? B57600 : ( baud == 230400 ) ? B230400 : ( baud == 460800 ) ? B460800 :
+			  ( baud == 921600 ) ? B921600 : B115200;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+
+bool
+number(const char*& p, const char* end, uint32_t& v) {
+	while ( p < end && *p == ' ' )	++p;
+	if ( p == end || *p < '0' || *p > '9' )	return false;
+	v	= 0;
+	while ( p < end && *p >= '0' && *p <= '9' )
+		v	= v * 10 + (*p++ - '0');
+	return true;
+}
+
+bool
+decimal(const char*& p, const char* end, float& v) {
+	while ( p < end && *p == ' ' )	++p;
+	char*
+	e		= nullptr;
+	const std::string
+	s(p, end);
+	v		= strtof(s.c_str(), &e);
+	if ( e == s.c_str() )	return false;
+	p		+= e - s.c_str();
+	return true;
+}
+
+bool
+starts(const char* line, size_t len, const char* s) {
+	const size_t	n	= strlen(s);
+	return len >= n && memcmp(line, s, n) == 0;
+}
+
+/// @brief the labels after "RGBW" up to ':' ('report --fields')
+/// @return bits of hue, sat, val, -1 if it is no sample line
+int
+fields(const char*& p, const char* end) {
+	static const char* const
+	labels[3]	= { "Hue", "Sat", "Val" };
+	int
+	mask	= 0;
+	while ( p < end && *p == ' ' ) {
+		++p;
+		uint8_t
+		i		= 0;
+		while ( i < 3 && ( end - p < 3 || memcmp(p, labels[i], 3) != 0 ) )	++i;
+		if ( i == 3 )	return -1;
+		mask	|= ( 1 << i );
+		p		+= 3;
+	}
+	if ( p == end || *p != ':' )	return -1;
+	++p;
+	return mask;
+}
+
+/// @brief one complete line of a device, a sample is appended to `out`
+void
+parseLine(Device& d, const char* line, size_t len, uint64_t us, std::vector<Frame>& out) {
+	if ( len && line[len - 1] == '\r' )	--len;
+	if ( len == 0 )	return;
+
+	// a header may follow an unterminated prompt ("/>VEML6070")
+	if ( len >= 8 ) {
+		const char*
+		tail	= line + len - 8;
+		if ( memcmp(tail, "TCS34725", 8) == 0 )	{ d.sensor = TCS;	return; }
+		if ( memcmp(tail, "VEML6040", 8) == 0 )	{ d.sensor = V6040;	return; }
+		if ( memcmp(tail, "VEML6070", 8) == 0 )	{ d.sensor = V6070;	return; }
+	}
+
+	const Stream
+	sensor	= d.sensor;
+	d.sensor	= STREAMS;
+	const char*
+	end		= line + len;
+	Frame
+	f{};
+	f.us		= us;
+	f.device	= d.index;
+	f.stream	= sensor;
+	f.a			= NAN;
+	f.c			= NAN;
+
+	if ( ( sensor == TCS || sensor == V6040 ) && starts(line, len, "RGBW") ) {
+		const char*
+		p		= line + 4;
+		const int
+		mask	= fields(p, end);
+		uint32_t	v[7];
+		uint8_t
+		n		= 4;
+		for (uint8_t i = 0; i < 3; ++i)
+			if ( mask & ( 1 << i ) )	++n;
+		for (uint8_t i = 0; i < n; ++i) {
+			if ( mask < 0 || !number(p, end, v[i]) ) {
+				++d.bad;
+				return;
+			}
+		}
+		for (uint8_t i = 0; i < 4; ++i)	f.ch[i] = v[i];
+		f.hue	= ( mask & 1 ) ? static_cast<uint16_t>(v[4]) : UINT16_MAX;
+	} else if ( sensor == V6070 && ( starts(line, len, "Uv:") || starts(line, len, " A:") ) ) {
+		const char*
+		p		= line;
+		uint32_t
+		counts	= 0;
+		if ( starts(line, len, "Uv:") ) {
+			p	+= 3;
+			if ( !number(p, end, counts) ) {
+				++d.bad;
+				return;
+			}
+		}
+		while ( p < end && *p == ' ' )	++p;
+		if ( end - p > 2 && memcmp(p, "A:", 2) == 0 ) {
+			p	+= 2;
+			decimal(p, end, f.a);
+			while ( p < end && *p == ' ' )	++p;
+			if ( end - p > 2 && memcmp(p, "C:", 2) == 0 ) {
+				p	+= 2;
+				decimal(p, end, f.c);
+			}
+		}
+		f.ch[0]	= counts;
+	} else {
+		char			name[16];
+		unsigned int	n, ch, dropped;
+		if ( starts(line, len, "DUMP v1 ") &&
+			 sscanf(std::string(line, len).c_str(), "DUMP v1 %15s n=%u ch=%u dropped=%u", name, &n, &ch, &dropped) == 4 ) {
+			d.dump.reset(new codec::BlockDecoder(static_cast<uint8_t>(ch), n));
+			d.sensor	= DUMP;
+		} else if ( sensor != STREAMS ) {
+			++d.bad;						// a header without its values
+		}
+		return;								// prompts, replies, alarms, heartbeats
+	}
+	out.push_back(f);
+}
+
+void
+parse(Device& d, const char* p, size_t n, uint64_t us, std::vector<Frame>& out) {
+	while ( n ) {
+		if ( d.sensor == DUMP ) {
+			while ( n && !d.dump->done() ) {
+				d.dump->put(static_cast<uint8_t>(*p++), []() {});
+				--n;
+			}
+			if ( d.dump->done() ) {
+				d.dump.reset();
+				d.sensor	= STREAMS;
+			}
+			continue;
+		}
+		const char*
+		nl		= static_cast<const char*>(memchr(p, '\n', n));
+		if ( nl == nullptr ) {
+			if ( d.line.size() + n > 256 ) {	// binary noise, not a line
+				d.line.clear();
+				++d.bad;
+			} else {
+				d.line.append(p, n);
+			}
+			return;
+		}
+		const size_t
+		len		= nl - p;
+		if ( d.line.empty() ) {
+			parseLine(d, p, len, us, out);
+		} else {
+			d.line.append(p, len);
+			parseLine(d, d.line.data(), d.line.size(), us, out);
+			d.line.clear();
+		}
+		p		+= len + 1;
+		n		-= len + 1;
+	}
+}
+// ----------------------------------------------------------------------------
+
+/// @brief reads its share of the devices
+class Worker {
+public:
+	Worker()					{ _epoll = epoll_create1(EPOLL_CLOEXEC); }
+
+	~Worker()					{ ::close(_epoll); }
+
+	void
+	add(Device* d)				{ _devices.push_back(d); }
+
+	/// frames since the last call
+	void
+	take(std::vector<Frame>& into) {
+		std::lock_guard<std::mutex>
+		lock(_mutex);
+		into.insert(into.end(), _frames.begin(), _frames.end());
+		_frames.clear();
+	}
+
+	void
+	run() {
+		for (Device* d : _devices)	open(*d);
+
+		epoll_event
+		events[64];
+		std::vector<char>
+		buf(4096);
+		std::vector<Frame>
+		local;
+		while ( running ) {
+			const int
+			n		= epoll_wait(_epoll, events, 64, 250);
+			const uint64_t
+			us		= nowUs();
+			for (int i = 0; i < n; ++i) {
+				Device&
+				d		= *static_cast<Device*>(events[i].data.ptr);
+				bool
+				gone	= ( events[i].events & ( EPOLLHUP | EPOLLERR ) ) != 0;
+				while ( !gone ) {
+					const ssize_t
+					r		= ::read(d.fd, buf.data(), buf.size());
+					if ( r > 0 ) {
+						d.bytes	+= r;
+						parse(d, buf.data(), r, us, local);
+						continue;
+					}
+					if ( r < 0 && ( errno == EAGAIN || errno == EINTR ) )	break;
+					gone	= true;					// 0 or EIO: unplugged
+				}
+				if ( gone )	close(d, us, true);
+			}
+			if ( !local.empty() ) {
+				std::lock_guard<std::mutex>
+				lock(_mutex);
+				_frames.insert(_frames.end(), local.begin(), local.end());
+				local.clear();
+			}
+			for (Device* d : _devices)
+				if ( d->fd < 0 && us >= d->retryUs )	open(*d);
+		}
+		for (Device* d : _devices)	close(*d, 0, false);
+	}
+
+private:
+	void
+	open(Device& d) {
+		d.fd	= ::open(d.path.c_str(), O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+		if ( d.fd >= 0 && isatty(d.fd) )	setRaw(d.fd, options.baud);
+		epoll_event
+		ev{};
+		ev.events	= EPOLLIN | EPOLLET;
+		ev.data.ptr	= &d;
+		if ( d.fd < 0 || epoll_ctl(_epoll, EPOLL_CTL_ADD, d.fd, &ev) != 0 ) {
+			if ( d.fd >= 0 )	::close(d.fd);
+			d.fd		= -1;
+			d.retryUs	= nowUs() + 1000000;
+			return;
+		}
+		d.line.clear();
+		d.sensor	= STREAMS;
+		d.dump.reset();
+	}
+
+	void
+	close(Device& d, uint64_t us, bool lost) {
+		if ( d.fd < 0 )	return;
+		epoll_ctl(_epoll, EPOLL_CTL_DEL, d.fd, nullptr);
+		::close(d.fd);
+		d.fd		= -1;
+		d.retryUs	= us + 1000000;
+		if ( lost )	++d.lost;
+	}
+
+	int						_epoll;
+	std::vector<Device*>	_devices;
+	std::mutex				_mutex;
+	std::vector<Frame>		_frames;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief orders the frames of all workers by time, writes them out
+class Merger {
+public:
+	explicit Merger(FILE* out) : _out(out)	{}
+
+	void
+	step(std::vector<std::unique_ptr<Worker>>& workers, bool flush) {
+		_incoming.clear();
+		for (auto& w : workers)	w->take(_incoming);
+		const uint64_t
+		now		= nowUs();
+		for (const Frame& f : _incoming) {
+			if ( f.us < _written ) {			// younger frames are out already
+				++devices[f.device]->late;
+				write(f, now);
+			} else {
+				_heap.push(f);
+			}
+		}
+		const uint64_t
+		horizon	= now - options.window * 1000ull;
+		while ( !_heap.empty() && ( flush || _heap.top().us <= horizon ) ) {
+			write(_heap.top(), now);
+			_written	= _heap.top().us;
+			_heap.pop();
+		}
+		fflush(_out);
+	}
+
+private:
+	void
+	write(const Frame& f, uint64_t now) {
+		Device&
+		d		= *devices[f.device];
+		const uint64_t
+		delay	= now - f.us;
+		d.delaySum	+= delay;
+		d.delayMax	= std::max(d.delayMax, delay);
+		if ( d.lastUs && f.us > d.lastUs )	d.gapMax = std::max(d.gapMax, f.us - d.lastUs);
+		d.lastUs	= f.us;
+		++d.written;
+
+		const uint64_t
+		t		= f.us - startUs;
+		fprintf(_out, "%llu.%03u %s %s", static_cast<unsigned long long>(t / 1000),
+				static_cast<unsigned int>(t % 1000), d.path.c_str(), streamNames[f.stream]);
+		if ( f.stream == V6070 ) {
+			fprintf(_out, " %u", f.ch[0]);
+			if ( !std::isnan(f.a) )	fprintf(_out, " %.3f", f.a);
+			if ( !std::isnan(f.c) )	fprintf(_out, " %.3f", f.c);
+		} else {
+			fprintf(_out, " %u %u %u %u", f.ch[0], f.ch[1], f.ch[2], f.ch[3]);
+			if ( f.hue != UINT16_MAX )	fprintf(_out, " %u", f.hue);
+		}
+		fputc('\n', _out);
+	}
+
+	FILE*				_out;
+	std::vector<Frame>	_incoming;
+	std::priority_queue<Frame, std::vector<Frame>, Later>	_heap;
+	uint64_t			_written	= 0;
+};
+// ----------------------------------------------------------------------------
+
+void
+printStats() {
+	fprintf(stderr, "%-20s %9s %11s %5s %4s %9s %9s %9s %6s\n",
+			"device", "frames", "bytes", "bad", "lost", "delay ms", "max ms", "gap ms", "late");
+	uint64_t
+	frames	= 0;
+	for (const auto& d : devices) {
+		frames	+= d->written;
+		fprintf(stderr, "%-20s %9llu %11llu %5llu %4u %9.2f %9.2f %9.1f %6llu\n", d->path.c_str(),
+				static_cast<unsigned long long>(d->written), static_cast<unsigned long long>(d->bytes.load()),
+				static_cast<unsigned long long>(d->bad.load()), d->lost.load(),
+				d->written ? d->delaySum / 1000.0 / d->written : 0.0, d->delayMax / 1000.0, d->gapMax / 1000.0,
+				static_cast<unsigned long long>(d->late));
+	}
+	struct rusage
+	ru;
+	getrusage(RUSAGE_SELF, &ru);
+	const double
+	cpu		= ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6,
+	wall	= ( nowUs() - startUs ) / 1e6;
+	fprintf(stderr, "%zu devices, %llu frames in %.1f s, cpu %.2f s (%.1f%% of one core)\n", devices.size(),
+			static_cast<unsigned long long>(frames), wall, cpu, wall > 0 ? 100.0 * cpu / wall : 0.0);
+}
+// ----------------------------------------------------------------------------
+
+/// @brief pty stand-ins: a record every period to each of them
+class Fakes {
+public:
+	/// @return slave paths
+	std::vector<std::string>
+	create(uint32_t n) {
+		std::vector<std::string>
+		paths;
+		for (uint32_t i = 0; i < n; ++i) {
+			const int
+			fd		= posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+			if ( fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0 ) {
+				perror("posix_openpt");
+				exit(1);
+			}
+			const std::string
+			path	= ptsname(fd);
+			// raw slave, kept open so that the master does not see a hang-up
+			const int
+			slave	= ::open(path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+			if ( slave < 0 || !setRaw(slave, options.baud) ) {
+				perror(path.c_str());
+				exit(1);
+			}
+			_masters.push_back(fd);
+			_slaves.push_back(slave);
+			paths.push_back(path);
+		}
+		return paths;
+	}
+
+	void
+	run() {
+		const uint64_t
+		period	= options.period * 1000ull,
+		n		= _masters.size();
+		uint64_t
+		seq		= 0;
+		char
+		buf[128];
+		while ( running ) {
+			// device i writes at i * period / n within each period
+			const uint64_t
+			now		= nowUs() - startUs,
+			slot	= now * n / period;
+			for (; seq <= slot && running; ++seq) {
+				const uint64_t
+				i		= seq % n;
+				const unsigned int
+				v		= static_cast<unsigned int>(( seq * 37 + i * 101 ) % 60000);
+				const int
+				len		= ( i % 3 == 2 ) ?
+					snprintf(buf, sizeof(buf), "VEML6070\nUv: %5u\n", v) :
+					snprintf(buf, sizeof(buf), "%s\nRGBW Hue: %5u %5u %5u %5u  %5u\n",
+							( i % 3 == 0 ) ? "TCS34725" : "VEML6040", v, v / 2, v / 3, v + 7, v % 360);
+				if ( ::write(_masters[i], buf, len) != len )	++_dropped;
+			}
+			const uint64_t
+			next	= ( slot + 1 ) * period / n;
+			if ( next > now )	std::this_thread::sleep_for(std::chrono::microseconds(next - now));
+		}
+	}
+
+	uint64_t
+	dropped() const				{ return _dropped; }
+
+	~Fakes() {
+		for (int fd : _masters)	::close(fd);
+		for (int fd : _slaves)	::close(fd);
+	}
+
+private:
+	std::vector<int>	_masters;
+	std::vector<int>	_slaves;
+	uint64_t			_dropped	= 0;
+};
+// ----------------------------------------------------------------------------
+
+void
+usage(const char* name) {
+	fprintf(stderr, "usage: %s [-j threads] [-w window_ms] [-b baud] [-t s] [-o out] [-F fakes [-p period_ms]] [<tty>...]\n", name);
+	exit(2);
+}
+
+}	// namespace
+// ----------------------------------------------------------------------------
+
+int
+main(int argc, char** argv) {
+	int	opt;
+	while ( (opt = getopt(argc, argv, "j:w:b:t:o:F:p:")) != -1 ) {
+		switch ( opt ) {
+		case 'j':	options.threads	= std::max(1, atoi(optarg));				break;
+		case 'w':	options.window	= strtoul(optarg, nullptr, 10);				break;
+		case 'b':	options.baud	= strtoul(optarg, nullptr, 10);				break;
+		case 't':	options.seconds	= strtod(optarg, nullptr);					break;
+		case 'o':	options.out		= optarg;									break;
+		case 'F':	options.fakes	= strtoul(optarg, nullptr, 10);				break;
+		case 'p':	options.period	= std::max(1ul, strtoul(optarg, nullptr, 10));	break;
+		default:	usage(argv[0]);
+		}
+	}
+	if ( optind >= argc && options.fakes == 0 )	usage(argv[0]);
+
+	startUs	= nowUs();
+	Fakes
+	fakes;
+	std::vector<std::string>
+	paths	= fakes.create(options.fakes);
+	for (int i = optind; i < argc; ++i)	paths.push_back(argv[i]);
+	for (const std::string& p : paths) {
+		devices.emplace_back(new Device);
+		devices.back()->path	= p;
+		devices.back()->index	= static_cast<uint32_t>(devices.size() - 1);
+	}
+
+	FILE*
+	out		= options.out.empty() ? stdout : fopen(options.out.c_str(), "w");
+	if ( out == nullptr ) {
+		perror(options.out.c_str());
+		return 1;
+	}
+	setvbuf(out, nullptr, _IOFBF, 1 << 16);
+
+	struct sigaction
+	sa{};
+	sa.sa_handler	= [](int) { running = false; };
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGTERM, &sa, nullptr);
+	sa.sa_handler	= [](int) { statsRequested = true; };
+	sigaction(SIGUSR1, &sa, nullptr);
+
+	const unsigned int
+	threads	= std::min<unsigned int>(options.threads, devices.size());
+	std::vector<std::unique_ptr<Worker>>
+	workers;
+	for (unsigned int i = 0; i < threads; ++i)	workers.emplace_back(new Worker);
+	for (size_t i = 0; i < devices.size(); ++i)	workers[i % threads]->add(devices[i].get());
+
+	std::vector<std::thread>
+	pool;
+	for (auto& w : workers)	pool.emplace_back([&w]() { w->run(); });
+	std::thread
+	feeder;
+	if ( options.fakes )	feeder = std::thread([&fakes]() { fakes.run(); });
+
+	Merger
+	merger(out);
+	const uint64_t
+	endUs	= options.seconds > 0 ? startUs + static_cast<uint64_t>(options.seconds * 1e6) : UINT64_MAX;
+	while ( running ) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(std::max(1u, options.window / 4)));
+		merger.step(workers, false);
+		if ( statsRequested.exchange(false) )	printStats();
+		if ( nowUs() >= endUs )	running = false;
+	}
+
+	if ( feeder.joinable() )	feeder.join();
+	for (auto& t : pool)	t.join();
+	merger.step(workers, true);
+	printStats();
+	if ( options.fakes )	fprintf(stderr, "fake devices: %llu records not written (pty full)\n",
+									static_cast<unsigned long long>(fakes.dropped()));
+	if ( out != stdout )	fclose(out);
+	return 0;
+}
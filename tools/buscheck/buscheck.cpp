@@ -0,0 +1,234 @@
+// ----------------------------------------------------------------------------
+// Check of the sample channel (bus.hpp): one publisher, several readers
+//
+// Usage: buscheck [-n messages] [-r readers]
+//
+// Every reader has to see each message exactly once and in order, or count
+// it as lost: the messages it saw plus lost() are all that were published,
+// and the gaps in the numbers it saw are lost() exactly. A message whose
+// release() succeeded must be the one published under its number, whole.
+//
+//	passes	the firmware case: publisher and readers take turns in one
+//			thread, readers consume every 1, 2, ... passes, the slow ones
+//			fall behind more than the slots and lose the oldest messages
+//	inuse	a reader holds a message while the publisher wraps the slots,
+//			release() has to report it
+//	threads	publisher and readers in their own threads (the seqlock case),
+//			some readers slowed down, so overruns and (on more than one
+//			core) overwrites meanwhile happen at random
+//
+// Prints a line per reader, exits with 1 if a check failed.
+// ----------------------------------------------------------------------------
+
+#include <bus.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+// ----------------------------------------------------------------------------
+
+namespace {
+
+enum { SLOTS = 8, WORDS = 6 };
+
+/// the number, and words derived from it a torn copy would not match
+struct Message {
+	uint32_t		n;
+	uint32_t		words[WORDS];
+
+	void
+	fill(uint32_t number) {
+		n	= number;
+		for (uint32_t i = 0; i < WORDS; ++i)	words[i] = number * 2654435761u + i;
+	}
+
+	bool
+	whole() const {
+		for (uint32_t i = 0; i < WORDS; ++i)
+			if ( words[i] != n * 2654435761u + i )	return false;
+		return true;
+	}
+};
+
+typedef Channel<Message, SLOTS>	TestChannel;
+
+/// what a reader saw
+struct Tally {
+	uint32_t		seen		= 0;
+	uint32_t		last		= 0;				// number of the last message seen
+	uint32_t		gaps		= 0;				// numbers skipped between them
+	uint32_t		overwritten	= 0;				// release() false
+	uint32_t		errors		= 0;				// out of order, wrong number, torn
+
+	/// @brief a copy taken between read() and release()
+	void
+	take(const Message& m, bool released) {
+		if ( !released ) {
+			++overwritten;
+			return;
+		}
+		if ( !m.whole() || m.n <= last )	++errors;
+		else								gaps += m.n - last - 1;
+		last	= m.n;
+		++seen;
+	}
+};
+
+bool	failed	= false;
+
+void
+verdict(const char* test, unsigned int reader, const Tally& t, const TestChannel::Reader& r, uint32_t published,
+		bool expectLoss) {
+	const uint32_t
+	missing	= t.gaps + ( published - t.last );			// skipped and never seen at the end
+	const bool
+	ok		= ( t.errors == 0 && t.seen + r.lost() == published && missing == r.lost() &&
+				r.next() == published + 1 && ( !expectLoss || r.lost() > 0 ) );
+	printf("%-8s reader %u: seen %u lost %u gaps %u overwritten %u errors %u  %s\n", test, reader,
+		   t.seen, r.lost(), missing, t.overwritten, t.errors, ok ? "ok" : "FAILED");
+	if ( !ok )	failed = true;
+}
+
+void
+read(const TestChannel& channel, TestChannel::Reader& r, Tally& t) {
+	while ( const Message* m = channel.read(r) ) {
+		const Message
+		copy	= *m;
+		t.take(copy, channel.release(r));
+	}
+}
+// ----------------------------------------------------------------------------
+
+void
+passes(uint32_t messages, unsigned int readers) {
+	TestChannel
+	channel;
+	std::vector<TestChannel::Reader>
+	r(readers);
+	std::vector<Tally>
+	t(readers);
+	for (auto& reader : r)	channel.subscribe(reader);
+
+	// 3 messages per pass: a reader every 3rd pass or slower overruns 8 slots
+	const uint32_t
+	BURST	= 3;
+	uint32_t
+	published	= 0;
+	for (uint32_t pass = 1; published < messages; ++pass) {
+		for (uint32_t i = 0; i < BURST && published < messages; ++i) {
+			channel.claim().fill(++published);
+			channel.publish();
+		}
+		for (unsigned int i = 0; i < readers; ++i)
+			if ( pass % (i + 1) == 0 )	read(channel, r[i], t[i]);
+	}
+	for (unsigned int i = 0; i < readers; ++i) {
+		read(channel, r[i], t[i]);
+		verdict("passes", i, t[i], r[i], published, i + 1 >= BURST);
+	}
+}
+
+void
+inUse() {
+	TestChannel
+	channel;
+	TestChannel::Reader
+	r;
+	channel.subscribe(r);
+	channel.claim().fill(1);
+	channel.publish();
+
+	Tally
+	t;
+	const Message*
+	m		= channel.read(r);
+	for (uint32_t n = 2; n <= SLOTS + 1; ++n) {			// wraps onto the slot of message 1
+		channel.claim().fill(n);
+		channel.publish();
+	}
+	const Message
+	copy	= *m;
+	t.take(copy, channel.release(r));
+	read(channel, r, t);
+	if ( t.overwritten != 1 ) {
+		printf("inuse    release() did not report the overwritten message  FAILED\n");
+		failed	= true;
+	}
+	verdict("inuse", 0, t, r, SLOTS + 1, true);
+}
+
+void
+threads(uint32_t messages, unsigned int readers) {
+	TestChannel
+	channel;
+	std::vector<TestChannel::Reader>
+	r(readers);
+	std::vector<Tally>
+	t(readers);
+	for (auto& reader : r)	channel.subscribe(reader);
+
+	std::vector<std::thread>
+	consumers;
+	for (unsigned int i = 0; i < readers; ++i) {
+		consumers.emplace_back([&, i]() {
+			// reader 0 as fast as it can, the others slower and slower
+			volatile uint32_t
+			spin	= 0;
+			while ( r[i].next() <= messages ) {
+				while ( const Message* m = channel.read(r[i]) ) {
+					const Message
+					copy	= *m;
+					for (uint32_t k = 0; k < i * 50; ++k)	spin = spin + 1;
+					t[i].take(copy, channel.release(r[i]));
+				}
+				std::this_thread::yield();
+			}
+		});
+	}
+
+	for (uint32_t n = 1; n <= messages; ++n) {
+		channel.claim().fill(n);
+		channel.publish();
+		if ( n % 32 == 0 )	std::this_thread::yield();
+	}
+	for (auto& c : consumers)	c.join();
+	for (unsigned int i = 0; i < readers; ++i)
+		verdict("threads", i, t[i], r[i], messages, false);
+}
+
+void
+usage(const char* name) {
+	fprintf(stderr, "usage: %s [-n messages] [-r readers]\n", name);
+	exit(2);
+}
+
+}	// namespace
+// ----------------------------------------------------------------------------
+
+int
+main(int argc, char** argv) {
+	uint32_t
+	messages	= 1000000;
+	unsigned int
+	readers		= 4;
+	int
+	opt;
+	while ( (opt = getopt(argc, argv, "n:r:")) != -1 ) {
+		switch (opt) {
+		case 'n':	messages	= strtoul(optarg, nullptr, 0);	break;
+		case 'r':	readers		= strtoul(optarg, nullptr, 0);	break;
+		default:	usage(argv[0]);
+		}
+	}
+	if ( optind != argc || messages == 0 || readers == 0 || readers > 16 )	usage(argv[0]);
+
+	printf("channel of %u slots, %u messages, %u readers\n\n", SLOTS, messages, readers);
+	passes(messages, readers);
+	inUse();
+	threads(messages, readers);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,306 @@
+// ----------------------------------------------------------------------------
+// Simulated I2C bus: what overlapping reads with processing gains
+//
+// Usage: busmodel [-f bus_hz] [-i handler_us] [-p process_us] [-t s] [-s sensors]
+//
+// The three sensors are read back to back as fast as the bus and the CPU
+// allow, in 0.1 us steps. A read is the byte sequence of the drivers
+// (address, register, restart, data), the CPU runs the I2C event handlers
+// (they hold the bus, clock stretching) before the processing of the
+// samples (decode, stats, history, alarms, output: -p per sample). A
+// sensor is read again when one of its buffers is free, i.e. its last
+// sample is processed (one buffer) or the other one is (two buffers).
+//
+//	serial	read, then process, nothing overlaps
+//	irq/1	interrupt per byte, one buffer per sensor (I2cMaster1, static data)
+//	irq/2	interrupt per byte, double buffered
+//	dma/1	DMA data phases (modelled only, the firmware uses I2cMaster1), one buffer
+//	dma/2	DMA and double buffered
+//
+// Printed per mode: samples/s, bus and CPU use, mean age of a sample when
+// its processing is done and the gain over serial and irq/1.
+//
+// With all three sensors (the default) the second buffer gains nothing:
+// while a sample of one sensor is processed the bus reads the others, so
+// irq/2 == irq/1 and dma/2 == dma/1. It pays off where one sensor is read
+// back to back and its processing is about as long as its read, the next
+// read then overlaps the previous sample:
+//
+//	busmodel -s v6040 -p 1500				irq/2 and dma/2 1.75 x irq/1
+//	busmodel -f 400000 -s v6040 -p 500		irq/2 and dma/2 1.84 x irq/1
+// ----------------------------------------------------------------------------
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+// ----------------------------------------------------------------------------
+
+static const uint32_t	TICKS_PER_US	= 10;
+
+/// one write-read of a driver: register bytes written, data bytes read
+struct Transfer {
+	uint8_t			write;
+	uint8_t			read;
+};
+
+struct SensorModel {
+	const char*				name;
+	std::vector<Transfer>	transfers;				// of one sample
+};
+
+// as the drivers read: TCS3472 RGBC in one auto-increment read, VEML6040
+// one 2-byte read per channel, VEML6070 one byte from the read address
+static const SensorModel	sensorModels[]	= {
+	{ "tcs",	{ { 1, 8 } } },
+	{ "v6040",	{ { 1, 2 }, { 1, 2 }, { 1, 2 }, { 1, 2 } } },
+	{ "v6070",	{ { 0, 1 } } },
+};
+
+struct Mode {
+	const char*		name;
+	bool			overlap;
+	bool			dma;
+	uint8_t			buffers;
+};
+
+static const Mode	modes[]	= {
+	{ "serial",	false,	false,	1 },
+	{ "irq/1",	true,	false,	1 },
+	{ "irq/2",	true,	false,	2 },
+	{ "dma/1",	true,	true,	1 },
+	{ "dma/2",	true,	true,	2 },
+};
+
+struct Parameters {
+	uint32_t		busHz		= 100000;
+	double			handlerUs	= 2.5;			// one event handler
+	double			processUs	= 400;			// one sample
+	double			seconds		= 2;
+	std::vector<const SensorModel*>	sensors;
+};
+
+/// bus time and whether an event handler has to run after it
+struct Step {
+	uint32_t		ticks;
+	bool			event;
+};
+
+struct Result {
+	uint64_t		samples		= 0;
+	uint64_t		busTicks	= 0;
+	uint64_t		handlerTicks	= 0;
+	uint64_t		processTicks	= 0;
+	uint64_t		ageTicks	= 0;			// read started -> processed, summed
+	uint64_t		ticks		= 0;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief bus steps of one sample
+///
+/// Events: SB and ADDR of each (re)start, then per byte (interrupts) or
+/// at the end of a data phase (DMA: BTF after a write, transfer complete
+/// after a read; a 1-byte read goes through RXNE either way).
+static std::vector<Step>
+steps(const SensorModel& s, const Parameters& p, bool dma) {
+	const uint32_t
+	bit		= static_cast<uint32_t>(1e6 * TICKS_PER_US / p.busHz),
+	byte	= 9 * bit;
+	std::vector<Step>
+	v;
+	for (const Transfer& t : s.transfers) {
+		if ( t.write ) {
+			v.push_back({ bit, true });					// START, SB
+			v.push_back({ byte, true });				// address, ADDR
+			for (uint8_t i = 0; i < t.write; ++i)
+				v.push_back({ byte, !dma || i + 1 == t.write });
+		}
+		v.push_back({ bit, true });						// (RE)START, SB
+		v.push_back({ byte, true });					// address, ADDR
+		for (uint8_t i = 0; i < t.read; ++i)
+			v.push_back({ byte, !dma || t.read < 2 || i + 1 == t.read });
+		v.push_back({ bit, false });					// STOP
+	}
+	return v;
+}
+
+static Result
+simulate(const Mode& m, const Parameters& p) {
+	const size_t
+	n		= p.sensors.size();
+	std::vector<std::vector<Step>>
+	seq(n);
+	for (size_t i = 0; i < n; ++i)	seq[i] = steps(*p.sensors[i], p, m.dma);
+
+	const uint32_t
+	handler	= static_cast<uint32_t>(p.handlerUs * TICKS_PER_US + 0.5),
+	process	= static_cast<uint32_t>(p.processUs * TICKS_PER_US + 0.5);
+	const uint64_t
+	end		= static_cast<uint64_t>(p.seconds * 1e6 * TICKS_PER_US);
+
+	struct Job {
+		size_t			sensor;
+		uint64_t		started;				// read started
+	};
+
+	Result
+	r;
+	std::vector<uint8_t>
+	used(n, 0);									// buffers being read or waiting / in processing
+	std::deque<Job>
+	queue;										// read, not processed yet
+
+	// bus
+	int				reading		= -1;			// sensor, -1 idle
+	size_t			step		= 0;
+	uint32_t		left		= 0;			// ticks of the step on the bus
+	bool			stretched	= false;		// waits for its event handler
+	uint64_t		started		= 0;
+	size_t			next		= 0;			// round robin
+
+	// CPU
+	uint32_t		pending		= 0;			// handler ticks
+	uint32_t		job			= 0;			// processing ticks left
+	Job				current		= { 0, 0 };
+
+	for (uint64_t now = 0; now < end; ++now) {
+		// --- bus: start a read
+		if ( reading < 0 && ( m.overlap || ( job == 0 && queue.empty() ) ) ) {
+			for (size_t k = 0; k < n; ++k) {
+				const size_t
+				s		= ( next + k ) % n;
+				if ( used[s] < m.buffers ) {
+					reading		= static_cast<int>(s);
+					next		= s + 1;
+					step		= 0;
+					left		= seq[s][0].ticks;
+					stretched	= false;
+					started		= now;
+					++used[s];
+					break;
+				}
+			}
+		}
+
+		// --- bus: one tick
+		if ( reading >= 0 ) {
+			++r.busTicks;
+			if ( stretched ) {
+				if ( pending == 0 )	stretched = false;	// handler done, goes on next tick
+			} else if ( --left == 0 ) {
+				const std::vector<Step>&
+				s		= seq[reading];
+				if ( s[step].event ) {
+					pending		+= handler;
+					stretched	= true;
+				}
+				if ( ++step == s.size() ) {
+					queue.push_back({ static_cast<size_t>(reading), started });
+					reading		= -1;
+				} else {
+					left		= s[step].ticks;
+				}
+			}
+		}
+
+		// --- CPU: handlers first, then the samples in order
+		if ( pending ) {
+			--pending;
+			++r.handlerTicks;
+		} else if ( job ) {
+			++r.processTicks;
+			if ( --job == 0 ) {
+				--used[current.sensor];
+				++r.samples;
+				r.ageTicks	+= now + 1 - current.started;
+			}
+		}
+		if ( job == 0 && !queue.empty() && pending == 0 ) {
+			current	= queue.front();
+			queue.pop_front();
+			job		= process ? process : 1;
+		}
+	}
+	r.ticks	= end;
+	return r;
+}
+// ----------------------------------------------------------------------------
+
+static void
+usage(const char* name) {
+	fprintf(stderr, "usage: %s [-f bus_hz] [-i handler_us] [-p process_us] [-t s] [-s tcs,v6040,v6070]\n", name);
+	exit(1);
+}
+
+static bool
+selectSensors(const char* list, Parameters& p) {
+	std::string
+	names(list);
+	size_t
+	pos		= 0;
+	while ( pos <= names.size() ) {
+		size_t
+		comma	= names.find(',', pos);
+		if ( comma == std::string::npos )	comma = names.size();
+		const std::string
+		name	= names.substr(pos, comma - pos);
+		const SensorModel*
+		found	= nullptr;
+		for (const SensorModel& s : sensorModels)
+			if ( name == s.name )	found = &s;
+		if ( found == nullptr ) {
+			fprintf(stderr, "unknown sensor '%s'\n", name.c_str());
+			return false;
+		}
+		p.sensors.push_back(found);
+		pos		= comma + 1;
+	}
+	return true;
+}
+
+int
+main(int argc, char** argv) {
+	Parameters
+	p;
+	int
+	opt;
+	while ( (opt = getopt(argc, argv, "f:i:p:t:s:")) != -1 ) {
+		switch (opt) {
+		case 'f':	p.busHz		= strtoul(optarg, nullptr, 0);	break;
+		case 'i':	p.handlerUs	= strtod(optarg, nullptr);		break;
+		case 'p':	p.processUs	= strtod(optarg, nullptr);		break;
+		case 't':	p.seconds	= strtod(optarg, nullptr);		break;
+		case 's':	if ( !selectSensors(optarg, p) )	usage(argv[0]);	break;
+		default:	usage(argv[0]);
+		}
+	}
+	if ( optind != argc || p.busHz == 0 || p.busHz > 1000000 || p.seconds <= 0 )	usage(argv[0]);
+	if ( p.sensors.empty() )
+		for (const SensorModel& s : sensorModels)	p.sensors.push_back(&s);
+
+	printf("bus %u Hz, handler %.1f us, processing %.0f us per sample, %.1f s, sensors",
+		   p.busHz, p.handlerUs, p.processUs, p.seconds);
+	for (const SensorModel* s : p.sensors)	printf(" %s", s->name);
+	printf("\n\n%-8s %10s %6s %9s %6s %8s %8s %8s\n",
+		   "mode", "samples/s", "bus%", "handler%", "proc%", "age us", "/serial", "/irq/1");
+
+	const size_t
+	MODES	= sizeof(modes) / sizeof(modes[0]);
+	Result
+	r[MODES];
+	for (size_t i = 0; i < MODES; ++i)	r[i] = simulate(modes[i], p);
+
+	for (size_t i = 0; i < MODES; ++i) {
+		const double
+		total	= static_cast<double>(r[i].ticks);
+		printf("%-8s %10.1f %6.1f %9.1f %6.1f %8.0f %8.2f %8.2f\n", modes[i].name, r[i].samples / p.seconds,
+			   100.0 * r[i].busTicks / total, 100.0 * r[i].handlerTicks / total, 100.0 * r[i].processTicks / total,
+			   r[i].samples ? static_cast<double>(r[i].ageTicks) / r[i].samples / TICKS_PER_US : 0.0,
+			   r[0].samples ? static_cast<double>(r[i].samples) / r[0].samples : 0.0,
+			   r[1].samples ? static_cast<double>(r[i].samples) / r[1].samples : 0.0);
+	}
+	return 0;
+}
@@ -0,0 +1,103 @@
+// ----------------------------------------------------------------------------
+// Host decoder of the firmware 'dump' output (see codec.hpp)
+//
+// Usage: dumpdecode <capture> [<capture> ...]
+//
+// Scans a raw serial capture for "DUMP v1" blocks, decodes them and prints
+// CSV "sensor,ms,ch0,ch1,..." to stdout. Statistics (records, encoded vs raw
+// bytes, CRC result) go to stderr.
+// ----------------------------------------------------------------------------
+
+#include <codec.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+// ----------------------------------------------------------------------------
+
+static const char	header[]	= "DUMP v1 ";
+
+/// @return position after the decoded block, or `pos + 1` if it is not valid
+static size_t
+decodeBlock(const std::vector<uint8_t>& buf, size_t pos) {
+	const void*
+	nl		= memchr(buf.data() + pos, '\n', buf.size() - pos);
+	if ( nl == nullptr )	return pos + 1;
+	const size_t
+	eol		= static_cast<const uint8_t*>(nl) - (buf.data() + pos);
+
+	const std::string
+	line(buf.begin() + pos, buf.begin() + pos + eol);
+	char			sensor[16];
+	unsigned int	n, ch, dropped;
+	if ( sscanf(line.c_str(), "DUMP v1 %15s n=%u ch=%u dropped=%u", sensor, &n, &ch, &dropped) != 4 ||
+		 ch == 0 || ch > codec::MAX_CHANNELS ) {
+		fprintf(stderr, "skipping malformed header: %s\n", line.c_str());
+		return pos + 1;
+	}
+
+	codec::BlockDecoder
+	dec(ch, n);
+	uint16_t		crc		= 0xFFFF;
+	size_t			p		= pos + eol + 1;
+	const size_t	start	= p;
+
+	while ( !dec.done() && p < buf.size() ) {
+		crc		= codec::crc16(crc, buf[p]);
+		dec.put(buf[p++], [&]() {
+			printf("%s,%u", sensor, dec.ms);
+			for (unsigned int i = 0; i < ch; ++i)
+				printf(",%u", dec.ch[i]);
+			printf("\n");
+		});
+	}
+	const unsigned int
+	records	= dec.decoded();
+
+	const size_t
+	encoded	= p - start;
+	unsigned int	expected	= 0;
+	const bool
+	trailer	= ( sscanf(std::string(buf.begin() + p, buf.begin() + std::min(buf.size(), p + 16)).c_str(),
+					"\nEND %x", &expected) == 1 );
+	const size_t
+	raw		= static_cast<size_t>(records) * (4 + 2 * ch);
+
+	fprintf(stderr, "%s: %u/%u records, %zu bytes (raw %zu, %.2fx), dropped %u, crc %s\n",
+			sensor, records, n, encoded, raw, encoded ? double(raw) / encoded : 0.0, dropped,
+			!trailer ? "missing" : ( expected == crc ) ? "ok" : "MISMATCH");
+	return p;
+}
+
+int
+main(int argc, char** argv) {
+	if ( argc < 2 ) {
+		fprintf(stderr, "usage: %s <capture> [<capture> ...]\n", argv[0]);
+		return 2;
+	}
+
+	for (int f = 1; f < argc; ++f) {
+		std::ifstream
+		in(argv[f], std::ios::binary);
+		if ( !in ) {
+			fprintf(stderr, "%s: cannot open\n", argv[f]);
+			return 1;
+		}
+		const std::vector<uint8_t>
+		buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+		size_t
+		pos		= 0;
+		while ( pos + sizeof(header) - 1 <= buf.size() ) {
+			const void*
+			hit		= memmem(buf.data() + pos, buf.size() - pos, header, sizeof(header) - 1);
+			if ( hit == nullptr )	break;
+			pos		= decodeBlock(buf, static_cast<const uint8_t*>(hit) - buf.data());
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,560 @@
+// ----------------------------------------------------------------------------
+
+#ifndef FLEET_CLIENT_HPP
+#define FLEET_CLIENT_HPP
+
+#include <stdint.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+// ----------------------------------------------------------------------------
+
+/// @brief Asynchronous client of the device CLI (cli.hpp) on serial ports
+///
+/// The CLI queues up to Cli::QUEUE_LENGTH (4) lines, commands take up to 3
+/// of them (the last is kept for a Ctrl+C), and echoes a line when it reads
+/// it; a line that finds no room waits for it. The prompt "\n/>" comes when
+/// every queued line is done. So the client keeps `depth` (< 4) commands in
+/// flight per device and resolves a command with the first prompt after
+/// its echo.
+///
+/// A device that never prompts (wrong baud rate, wedged) gets no command,
+/// they time out waiting. A command whose echo does not come in time takes
+/// the commands sent after it along (their echoes cannot be told apart any
+/// more), and the client waits for a fresh prompt before it sends again.
+///
+/// The commands resolved by one prompt are a batch: the CLI prints nothing
+/// that tells which of them an output line is from (they are echoed as
+/// soon as they are queued, the sensor threads run them side by side), so
+/// they share the text and the status: the output since the first echo,
+/// an error if a line starts with "Invalid". Depth 1 gives every command
+/// a batch of its own. An unknown command is found by its echo ("Unknown
+/// command" follows it at once) and fails alone. Sample records
+/// ("TCS34725" + values), alarms and heartbeats are not part of a reply,
+/// they go to onOutput.
+///
+/// One thread (start()) runs all devices with epoll. send() may be called
+/// from any thread, it returns a future or calls back on the client
+/// thread.
+namespace fleet {
+
+struct Reply {
+	enum class Status : uint8_t {
+		Ok,
+		Error,									// "Invalid ...", "Unknown command"
+		Timeout,
+		Closed									// the port went away or could not be opened
+	};
+
+	Status			status;
+	std::string		command;
+	std::string		text;						// of the whole batch
+	uint32_t		ms;							// from sending to the prompt
+	uint8_t			batch;						// commands resolved by the same prompt
+};
+
+using Callback	= std::function<void(const Reply&)>;
+
+struct Options {
+	uint32_t		baud		= 115200;
+	uint8_t			depth		= 3;			// commands in flight per device
+	uint32_t		timeout		= 2000;			// ms per command, from sending it
+};
+
+inline uint64_t
+nowMs() {
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+inline bool
+setRaw(int fd, uint32_t baud) {
+	struct termios
+	tio;
+	if ( tcgetattr(fd, &tio) != 0 )	return false;
+	cfmakeraw(&tio);
+	tio.c_cflag	|= CLOCAL | CREAD;
+	const speed_t
+	speed	= ( baud == 9600 ) ? B9600 : ( baud == 19200 ) ? B19200 : ( baud == 38400 ) ? B38400 :
+			  ( baud == 57600 ) ? B57600 : ( baud == 230400 ) ? B230400 : ( baud == 460800 ) ? B460800 :
+			  ( baud == 921600 ) ? B921600 : B115200;
+	cfsetispeed(&tio, speed);
+	cfsetospeed(&tio, speed);
+	return tcsetattr(fd, TCSANOW, &tio) == 0;
+}
+// ----------------------------------------------------------------------------
+
+class Client;
+
+/// @brief one device, created by Client::open()
+class Device {
+public:
+	/// @brief queue a command line, done() is called on the client thread
+	void
+	send(const std::string& command, Callback done) {
+		{
+			std::lock_guard<std::mutex>
+			lock(_mutex);
+			Command
+			c;
+			c.line	= command;
+			c.done	= std::move(done);
+			_incoming.push_back(std::move(c));
+		}
+		++_unanswered;
+		wake();
+	}
+
+	std::future<Reply>
+	send(const std::string& command) {
+		auto
+		promise	= std::make_shared<std::promise<Reply>>();
+		send(command, [promise](const Reply& r) { promise->set_value(r); });
+		return promise->get_future();
+	}
+
+	/// @brief a control character (Ctrl+C = 0x03) as a queue entry of its own
+	std::future<Reply>
+	control(char c)				{ return send(std::string(1, c)); }
+
+	const std::string&
+	path() const				{ return _path; }
+
+	/// unsolicited lines (samples, alarms, heartbeats), on the client thread;
+	/// set before start()
+	std::function<void(const std::string&)>	onOutput;
+
+private:
+	friend class Client;
+
+	struct Command {
+		std::string		line;					// as typed, without the newline
+		Callback		done;
+		uint64_t		queuedAt	= 0;
+		uint64_t		sentAt		= 0;
+
+		bool
+		isControl() const		{ return line.size() == 1 && line[0] > 0 && line[0] < ' '; }
+	};
+
+	Device(Client& client, const std::string& path, const Options& options) :
+		_client(client), _path(path), _options(options)	{}
+
+	void
+	wake();
+
+	// --- client thread
+	bool
+	open(int epoll) {
+		_fd		= ::open(_path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+		if ( _fd < 0 )	return false;
+		if ( isatty(_fd) )	setRaw(_fd, _options.baud);
+		epoll_event
+		ev{};
+		ev.events	= EPOLLIN | EPOLLOUT | EPOLLET;
+		ev.data.ptr	= this;
+		if ( epoll_ctl(epoll, EPOLL_CTL_ADD, _fd, &ev) != 0 ) {
+			::close(_fd);
+			_fd		= -1;
+			return false;
+		}
+		// an empty line: the prompt tells that the CLI is idle
+		_out		= "\n";
+		_syncAt		= nowMs();
+		_unsyncedAt	= _syncAt;
+		return true;
+	}
+
+	void
+	close() {
+		if ( _fd >= 0 )	::close(_fd);
+		_fd		= -1;
+		for (auto& c : _sent)		finish(*c, Reply::Status::Closed);
+		for (auto& c : _echoed)		finish(*c, Reply::Status::Closed);
+		for (auto& c : _queued)		finish(*c, Reply::Status::Closed);
+		_sent.clear();
+		_echoed.clear();
+		_queued.clear();
+	}
+
+	/// take the commands of send(), write what the window allows
+	void
+	pump() {
+		{
+			std::lock_guard<std::mutex>
+			lock(_mutex);
+			const uint64_t
+			now		= nowMs();
+			for (Command& c : _incoming) {
+				c.queuedAt	= now;
+				_queued.emplace_back(new Command(std::move(c)));
+			}
+			_incoming.clear();
+		}
+		if ( _fd < 0 ) {
+			close();
+			return;
+		}
+		while ( _ready && !_queued.empty() && _sent.size() + _echoed.size() < _options.depth ) {
+			std::unique_ptr<Command>
+			c		= std::move(_queued.front());
+			_queued.pop_front();
+			c->sentAt	= nowMs();
+			_out		+= c->line;
+			if ( !c->isControl() )	_out += '\n';
+			_sent.push_back(std::move(c));
+		}
+		flush();
+	}
+
+	void
+	flush() {
+		while ( !_out.empty() && _fd >= 0 ) {
+			const ssize_t
+			n		= ::write(_fd, _out.data(), _out.size());
+			if ( n > 0 ) {
+				_out.erase(0, n);
+				continue;
+			}
+			if ( n < 0 && ( errno == EAGAIN || errno == EINTR ) )	return;
+			close();
+		}
+	}
+
+	void
+	readable() {
+		char
+		buf[1024];
+		while ( _fd >= 0 ) {
+			const ssize_t
+			n		= ::read(_fd, buf, sizeof(buf));
+			if ( n > 0 ) {
+				for (ssize_t i = 0; i < n; ++i)	receive(buf[i]);
+				continue;
+			}
+			if ( n < 0 && ( errno == EAGAIN || errno == EINTR ) )	return;
+			close();
+		}
+	}
+
+	void
+	receive(char c) {
+		// "/>" at the start of a line is the prompt
+		if ( _line.empty() && _slash ) {
+			_slash	= false;
+			if ( c == '>' ) {
+				prompt();
+				return;
+			}
+			_line	+= '/';
+		}
+		if ( _line.empty() && c == '/' ) {
+			_slash	= true;
+			return;
+		}
+		// control characters are echoed without a newline
+		if ( c > 0 && c < ' ' && c != '\n' && c != '\r' ) {
+			if ( !_sent.empty() && _sent.front()->isControl() && _sent.front()->line[0] == c ) {
+				echoed();
+			}
+			return;
+		}
+		if ( c == '\r' )	return;
+		if ( c != '\n' ) {
+			_line	+= c;
+			return;
+		}
+		line(_line);
+		_line.clear();
+	}
+
+	/// a complete line
+	void
+	line(const std::string& l) {
+		if ( !_sent.empty() && !_sent.front()->isControl() ) {
+			const std::string&
+			expected	= _sent.front()->line;
+			// a prompt may cut an echo in two ("tcs --at", "/>", "ime 24")
+			const std::string
+			candidate	= _partial + l;
+			if ( candidate == expected ) {
+				_partial.clear();
+				echoed();
+				return;
+			}
+			if ( !candidate.empty() && candidate.size() < expected.size() &&
+				 expected.compare(0, candidate.size(), candidate) == 0 ) {
+				_partial	= candidate;
+				return;
+			}
+			if ( !_partial.empty() ) {
+				const std::string
+				p		= _partial;
+				_partial.clear();
+				output(p);
+			}
+		}
+		output(l);
+	}
+
+	void
+	output(const std::string& l) {
+		if ( l.empty() )	return;
+		const bool
+		header	= l.size() >= 8 && ( l.compare(l.size() - 8, 8, "TCS34725") == 0 ||
+									 l.compare(l.size() - 8, 8, "VEML6040") == 0 ||
+									 l.compare(l.size() - 8, 8, "VEML6070") == 0 );
+		const bool
+		record	= _sample || header || l.compare(0, 6, "Alarm:") == 0 || l.compare(0, 10, "Heartbeat:") == 0;
+		_sample	= header;
+		if ( record || _echoed.empty() ) {
+			if ( onOutput )	onOutput(l);
+			return;
+		}
+		if ( l.compare(0, 7, "Invalid") == 0 )			_error = true;
+		if ( l.compare(0, 15, "Unknown command") == 0 )	_unknown = true;
+		_text	+= l;
+		_text	+= '\n';
+	}
+
+	void
+	echoed() {
+		_echoed.push_back(std::move(_sent.front()));
+		_sent.pop_front();
+		_echoAt	= _text.size();
+	}
+
+	void
+	prompt() {
+		_ready	= true;							// synchronised
+		if ( _echoed.empty() )	return;
+		// usage() after an unknown command prompts whether or not the
+		// commands before it are done
+		if ( _unknown ) {
+			_unknown	= false;
+			finish(*_echoed.back(), Reply::Status::Error, 1, _text.substr(_echoAt));
+			_echoed.pop_back();
+			_text.erase(_echoAt);
+			return;
+		}
+		const uint8_t
+		batch	= static_cast<uint8_t>(_echoed.size());
+		for (auto& c : _echoed)
+			finish(*c, _error ? Reply::Status::Error : Reply::Status::Ok, batch, _text);
+		_echoed.clear();
+		_text.clear();
+		_error	= false;
+	}
+
+	void
+	expire(uint64_t now) {
+		if ( !_ready && _fd >= 0 ) {
+			// no prompt (yet): what waits for one times out
+			for (auto it = _queued.begin(); it != _queued.end(); ) {
+				if ( now - std::max((*it)->queuedAt, _unsyncedAt) >= _options.timeout ) {
+					finish(**it, Reply::Status::Timeout);
+					it	= _queued.erase(it);
+				} else {
+					++it;
+				}
+			}
+			if ( now - _syncAt >= _options.timeout )
+				sync(now);						// the last one got lost in a partial line
+		}
+
+		// an echo that did not come: the ones behind it cannot be matched
+		bool
+		lost	= false;
+		for (const auto& c : _sent)
+			if ( now - c->sentAt >= _options.timeout )	lost = true;
+		if ( lost ) {
+			for (auto& c : _sent)	finish(*c, Reply::Status::Timeout);
+			_sent.clear();
+			_partial.clear();
+			sync(now);
+		}
+
+		for (auto it = _echoed.begin(); it != _echoed.end(); ) {
+			if ( now - (*it)->sentAt >= _options.timeout ) {
+				finish(**it, Reply::Status::Timeout);
+				it	= _echoed.erase(it);
+			} else {
+				++it;
+			}
+		}
+	}
+
+	/// @brief an empty line, nothing is sent until its prompt
+	void
+	sync(uint64_t now) {
+		if ( _ready )	_unsyncedAt = now;
+		_ready	= false;
+		_out	+= "\n";
+		_syncAt	= now;
+		flush();
+	}
+
+	void
+	finish(Command& c, Reply::Status status, uint8_t batch = 1, const std::string& text = std::string()) {
+		if ( !c.done )	return;
+		Reply
+		r{ status, c.line, text, c.sentAt ? static_cast<uint32_t>(nowMs() - c.sentAt) : 0, batch };
+		Callback
+		done	= std::move(c.done);
+		c.done	= nullptr;
+		done(r);
+		--_unanswered;
+	}
+
+	Client&			_client;
+	std::string		_path;
+	Options			_options;
+	int				_fd			= -1;
+
+	std::mutex				_mutex;
+	std::vector<Command>	_incoming;	// from send(), any thread
+	std::atomic<uint32_t>	_unanswered{0};
+
+	std::deque<std::unique_ptr<Command>>	_queued;	// not sent yet
+	std::deque<std::unique_ptr<Command>>	_sent;		// waiting for the echo
+	std::deque<std::unique_ptr<Command>>	_echoed;	// taken by the CLI, waiting for a prompt
+	std::string		_out;				// not written yet
+	std::string		_line;				// received, incomplete
+	std::string		_partial;			// start of an echo cut by a prompt
+	bool			_slash		= false;
+	bool			_sample		= false;	// the next line belongs to a sample record
+	std::string		_text;				// output of the batch so far
+	bool			_error		= false;	// "Invalid ..." in it
+	bool			_unknown	= false;	// "Unknown command" after the last echo
+	size_t			_echoAt		= 0;		// _text at the last echo
+	bool			_ready		= false;	// first prompt seen
+	uint64_t		_syncAt		= 0;		// last empty line sent
+	uint64_t		_unsyncedAt	= 0;		// no prompt since
+};
+// ----------------------------------------------------------------------------
+
+/// @brief the devices and the thread that runs them
+class Client {
+public:
+	explicit Client(const Options& options = Options()) : _options(options) {
+		_epoll	= epoll_create1(EPOLL_CLOEXEC);
+		_event	= eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		epoll_event
+		ev{};
+		ev.events	= EPOLLIN;
+		ev.data.ptr	= nullptr;
+		epoll_ctl(_epoll, EPOLL_CTL_ADD, _event, &ev);
+	}
+
+	~Client() {
+		stop();
+		for (auto& d : _devices)	d->close();
+		::close(_event);
+		::close(_epoll);
+	}
+
+	Client(const Client&)				= delete;
+	Client& operator=(const Client&)	= delete;
+
+	/// @brief add a device before start(); if the port does not open, its
+	/// commands come back Closed
+	Device&
+	open(const std::string& path) {
+		_devices.emplace_back(new Device(*this, path, _options));
+		Device&
+		d		= *_devices.back();
+		d.open(_epoll);
+		return d;
+	}
+
+	void
+	start() {
+		_running	= true;
+		_thread		= std::thread([this]() { run(); });
+	}
+
+	void
+	stop() {
+		if ( !_running )	return;
+		_running	= false;
+		wake();
+		_thread.join();
+	}
+
+	/// @brief block until every command sent so far has its reply
+	void
+	drain() {
+		for (auto& d : _devices)
+			while ( d->_unanswered )	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+private:
+	friend class Device;
+
+	void
+	wake() {
+		const uint64_t
+		one		= 1;
+		if ( ::write(_event, &one, sizeof(one)) < 0 ) {}
+	}
+
+	void
+	run() {
+		epoll_event
+		events[64];
+		while ( _running ) {
+			const int
+			n		= epoll_wait(_epoll, events, 64, 50);
+			for (int i = 0; i < n; ++i) {
+				Device*
+				d		= static_cast<Device*>(events[i].data.ptr);
+				if ( d == nullptr ) {
+					uint64_t
+					count;
+					if ( ::read(_event, &count, sizeof(count)) < 0 ) {}
+					continue;
+				}
+				if ( events[i].events & EPOLLIN )	d->readable();
+				if ( events[i].events & EPOLLOUT )	d->flush();
+				if ( events[i].events & ( EPOLLHUP | EPOLLERR ) )	d->close();
+			}
+			const uint64_t
+			now		= nowMs();
+			for (auto& d : _devices) {
+				d->expire(now);
+				d->pump();
+			}
+		}
+	}
+
+	Options			_options;
+	int				_epoll;
+	int				_event;
+	std::atomic<bool>	_running{false};
+	std::thread		_thread;
+	std::vector<std::unique_ptr<Device>>	_devices;
+};
+
+inline void
+Device::wake()					{ _client.wake(); }
+
+}	// namespace fleet
+// ----------------------------------------------------------------------------
+
+#endif	// FLEET_CLIENT_HPP
@@ -0,0 +1,156 @@
+// ----------------------------------------------------------------------------
+// Push a configuration to many devices at once
+//
+// Usage: fleet [-d depth] [-t timeout_ms] [-b baud] [-v] (-c config | -e command)... <tty>...
+//
+// Sends the command lines (a config file: one per line, '#' comments, "^C"
+// for Ctrl+C; or -e) to every device through the asynchronous CLI client
+// (client.hpp), all devices in parallel and `depth` commands pipelined per
+// device. Prints one line per device: replies ok / failed and the time it
+// took, the replies of failed commands (and with -v all replies). The
+// commands pipelined between two prompts share a reply (see client.hpp),
+// -d 1 sends one at a time. Exit status 1 if a command failed on any
+// device.
+// ----------------------------------------------------------------------------
+
+#include "client.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+// ----------------------------------------------------------------------------
+
+namespace {
+
+const char* const	statusNames[]	= {"ok", "error", "timeout", "closed"};
+
+struct Result {
+	std::vector<fleet::Reply>	replies;
+	uint64_t					started	= 0;
+	uint64_t					ended	= 0;
+};
+
+bool
+readConfig(const char* path, std::vector<std::string>& commands) {
+	std::ifstream
+	in(path);
+	if ( !in ) {
+		perror(path);
+		return false;
+	}
+	std::string
+	line;
+	while ( std::getline(in, line) ) {
+		while ( !line.empty() && ( line.back() == '\r' || line.back() == ' ' || line.back() == '\t' ) )
+			line.pop_back();
+		const size_t
+		start	= line.find_first_not_of(" \t");
+		if ( start == std::string::npos || line[start] == '#' )	continue;
+		line	= line.substr(start);
+		commands.push_back(( line == "^C" ) ? std::string(1, '\x03') : line);
+	}
+	return true;
+}
+
+void
+usage(const char* name) {
+	fprintf(stderr, "usage: %s [-d depth] [-t timeout_ms] [-b baud] [-v] (-c config | -e command)... <tty>...\n", name);
+	exit(2);
+}
+
+}	// namespace
+// ----------------------------------------------------------------------------
+
+int
+main(int argc, char** argv) {
+	fleet::Options
+	options;
+	std::vector<std::string>
+	commands;
+	bool
+	verbose	= false;
+	int	opt;
+	while ( (opt = getopt(argc, argv, "d:t:b:vc:e:")) != -1 ) {
+		switch ( opt ) {
+		case 'd':	options.depth	= static_cast<uint8_t>(std::min(3, std::max(1, atoi(optarg))));	break;
+		case 't':	options.timeout	= strtoul(optarg, nullptr, 10);	break;
+		case 'b':	options.baud	= strtoul(optarg, nullptr, 10);	break;
+		case 'v':	verbose			= true;							break;
+		case 'c':	if ( !readConfig(optarg, commands) )	return 1;	break;
+		case 'e':	commands.push_back(optarg);						break;
+		default:	usage(argv[0]);
+		}
+	}
+	if ( optind >= argc || commands.empty() )	usage(argv[0]);
+
+	fleet::Client
+	client(options);
+	std::vector<fleet::Device*>
+	devices;
+	for (int i = optind; i < argc; ++i)	devices.push_back(&client.open(argv[i]));
+	std::vector<Result>
+	results(devices.size());
+	client.start();
+
+	// replies are collected on the client thread, nothing else touches them until drain()
+	const uint64_t
+	start	= fleet::nowMs();
+	for (size_t d = 0; d < devices.size(); ++d) {
+		results[d].started	= start;
+		for (const std::string& c : commands) {
+			devices[d]->send(c, [&results, d](const fleet::Reply& r) {
+				results[d].replies.push_back(r);
+				results[d].ended	= fleet::nowMs();
+			});
+		}
+	}
+	client.drain();
+	client.stop();
+
+	bool
+	failed	= false,
+	shared	= false;							// a batch of several failed
+	size_t
+	ok		= 0;
+	for (size_t d = 0; d < devices.size(); ++d) {
+		const Result&
+		r		= results[d];
+		size_t
+		good	= 0;
+		for (const fleet::Reply& reply : r.replies)
+			if ( reply.status == fleet::Reply::Status::Ok )	++good;
+		printf("%-20s %zu/%zu ok  %6llu ms\n", devices[d]->path().c_str(), good, r.replies.size(),
+			   static_cast<unsigned long long>(r.ended - r.started));
+		const std::string*
+		shown	= nullptr;						// a batch shares the text, print it once
+		for (const fleet::Reply& reply : r.replies) {
+			if ( !verbose && reply.status == fleet::Reply::Status::Ok )	continue;
+			printf("  [%s %u ms] %s", statusNames[static_cast<uint8_t>(reply.status)], reply.ms,
+				   reply.command[0] == '\x03' ? "^C" : reply.command.c_str());
+			if ( reply.batch > 1 ) {
+				printf("  (batch of %u)", reply.batch);
+				shared	= true;
+			}
+			printf("\n");
+			if ( shown && *shown == reply.text )	continue;
+			shown	= &reply.text;
+			size_t
+			pos		= 0;
+			while ( pos < reply.text.size() ) {
+				const size_t
+				nl		= reply.text.find('\n', pos);
+				printf("    %s\n", reply.text.substr(pos, nl - pos).c_str());
+				pos		= ( nl == std::string::npos ) ? reply.text.size() : nl + 1;
+			}
+		}
+		if ( good == r.replies.size() )	++ok;
+		else							failed = true;
+	}
+	printf("%zu/%zu devices configured in %llu ms\n", ok, devices.size(),
+		   static_cast<unsigned long long>(fleet::nowMs() - start));
+	if ( shared && !verbose )
+		printf("commands of a failed batch share its status, -d 1 tells which one failed\n");
+	return failed ? 1 : 0;
+}
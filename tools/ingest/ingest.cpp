@@ -0,0 +1,647 @@
+// ----------------------------------------------------------------------------
+// Fast ingestion of recorded serial captures into columnar files
+//
+// Usage: ingest [-j threads] [-p period_ms] [-i index_every] -o <dir> <capture>...
+//
+// Parses the text sample format of the firmware
+//		"TCS34725\nRGBW Hue: r g b w  hue\n"
+//		"VEML6040\nRGBW Hue: r g b w  hue\n"
+//		(any 'report --fields' with counts: "RGBW[ Hue][ Sat][ Val]: r g b w[ h][ s][ v]")
+//		"VEML6070\nUv: uv[ A: a C: c]\n"
+// and the binary 'dump' blocks (codec.hpp) in a single pass over a
+// memory-mapped file: lines are found with memchr() (vectorised in libc),
+// numbers are parsed in place and nothing is copied. Large files are split
+// into chunks at sensor header lines and parsed by several threads, each
+// writing its own part files, which are then concatenated in order
+// (copy_file_range, no user space copy).
+//
+// Output in <dir>, raw little-endian arrays, one per column:
+//		<stream>.ts.u64				timestamp in ms
+//		<stream>.<channel>.u32		counts of the text records, raw or normalised
+//									('report --units norm', up to ~1e9)
+//		dump.<sensor>.<channel>.u16	counts of the dump records (always raw)
+//		<stream>.hue/sat/val.u16	(tcs, v6040; 0xFFFF if not in the output)
+//		<stream>.A.f32 / .C.f32		absorbance / concentration (v6070, NaN if absent)
+//		<stream>.idx				seek index {ts, row, file, offset} as 4 x u64, one
+//									entry every index_every rows of each chunk
+//		manifest.txt				rows per stream and the column list
+// <stream> is tcs, v6040, v6070 for text records and dump.<sensor> for dumps.
+// Text lines carry no time, their timestamp is row * period_ms; dump
+// records have the device clock.
+// ----------------------------------------------------------------------------
+
+#include <codec.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+// ----------------------------------------------------------------------------
+
+namespace {
+
+enum Stream : uint8_t {
+	TCS, V6040, V6070,
+	DUMP_TCS, DUMP_V6040, DUMP_V6070,
+	STREAMS
+};
+
+struct Layout {
+	const char*		name;
+	uint8_t			channels;
+	const char*		channel[4];
+	bool			hsv;
+	bool			conc;
+	bool			wide;						// u32 counts (text may be normalised)
+};
+
+const Layout
+layouts[STREAMS] = {
+	{"tcs",			4, {"R", "G", "B", "C"},	true,	false,	true},
+	{"v6040",		4, {"R", "G", "B", "W"},	true,	false,	true},
+	{"v6070",		1, {"UV"},					false,	true,	true},
+	{"dump.tcs",	4, {"R", "G", "B", "C"},	false,	false,	false},
+	{"dump.v6040",	4, {"R", "G", "B", "W"},	false,	false,	false},
+	{"dump.v6070",	1, {"UV"},					false,	false,	false},
+};
+
+struct Options {
+	unsigned int	threads		= std::max(1u, std::thread::hardware_concurrency());
+	uint64_t		period		= 500;			// ms between text samples
+	uint64_t		indexEvery	= 1024;			// rows per index entry
+	std::string		out;
+};
+
+Options				options;
+// ----------------------------------------------------------------------------
+
+/// @brief append-only binary file with a write buffer
+class Column {
+public:
+	~Column()					{ close(); }
+
+	bool
+	open(const std::string& path, bool append) {
+		_fd		= ::open(path.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644);
+		_path	= path;
+		_buf.reserve(BUFFER);
+		return _fd >= 0;
+	}
+
+	template < typename T >
+	void
+	put(T v) {
+		const size_t
+		n		= _buf.size();
+		_buf.resize(n + sizeof(T));
+		memcpy(_buf.data() + n, &v, sizeof(T));
+		if ( _buf.size() >= BUFFER )	flush();
+	}
+
+	void
+	flush() {
+		size_t
+		done	= 0;
+		while ( done < _buf.size() ) {
+			const ssize_t
+			w		= ::write(_fd, _buf.data() + done, _buf.size() - done);
+			if ( w <= 0 ) {
+				perror(_path.c_str());
+				exit(1);
+			}
+			done	+= w;
+		}
+		_buf.clear();
+	}
+
+	void
+	close() {
+		if ( _fd < 0 )	return;
+		flush();
+		::close(_fd);
+		_fd		= -1;
+	}
+
+	const std::string&
+	path() const				{ return _path; }
+
+private:
+	enum { BUFFER = 1 << 20 };
+
+	int						_fd	= -1;
+	std::string				_path;
+	std::vector<uint8_t>	_buf;
+};
+// ----------------------------------------------------------------------------
+
+/// @brief columns of one stream written by one thread
+struct Part {
+	Column			ts;
+	Column			ch[4];
+	Column			hsv[3];						// hue, sat, val
+	Column			a;
+	Column			c;
+	Column			idx;
+	uint64_t		rows	= 0;
+
+	template < typename Fn >
+	void
+	forEach(const Layout& l, Fn&& fn) {
+		fn(ts, "ts.u64");
+		for (uint8_t i = 0; i < l.channels; ++i)
+			fn(ch[i], std::string(l.channel[i]) + ( l.wide ? ".u32" : ".u16" ));
+		if ( l.hsv ) {
+			fn(hsv[0], "hue.u16");
+			fn(hsv[1], "sat.u16");
+			fn(hsv[2], "val.u16");
+		}
+		if ( l.conc ) {
+			fn(a, "A.f32");
+			fn(c, "C.f32");
+		}
+		fn(idx, "idx");
+	}
+};
+
+/// @brief parse state of one chunk of a capture
+class Parser {
+public:
+	/// @param base, size	the whole mapped file (dump blocks may cross the chunk end)
+	Parser(const uint8_t* begin, const uint8_t* end, const uint8_t* base, size_t size, uint32_t file,
+			const std::string& prefix):
+		_p(begin), _end(end), _base(base), _size(size), _file(file) {
+		for (uint8_t s = 0; s < STREAMS; ++s) {
+			_parts[s].forEach(layouts[s], [&](Column& col, const std::string& suffix) {
+				if ( !col.open(prefix + layouts[s].name + "." + suffix, false) ) {
+					perror(col.path().c_str());
+					exit(1);
+				}
+			});
+		}
+	}
+
+	/// @brief text timestamps are local row numbers here, fixed up on merge
+	void
+	run() {
+		Stream
+		sensor	= STREAMS;								// last sensor header seen
+		while ( _p < _end ) {
+			const uint8_t*
+			line	= _p;
+			const uint8_t*
+			eol		= static_cast<const uint8_t*>(memchr(_p, '\n', _end - _p));
+			if ( eol == nullptr )	eol = _end;
+			_p		= eol + 1;
+
+			const size_t
+			len		= eol - line - ( eol > line && eol[-1] == '\r' );
+			if ( len < 3 )	continue;
+
+			// a header may follow an unterminated prompt ("/>VEML6070")
+			const uint8_t*
+			tail	= ( len >= 8 ) ? line + len - 8 : line;
+			if ( len >= 8 && ( tail[0] == 'T' || tail[0] == 'V' ) ) {
+				if ( memcmp(tail, "TCS34725", 8) == 0 ) {
+					sensor	= TCS;
+					continue;
+				}
+				if ( memcmp(tail, "VEML6040", 8) == 0 ) {
+					sensor	= V6040;
+					continue;
+				}
+				if ( memcmp(tail, "VEML6070", 8) == 0 ) {
+					sensor	= V6070;
+					continue;
+				}
+			}
+
+			switch ( line[0] ) {
+			case 'R':
+				if ( (sensor == TCS || sensor == V6040) && starts(line, len, "RGBW") )
+					rgbw(sensor, line + 4, line + len, line);
+				sensor	= STREAMS;
+				break;
+			case 'U':
+			case ' ':
+				if ( sensor == V6070 )
+					uv(line, line + len);
+				sensor	= STREAMS;
+				break;
+			case 'D':
+				if ( starts(line, len, "DUMP v1 ") )
+					dump(line, len);
+				sensor	= STREAMS;
+				break;
+			default:
+				sensor	= STREAMS;
+				break;
+			}
+		}
+		for (uint8_t s = 0; s < STREAMS; ++s)
+			_parts[s].forEach(layouts[s], [](Column& col, const std::string&) { col.close(); });
+	}
+
+	uint64_t
+	rows(uint8_t s) const		{ return _parts[s].rows; }
+
+private:
+	static bool
+	starts(const uint8_t* line, size_t len, const char* s) {
+		const size_t	n	= strlen(s);
+		return len >= n && memcmp(line, s, n) == 0;
+	}
+
+	static bool
+	number(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+		while ( p < end && *p == ' ' )	++p;
+		if ( p == end || *p < '0' || *p > '9' )	return false;
+		v	= 0;
+		while ( p < end && *p >= '0' && *p <= '9' )
+			v	= v * 10 + (*p++ - '0');
+		return true;
+	}
+
+	/// "[-]int.frac" as printed by printFixed()
+	static bool
+	decimal(const uint8_t*& p, const uint8_t* end, float& v) {
+		while ( p < end && *p == ' ' )	++p;
+		const bool
+		neg		= ( p < end && *p == '-' );
+		if ( neg )	++p;
+		uint32_t
+		whole	= 0;
+		if ( !number(p, end, whole) )	return false;
+		float
+		frac	= 0, scale = 1;
+		if ( p < end && *p == '.' ) {
+			++p;
+			while ( p < end && *p >= '0' && *p <= '9' ) {
+				frac	= frac * 10 + (*p++ - '0');
+				scale	*= 10;
+			}
+		}
+		v	= (whole + frac / scale) * ( neg ? -1 : 1 );
+		return true;
+	}
+
+	void
+	row(uint8_t s, uint64_t ts, const uint8_t* line) {
+		Part&
+		part	= _parts[s];
+		if ( part.rows % options.indexEvery == 0 ) {
+			part.idx.put<uint64_t>(ts);
+			part.idx.put<uint64_t>(part.rows);
+			part.idx.put<uint64_t>(_file);
+			part.idx.put<uint64_t>(line - _base);
+		}
+		part.ts.put<uint64_t>(ts);
+		++part.rows;
+	}
+
+	/// @brief the labels after "RGBW" up to ':', the fields of the line
+	/// @return bits of hue, sat, val, -1 if it is no sample line
+	static int
+	fields(const uint8_t*& p, const uint8_t* end) {
+		static const char* const
+		labels[3]	= { "Hue", "Sat", "Val" };
+		int
+		mask	= 0;
+		while ( p < end && *p == ' ' ) {
+			++p;
+			uint8_t
+			i		= 0;
+			while ( i < 3 && ( end - p < 3 || memcmp(p, labels[i], 3) != 0 ) )	++i;
+			if ( i == 3 )	return -1;
+			mask	|= ( 1 << i );
+			p		+= 3;
+		}
+		if ( p == end || *p != ':' )	return -1;
+		++p;
+		return mask;
+	}
+
+	void
+	rgbw(Stream s, const uint8_t* p, const uint8_t* end, const uint8_t* line) {
+		const int
+		mask	= fields(p, end);
+		uint32_t	v[4];
+		uint32_t	hsv[3]	= { UINT16_MAX, UINT16_MAX, UINT16_MAX };
+		if ( mask < 0 )	return;
+		for (uint8_t i = 0; i < 4; ++i)
+			if ( !number(p, end, v[i]) )	return;
+		for (uint8_t i = 0; i < 3; ++i)
+			if ( ( mask & ( 1 << i ) ) && !number(p, end, hsv[i]) )	return;
+		Part&
+		part	= _parts[s];
+		row(s, part.rows, line);
+		for (uint8_t i = 0; i < 4; ++i)
+			part.ch[i].put<uint32_t>(v[i]);
+		for (uint8_t i = 0; i < 3; ++i)
+			part.hsv[i].put<uint16_t>(hsv[i]);
+	}
+
+	void
+	uv(const uint8_t* line, const uint8_t* end) {
+		const uint8_t*
+		p		= line;
+		uint32_t
+		counts	= 0;
+		float
+		a		= NAN,
+		c		= NAN;
+
+		if ( starts(line, end - line, "Uv:") ) {
+			p	+= 3;
+			if ( !number(p, end, counts) )	return;
+		}
+		while ( p < end && *p == ' ' )	++p;
+		if ( end - p > 3 && memcmp(p, "A:", 2) == 0 ) {
+			p	+= 2;
+			decimal(p, end, a);
+			while ( p < end && *p == ' ' )	++p;
+			if ( end - p > 2 && memcmp(p, "C:", 2) == 0 ) {
+				p	+= 2;
+				decimal(p, end, c);
+			}
+		} else if ( p == line ) {
+			return;											// neither "Uv:" nor " A:"
+		}
+
+		Part&
+		part	= _parts[V6070];
+		row(V6070, part.rows, line);
+		part.ch[0].put<uint32_t>(counts);
+		part.a.put<float>(a);
+		part.c.put<float>(c);
+	}
+
+	/// decodes the whole block, even past the chunk end; its rows are only
+	/// kept if the CRC of the trailer matches, a corrupted block is reported
+	void
+	dump(const uint8_t* line, size_t len) {
+		char			sensor[16];
+		unsigned int	n, ch, dropped;
+		const std::string
+		header(reinterpret_cast<const char*>(line), len);
+		if ( sscanf(header.c_str(), "DUMP v1 %15s n=%u ch=%u dropped=%u", sensor, &n, &ch, &dropped) != 4 )
+			return;
+
+		uint8_t
+		s		= STREAMS;
+		for (uint8_t i = DUMP_TCS; i < STREAMS; ++i)
+			if ( strcmp(layouts[i].name + 5, sensor) == 0 )	s = i;
+		if ( s == STREAMS || ch != layouts[s].channels )	return;
+
+		codec::BlockDecoder
+		dec(ch, n);
+		const uint8_t*
+		end		= _base + _size;
+		uint16_t
+		crc		= 0xFFFF;
+		std::vector<uint32_t>
+		records;											// ms, ch[0..ch-1] per record
+		records.reserve(static_cast<size_t>(n) * (ch + 1));
+		while ( !dec.done() && _p < end ) {
+			crc	= codec::crc16(crc, *_p);
+			dec.put(*_p++, [&]() {
+				records.push_back(dec.ms);
+				for (uint8_t i = 0; i < ch; ++i)
+					records.push_back(dec.ch[i]);
+			});
+		}
+
+		unsigned int
+		expected	= 0;
+		const std::string
+		trailer(reinterpret_cast<const char*>(_p), std::min<size_t>(end - _p, 16));
+		const bool
+		ok		= dec.done() && sscanf(trailer.c_str(), "\nEND %x", &expected) == 1 && expected == crc;
+		if ( !ok ) {
+			fprintf(stderr, "dump %s at offset %zu: %s, %u records skipped\n", sensor, static_cast<size_t>(line - _base),
+					dec.done() ? "crc mismatch" : "truncated", static_cast<unsigned int>(dec.decoded()));
+			return;
+		}
+
+		Part&
+		part	= _parts[s];
+		for (size_t r = 0; r < records.size(); r += ch + 1) {
+			row(s, records[r], line);
+			for (uint8_t i = 0; i < ch; ++i)
+				part.ch[i].put<uint16_t>(records[r + 1 + i]);
+		}
+	}
+
+	const uint8_t*	_p;
+	const uint8_t*	_end;
+	const uint8_t*	_base;
+	size_t			_size;
+	uint32_t		_file;
+	Part			_parts[STREAMS];
+};
+// ----------------------------------------------------------------------------
+
+bool
+isHeader(const uint8_t* line, const uint8_t* end) {
+	static const char* const
+	headers[]	= {"TCS34725\n", "VEML6040\n", "VEML6070\n", "TCS34725\r", "VEML6040\r", "VEML6070\r"};
+	for (const char* h : headers)
+		if ( end - line >= 9 && memcmp(line, h, 9) == 0 )	return true;
+	return false;
+}
+
+/// next sensor header line at or after p (or end)
+const uint8_t*
+nextRecord(const uint8_t* p, const uint8_t* begin, const uint8_t* end) {
+	if ( p > begin ) {
+		p	= static_cast<const uint8_t*>(memchr(p - 1, '\n', end - p + 1));
+		if ( p == nullptr )	return end;
+		++p;
+	}
+	while ( p < end && !isHeader(p, end) ) {
+		p	= static_cast<const uint8_t*>(memchr(p, '\n', end - p));
+		if ( p == nullptr )	return end;
+		++p;
+	}
+	return p;
+}
+
+/// append src to dst, adding `rowBase` and scaling text timestamps
+void
+appendColumn(const std::string& src, const std::string& dst, bool textTs, bool isIndex, uint64_t rowBase) {
+	const int
+	in		= ::open(src.c_str(), O_RDONLY),
+	out		= ::open(dst.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if ( in < 0 || out < 0 ) {
+		perror(dst.c_str());
+		exit(1);
+	}
+
+	if ( !textTs && !isIndex ) {
+		struct stat	st;
+		fstat(in, &st);
+		off_t
+		left	= st.st_size;
+		while ( left > 0 ) {
+			const ssize_t
+			n		= copy_file_range(in, nullptr, out, nullptr, left, 0);
+			if ( n <= 0 )	break;
+			left	-= n;
+		}
+		if ( left > 0 ) {										// fallback
+			std::vector<char>
+			buf(1 << 20);
+			ssize_t	n;
+			while ( (n = ::read(in, buf.data(), buf.size())) > 0 )
+				if ( ::write(out, buf.data(), n) != n )	{ perror(dst.c_str()); exit(1); }
+		}
+	} else {
+		std::vector<uint64_t>
+		buf(1 << 17);
+		ssize_t	n;
+		while ( (n = ::read(in, buf.data(), buf.size() * 8)) > 0 ) {
+			const size_t
+			count	= n / 8;
+			if ( isIndex ) {										// {ts, row, file, offset}
+				for (size_t i = 0; i + 3 < count; i += 4) {
+					if ( textTs )	buf[i] = (buf[i] + rowBase) * options.period;
+					buf[i + 1]	+= rowBase;
+				}
+			} else {
+				for (size_t i = 0; i < count; ++i)
+					buf[i]	= (buf[i] + rowBase) * options.period;
+			}
+			if ( ::write(out, buf.data(), n) != n )	{ perror(dst.c_str()); exit(1); }
+		}
+	}
+	::close(in);
+	::close(out);
+	unlink(src.c_str());
+}
+
+void
+usage(const char* name) {
+	fprintf(stderr, "usage: %s [-j threads] [-p period_ms] [-i index_every] -o <dir> <capture>...\n", name);
+	exit(2);
+}
+
+}	// namespace
+// ----------------------------------------------------------------------------
+
+int
+main(int argc, char** argv) {
+	int	opt;
+	while ( (opt = getopt(argc, argv, "j:p:i:o:")) != -1 ) {
+		switch ( opt ) {
+		case 'j':	options.threads		= std::max(1, atoi(optarg));	break;
+		case 'p':	options.period		= strtoull(optarg, nullptr, 10);	break;
+		case 'i':	options.indexEvery	= std::max(1ULL, strtoull(optarg, nullptr, 10));	break;
+		case 'o':	options.out			= optarg;						break;
+		default:	usage(argv[0]);
+		}
+	}
+	if ( options.out.empty() || optind >= argc )	usage(argv[0]);
+	mkdir(options.out.c_str(), 0755);
+
+	const std::string
+	dir		= options.out + "/";
+	uint64_t
+	total[STREAMS]	= {};
+
+	// start with empty outputs
+	for (uint8_t s = 0; s < STREAMS; ++s) {
+		Part	part;
+		part.forEach(layouts[s], [&](Column& col, const std::string& suffix) {
+			col.open(dir + layouts[s].name + "." + suffix, false);
+		});
+	}
+
+	for (int f = optind; f < argc; ++f) {
+		const int
+		fd		= ::open(argv[f], O_RDONLY);
+		struct stat	st;
+		if ( fd < 0 || fstat(fd, &st) != 0 ) {
+			perror(argv[f]);
+			return 1;
+		}
+		const size_t
+		size	= st.st_size;
+		if ( size == 0 ) {
+			::close(fd);
+			continue;
+		}
+		const uint8_t*
+		base	= static_cast<const uint8_t*>(mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0));
+		if ( base == MAP_FAILED ) {
+			perror(argv[f]);
+			return 1;
+		}
+		madvise(const_cast<uint8_t*>(base), size, MADV_SEQUENTIAL | MADV_WILLNEED);
+
+		// chunks start at sensor header lines; small files are not split
+		const unsigned int
+		chunks	= ( size < (64u << 20) ) ? 1 : options.threads;
+		std::vector<const uint8_t*>
+		bounds{base};
+		for (unsigned int c = 1; c < chunks; ++c)
+			bounds.push_back(std::max(bounds.back(), nextRecord(base + size / chunks * c, base, base + size)));
+		bounds.push_back(base + size);
+
+		std::vector<Parser*>	parsers;
+		std::vector<std::thread>	threads;
+		for (unsigned int c = 0; c < chunks; ++c) {
+			parsers.push_back(new Parser(bounds[c], bounds[c + 1], base, size, f - optind,
+					dir + ".part" + std::to_string(c) + "."));
+			threads.emplace_back([p = parsers.back()]() { p->run(); });
+		}
+		for (auto& t : threads)	t.join();
+
+		// merge the parts in order
+		for (unsigned int c = 0; c < chunks; ++c) {
+			for (uint8_t s = 0; s < STREAMS; ++s) {
+				const bool
+				text	= ( s < DUMP_TCS );
+				Part	names;
+				names.forEach(layouts[s], [&](Column&, const std::string& suffix) {
+					const std::string
+					col		= std::string(layouts[s].name) + "." + suffix;
+					appendColumn(dir + ".part" + std::to_string(c) + "." + col, dir + col,
+							text && ( suffix == "ts.u64" || suffix == "idx" ),
+							suffix == "idx", total[s]);
+				});
+				total[s]	+= parsers[c]->rows(s);
+			}
+			delete parsers[c];
+		}
+
+		munmap(const_cast<uint8_t*>(base), size);
+		::close(fd);
+	}
+
+	FILE*
+	manifest	= fopen((dir + "manifest.txt").c_str(), "w");
+	if ( manifest == nullptr ) {
+		perror("manifest.txt");
+		return 1;
+	}
+	fprintf(manifest, "# stream rows columns (raw little-endian arrays)\n");
+	for (uint8_t s = 0; s < STREAMS; ++s) {
+		fprintf(manifest, "%s %llu", layouts[s].name, static_cast<unsigned long long>(total[s]));
+		Part	names;
+		names.forEach(layouts[s], [&](Column&, const std::string& suffix) {
+			fprintf(manifest, " %s", suffix.c_str());
+		});
+		fprintf(manifest, "\n");
+		fprintf(stderr, "%-10s %llu rows\n", layouts[s].name, static_cast<unsigned long long>(total[s]));
+	}
+	fclose(manifest);
+	return 0;
+}
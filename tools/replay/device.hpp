@@ -0,0 +1,41 @@
+// ----------------------------------------------------------------------------
+
+#ifndef REPLAY_DEVICE_HPP
+#define REPLAY_DEVICE_HPP
+
+#include <modm/processing.hpp>
+#include <engine.hpp>
+// ----------------------------------------------------------------------------
+
+namespace replay {
+
+/// @brief Common part of the replay sensor drivers
+///
+/// Every call completes at once. A sensor without samples in the capture
+/// does not answer, so the firmware sees it as not connected.
+template < Sensor S >
+class Device {
+public:
+	modm::ResumableResult<bool>
+	ping()						{ return transaction(); }
+
+	modm::ResumableResult<bool>
+	initialize()				{ return transaction(); }
+
+	modm::ResumableResult<bool>
+	refreshAllColors()			{ return engine().read(S, _sample); }
+
+protected:
+	bool
+	transaction()				{
+		engine().transaction(S);
+		return engine().present(S);
+	}
+
+	Sample			_sample		= {};
+};
+
+}	// namespace replay
+// ----------------------------------------------------------------------------
+
+#endif	// REPLAY_DEVICE_HPP
@@ -0,0 +1,179 @@
+// ----------------------------------------------------------------------------
+
+#ifndef REPLAY_ENGINE_HPP
+#define REPLAY_ENGINE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+// ----------------------------------------------------------------------------
+
+/// @brief Deterministic replay of a recorded capture through the firmware
+///
+/// The firmware (main.cpp) is built for the host against the small modm
+/// replacement in tools/replay/modm: the sensor drivers take their samples
+/// from the capture, the clock is virtual and the UART goes to a file.
+///
+/// Time only moves when the firmware is idle: every main loop pass polls
+/// the timers (at least the LED one), so a timer polled a second time
+/// starts a new pass. Then the engine jumps the clock to the next timer
+/// deadline unless the previous pass did something (a timer fired, a
+/// sample was read, a byte was printed or typed). So the real
+/// protothreads run exactly as on the device, only as fast as possible,
+/// and two runs of the same capture produce the same output.
+namespace replay {
+
+enum Sensor : uint8_t {
+	TCS,
+	V6040,
+	V6070,
+	SENSORS
+};
+
+struct Sample {
+	uint16_t		ch[4];
+};
+
+/// thrown out of the firmware main loop when the capture is exhausted
+struct End {};
+
+/// @brief Timer deadlines known to the engine (base of the modm timers)
+class Timer {
+public:
+	Timer();
+	~Timer();
+
+	Timer(const Timer&)				= delete;
+	Timer& operator=(const Timer&)	= delete;
+
+protected:
+	/// @return true once per arming when the deadline has passed
+	bool
+	expired();
+
+	void
+	arm(uint32_t deadline)		{
+		_deadline	= deadline;
+		_armed		= true;
+		_fired		= false;
+		_polled		= UINT64_MAX;		// a restarted timer polled in the same pass
+	}
+
+	void
+	disarm()					{ _armed = false; }
+
+	uint32_t		_deadline	= 0;
+	bool			_armed		= false;
+	bool			_fired		= false;
+
+private:
+	friend class Engine;
+	uint64_t		_polled		= UINT64_MAX;	// engine pass of the last poll
+	Timer*			_next;
+	Timer*			_prev;
+};
+
+class Engine {
+public:
+	using WallClock	= std::chrono::steady_clock;
+
+	/// @brief load the text samples of a capture ("TCS34725\nRGBW Hue: ...")
+	bool
+	load(const char* path);
+
+	/// @brief input typed at virtual times, lines "<ms> <text>" ("^C" = Ctrl+C)
+	bool
+	script(const char* path);
+
+	void
+	setOutput(FILE* out)		{ _out = out; }
+
+	void
+	setRepeat(uint32_t n)		{ _repeat = n ? n : 1; }
+
+	/// @brief run the firmware main() until the capture is exhausted
+	void
+	run(int (*firmwareMain)());
+
+	void
+	report(FILE* f) const;
+
+	// --- platform side -------------------------------------------------------
+
+	uint32_t
+	now() const					{ return _now; }
+
+	/// sensor answers on the bus: it has samples in the capture
+	bool
+	present(Sensor s) const		{ return !_samples[s].empty(); }
+
+	/// a bus transaction other than a read (ping, initialize, configure)
+	void
+	transaction(Sensor s)		{ ++_transactions[s]; _activity = true; }
+
+	/// @brief next sample of a sensor (the read transaction)
+	/// @return false once the capture (times repeat) is exhausted
+	bool
+	read(Sensor s, Sample& out);
+
+	void
+	write(const char* p, size_t n);
+
+	/// @brief UART receive
+	/// @return the next scripted character or 0
+	char
+	input();
+
+	void
+	activity()					{ _activity = true; }
+
+private:
+	friend class Timer;
+
+	struct Input {
+		uint32_t		ms;
+		std::string		text;
+	};
+
+	void
+	pass();
+
+	uint32_t
+	nextDeadline() const;
+
+	uint32_t					_now		= 0;
+	uint64_t					_passes		= 0;		// main loop passes
+	bool						_activity	= true;
+	Timer*						_timers		= nullptr;
+
+	std::vector<Sample>			_samples[SENSORS];
+	uint64_t					_next[SENSORS]	= {};
+	uint64_t					_transactions[SENSORS]	= {};
+	uint32_t					_repeat		= 1;
+	uint32_t					_lastRead	= 0;		// virtual ms
+
+	std::vector<Input>			_inputs;
+	size_t						_input		= 0;
+	size_t						_inputPos	= 0;
+
+	FILE*						_out		= nullptr;
+	uint64_t					_bytes		= 0;
+	uint64_t					_hash		= 0xcbf29ce484222325ULL;	// FNV-1a
+
+	// per-sample latency: read by the driver -> end of that main loop pass
+	std::vector<WallClock::time_point>	_open;
+	std::vector<uint32_t>				_latency;		// ns
+	double								_wall		= 0;	// s
+};
+
+Engine&
+engine();
+
+}	// namespace replay
+// ----------------------------------------------------------------------------
+
+#endif	// REPLAY_ENGINE_HPP
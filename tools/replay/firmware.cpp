@@ -0,0 +1,6 @@
+// ----------------------------------------------------------------------------
+// The firmware, unchanged, built against the replay platform (modm/ here)
+// ----------------------------------------------------------------------------
+
+#define main firmwareMain
+#include <main.cpp>
@@ -0,0 +1,39 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: GPIO levels and a pin that does nothing
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_GPIO_HPP
+#define MODM_REPLAY_GPIO_HPP
+
+namespace modm
+{
+
+struct Gpio
+{
+	enum Level
+	{
+		Low		= 0,
+		High	= 1
+	};
+};
+
+}	// namespace modm
+
+namespace replay
+{
+
+struct GpioPin
+{
+	struct Sda {};
+	struct Scl {};
+
+	static void setOutput(modm::Gpio::Level) {}
+	static void setOutput() {}
+	static void set() {}
+	static void reset() {}
+	static void toggle() {}
+};
+
+}	// namespace replay
+
+#endif	// MODM_REPLAY_GPIO_HPP
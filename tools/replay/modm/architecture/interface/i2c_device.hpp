@@ -0,0 +1,51 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: modm::I2cDevice without a bus
+//
+// Only devices the replay has no model for use it (the VEML6070 Alert
+// Response Address, the TCS3472 register writes): every transaction
+// succeeds at once.
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_I2C_DEVICE_HPP
+#define MODM_REPLAY_I2C_DEVICE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <modm/processing.hpp>
+
+namespace modm
+{
+
+class I2cWriteReadTransaction
+{
+public:
+	void configureWrite(const uint8_t*, size_t) {}
+	void configureRead(uint8_t* buffer, size_t size) { for (size_t i = 0; i < size; ++i) buffer[i] = 0; }
+	void configureWriteRead(const uint8_t*, size_t, uint8_t* buffer, size_t size) { configureRead(buffer, size); }
+};
+
+template < class I2cMaster, uint8_t NestingLevels = 10, class Transaction = I2cWriteReadTransaction >
+class I2cDevice : public modm::NestedResumable< NestingLevels + 1 >
+{
+public:
+	explicit
+	I2cDevice(uint8_t address) : address(address) {}
+
+	void
+	setAddress(uint8_t address)	{ this->address = address; }
+
+	modm::ResumableResult<bool>
+	ping()						{ return true; }
+
+protected:
+	modm::ResumableResult<bool>
+	runTransaction()			{ return true; }
+
+	uint8_t			address;
+	Transaction		transaction;
+};
+
+}	// namespace modm
+
+#endif	// MODM_REPLAY_I2C_DEVICE_HPP
@@ -0,0 +1,15 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: compiler helpers of modm/architecture/utils.hpp
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_UTILS_HPP
+#define MODM_REPLAY_UTILS_HPP
+
+#define modm_fallthrough		[[fallthrough]]
+#define modm_always_inline		inline __attribute__((always_inline))
+#define modm_packed				__attribute__((packed))
+#define modm_aligned(n)			__attribute__((aligned(n)))
+#define modm_likely(x)			__builtin_expect(!!(x), 1)
+#define modm_unlikely(x)		__builtin_expect(!!(x), 0)
+
+#endif	// MODM_REPLAY_UTILS_HPP
@@ -0,0 +1,84 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: the parts of the NUCLEO-F410RB board the firmware uses
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_BOARD_HPP
+#define MODM_REPLAY_BOARD_HPP
+
+#include <stdint.h>
+
+#include <modm/architecture/utils.hpp>
+#include <modm/architecture/interface/gpio.hpp>
+#include <modm/debug.hpp>
+#include <modm/processing.hpp>
+
+namespace modm
+{
+namespace literals
+{
+
+constexpr uint32_t operator""_Hz(unsigned long long v)	{ return v; }
+constexpr uint32_t operator""_kHz(unsigned long long v)	{ return v * 1000; }
+constexpr uint32_t operator""_MHz(unsigned long long v)	{ return v * 1000000; }
+
+}	// namespace literals
+}	// namespace modm
+
+namespace Board
+{
+
+struct SystemClock
+{
+	static constexpr uint32_t Frequency	= 96000000;
+};
+
+using LedD13	= replay::GpioPin;
+using GpioB8	= replay::GpioPin;
+using GpioB9	= replay::GpioPin;
+
+/// the sensors are the replay drivers, the bus is never touched
+struct I2cMaster1
+{
+	template < class... Signals >
+	static void connect() {}
+
+	template < class SystemClock, uint32_t baudrate >
+	static void initialize() {}
+};
+using I2cMaster2	= I2cMaster1;
+
+struct UsartHal2
+{
+	enum class Interrupt
+	{
+		RxNotEmpty
+	};
+
+	static void enableInterruptVector(bool, uint32_t) {}
+	static void enableInterrupt(Interrupt) {}
+	static void setReceiverEnable(bool) {}
+};
+
+inline void
+initialize() {}
+
+}	// namespace Board
+
+// the registers main.cpp touches directly: RCC and PWR are written and
+// ignored, the RTC backup registers are RAM ('script save')
+struct ReplayRtc	{ volatile uint32_t BKP0R, BKP1R, BKP2R, BKP3R, BKP4R, BKP5R, BKP6R, BKP7R, BKP8R, BKP9R,
+					  BKP10R, BKP11R, BKP12R, BKP13R, BKP14R, BKP15R, BKP16R, BKP17R, BKP18R, BKP19R; };
+struct ReplayRcc	{ volatile uint32_t APB1ENR; };
+struct ReplayPwr	{ volatile uint32_t CR; };
+
+inline ReplayRtc	replayRtc	= {};
+inline ReplayRcc	replayRcc	= {};
+inline ReplayPwr	replayPwr	= {};
+
+#define RTC					(&replayRtc)
+#define RCC					(&replayRcc)
+#define PWR					(&replayPwr)
+#define RCC_APB1ENR_PWREN	(1u << 28)
+#define PWR_CR_DBP			(1u << 8)
+
+#endif	// MODM_REPLAY_BOARD_HPP
@@ -0,0 +1,41 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: modm logger, every level goes to the replayed UART
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_DEBUG_HPP
+#define MODM_REPLAY_DEBUG_HPP
+
+#include <modm/io/iostream.hpp>
+
+namespace modm
+{
+namespace log
+{
+
+enum Level
+{
+	DEBUG,
+	INFO,
+	WARNING,
+	ERROR,
+	DISABLED
+};
+
+inline IOStream		debug;
+inline IOStream		info;
+inline IOStream		warning;
+inline IOStream		error;
+
+}	// namespace log
+}	// namespace modm
+
+#ifndef MODM_LOG_LEVEL
+#define MODM_LOG_LEVEL		modm::log::DEBUG
+#endif
+
+#define MODM_LOG_DEBUG		if (MODM_LOG_LEVEL > modm::log::DEBUG) {} else modm::log::debug
+#define MODM_LOG_INFO		if (MODM_LOG_LEVEL > modm::log::INFO) {} else modm::log::info
+#define MODM_LOG_WARNING	if (MODM_LOG_LEVEL > modm::log::WARNING) {} else modm::log::warning
+#define MODM_LOG_ERROR		if (MODM_LOG_LEVEL > modm::log::ERROR) {} else modm::log::error
+
+#endif	// MODM_REPLAY_DEBUG_HPP
@@ -0,0 +1,80 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: TCS3472 driver fed from the capture
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_TCS3472_HPP
+#define MODM_REPLAY_TCS3472_HPP
+
+#include <stdint.h>
+
+#include <modm/ui/color.hpp>
+#include <device.hpp>
+
+namespace modm
+{
+
+struct tcs3472
+{
+	enum class Gain : uint8_t
+	{
+		X1			= 0b00,
+		X4			= 0b01,
+		X16			= 0b10,
+		X60			= 0b11,
+		DEFAULT		= 0
+	};
+
+	enum class IntegrationTime : uint8_t
+	{
+		MSEC_2		= 0xFF,
+		MSEC_24		= 0xF6,
+		MSEC_101	= 0xD5,
+		MSEC_154	= 0xC0,
+		MSEC_700	= 0x00,
+		DEFAULT		= 0xFF
+	};
+
+	enum class WaitTime : uint8_t
+	{
+		MSEC_2		= 0xFF,
+		MSEC_204	= 0xAB,
+		MSEC_614	= 0x00,
+		DEFAULT		= 0xFF
+	};
+
+	typedef uint16_t	UnderlyingType;
+	typedef color::RgbwT<UnderlyingType> Rgbw;
+};
+
+template < typename I2cMaster >
+class Tcs3472 : public tcs3472, public replay::Device<replay::TCS>
+{
+public:
+	Tcs3472(uint8_t = 0x29) {}
+
+	modm::ResumableResult<bool>
+	configure(Gain gain = Gain::DEFAULT, uint8_t = 0, uint8_t = 0)
+	{
+		this->gain	= gain;
+		return transaction();
+	}
+
+	Rgbw
+	getOldColors() const
+	{
+		Rgbw	c;
+		c.red	= _sample.ch[0];
+		c.green	= _sample.ch[1];
+		c.blue	= _sample.ch[2];
+		c.white	= _sample.ch[3];
+		return c;
+	}
+
+	Gain				gain			= Gain::DEFAULT;
+	IntegrationTime		integrationTime	= IntegrationTime::DEFAULT;
+	WaitTime			waitTime		= WaitTime::DEFAULT;
+};
+
+}	// namespace modm
+
+#endif	// MODM_REPLAY_TCS3472_HPP
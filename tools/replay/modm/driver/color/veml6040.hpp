@@ -0,0 +1,85 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: VEML6040 driver fed from the capture
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_VEML6040_HPP
+#define MODM_REPLAY_VEML6040_HPP
+
+#include <stdint.h>
+
+#include <modm/ui/color.hpp>
+#include <device.hpp>
+#include <shadow.hpp>
+
+namespace modm
+{
+
+struct veml6040
+{
+	enum class IntegrationTime : uint8_t
+	{
+		MSEC_1280	= 0x50,
+		MSEC_640	= 0x40,
+		MSEC_320	= 0x30,
+		MSEC_160	= 0x20,
+		MSEC_80		= 0x10,
+		MSEC_40		= 0x00,
+		DEFAULT		= 0x00
+	};
+
+	typedef uint16_t	UnderlyingType;
+	typedef color::RgbwT<UnderlyingType> Rgbw;
+};
+
+template < typename I2cMaster >
+class Veml6040 : public veml6040, public replay::Device<replay::V6040>
+{
+public:
+	Veml6040(uint8_t = 0x10) {}
+
+	// ENABLE is shadowed as by the firmware driver: unchanged, no transaction
+	modm::ResumableResult<bool>
+	initialize()				{
+		_shadow.lost();
+		return write(0x20);
+	}
+
+	modm::ResumableResult<bool>
+	configure(uint8_t t = 0)	{ return write(t); }
+
+	modm::ResumableResult<bool>
+	sleep(bool shutdown)		{ return write(static_cast<uint8_t>(integrationTime) | ( shutdown ? 0x01 : 0 )); }
+
+	const RegisterShadow<1>&
+	writes() const				{ return _shadow; }
+
+	Rgbw
+	getOldColors() const
+	{
+		Rgbw	c;
+		c.red	= _sample.ch[0];
+		c.green	= _sample.ch[1];
+		c.blue	= _sample.ch[2];
+		c.white	= _sample.ch[3];
+		return c;
+	}
+
+	IntegrationTime		integrationTime	= IntegrationTime::DEFAULT;
+
+private:
+	bool
+	write(uint8_t value)		{
+		if ( !_shadow.needed(0, value) )	return true;
+		const bool
+		ok		= transaction();
+		if ( ok )	_shadow.written(0, value);
+		else		_shadow.lost();
+		return ok;
+	}
+
+	RegisterShadow<1>	_shadow;
+};
+
+}	// namespace modm
+
+#endif	// MODM_REPLAY_VEML6040_HPP
@@ -0,0 +1,55 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: VEML6070 driver fed from the capture
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_VEML6070_HPP
+#define MODM_REPLAY_VEML6070_HPP
+
+#include <stdint.h>
+
+#include <device.hpp>
+
+namespace modm
+{
+
+struct veml6070
+{
+	enum class IntegrationTime : uint8_t
+	{
+		MSEC_62_5	= 0x00,
+		MSEC_125	= 0x04,
+		MSEC_250	= 0x08,
+		MSEC_500	= 0x0C,
+		DEFAULT		= 0x04
+	};
+
+	struct Uv
+	{
+		uint16_t	uv;
+	};
+};
+
+template < typename I2cMaster >
+class Veml6070 : public veml6070, public replay::Device<replay::V6070>
+{
+public:
+	Veml6070(uint8_t = 0x38) {}
+
+	modm::ResumableResult<bool>
+	configure(uint8_t = 0)		{ return transaction(); }
+
+	modm::ResumableResult<bool>
+	sleep(bool)					{ return transaction(); }
+
+	Uv
+	getOldColors() const		{ return Uv{_sample.ch[0]}; }
+
+	uint8_t
+	timeForNext() const			{ return 1 << (static_cast<uint8_t>(integrationTime) >> 2); }
+
+	IntegrationTime		integrationTime	= IntegrationTime::DEFAULT;
+};
+
+}	// namespace modm
+
+#endif	// MODM_REPLAY_VEML6070_HPP
@@ -0,0 +1,99 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: modm::IOStream on top of the replay engine
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_IOSTREAM_HPP
+#define MODM_REPLAY_IOSTREAM_HPP
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <engine.hpp>
+
+namespace modm
+{
+
+/// @brief the subset of modm::IOStream the firmware uses
+///
+/// Output goes to the engine (file + hash), get() is the UART receive
+/// and the engine's main loop hook.
+class IOStream
+{
+public:
+	static constexpr char eof	= -1;
+
+	IOStream&
+	write(char c)
+	{
+		replay::engine().write(&c, 1);
+		return *this;
+	}
+
+	IOStream&
+	flush()						{ return *this; }
+
+	/// one character per call, '\0' if nothing was received
+	IOStream&
+	get(char* s, size_t n)
+	{
+		if (n > 0) s[0] = replay::engine().input();
+		if (n > 1) s[1] = '\0';
+		return *this;
+	}
+
+	IOStream&
+	get(char& c)
+	{
+		c	= replay::engine().input();
+		if (c == 0) c = eof;
+		return *this;
+	}
+
+	IOStream&
+	printf(const char* fmt, ...) __attribute__((format(printf, 2, 3)))
+	{
+		char	buf[256];
+		va_list	ap;
+		va_start(ap, fmt);
+		const int
+		n	= vsnprintf(buf, sizeof(buf), fmt, ap);
+		va_end(ap);
+		if (n > 0) put(buf, (size_t(n) < sizeof(buf)) ? n : sizeof(buf) - 1);
+		return *this;
+	}
+
+	IOStream& operator << (char c)				{ return write(c); }
+	IOStream& operator << (const char* s)		{ put(s, strlen(s)); return *this; }
+	IOStream& operator << (bool v)				{ return *this << (v ? "true" : "false"); }
+	IOStream& operator << (uint8_t v)			{ return printf("%u", unsigned(v)); }
+	IOStream& operator << (int8_t v)			{ return printf("%d", int(v)); }
+	IOStream& operator << (uint16_t v)			{ return printf("%u", unsigned(v)); }
+	IOStream& operator << (int16_t v)			{ return printf("%d", int(v)); }
+	IOStream& operator << (unsigned int v)		{ return printf("%u", v); }
+	IOStream& operator << (int v)				{ return printf("%d", v); }
+	IOStream& operator << (unsigned long v)		{ return printf("%lu", v); }
+	IOStream& operator << (long v)				{ return printf("%ld", v); }
+	IOStream& operator << (unsigned long long v){ return printf("%llu", v); }
+	IOStream& operator << (long long v)			{ return printf("%lld", v); }
+	IOStream& operator << (float v)				{ return printf("%f", double(v)); }
+	IOStream& operator << (double v)			{ return printf("%f", v); }
+
+	IOStream&
+	operator << (IOStream& (*f)(IOStream&))		{ return f(*this); }
+
+private:
+	void
+	put(const char* s, size_t n)				{ replay::engine().write(s, n); }
+};
+
+inline IOStream&
+endl(IOStream& ios)				{ return ios << '\n'; }
+
+inline IOStream&
+flush(IOStream& ios)			{ return ios.flush(); }
+
+}	// namespace modm
+
+#endif	// MODM_REPLAY_IOSTREAM_HPP
@@ -0,0 +1,256 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: modm clock, timers, resumables and protothreads
+//
+// The clock is the engine's virtual time. Resumable functions of the
+// replay drivers always complete in one call, so the RF_* macros only
+// need to forward results; the PT_* macros are those of modm.
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_PROCESSING_HPP
+#define MODM_REPLAY_PROCESSING_HPP
+
+#include <stdint.h>
+
+#include <modm/architecture/utils.hpp>
+#include <engine.hpp>
+
+namespace modm
+{
+
+class Timestamp
+{
+public:
+	Timestamp(uint32_t time = 0) : time(time) {}
+
+	uint32_t
+	getTime() const				{ return time; }
+
+private:
+	uint32_t		time;
+};
+
+struct Clock
+{
+	static Timestamp
+	now()						{ return replay::engine().now(); }
+};
+// ----------------------------------------------------------------------------
+
+/// one-shot timeout in ms of virtual time
+class ShortTimeout : public replay::Timer
+{
+public:
+	ShortTimeout() = default;
+
+	explicit
+	ShortTimeout(uint32_t interval)	{ restart(interval); }
+
+	void
+	restart(uint32_t interval)
+	{
+		_interval	= interval;
+		arm(replay::engine().now() + interval);
+	}
+
+	void
+	restart()					{ restart(_interval); }
+
+	void
+	stop()						{ disarm(); }
+
+	bool
+	isArmed() const				{ return _armed && replay::engine().now() < _deadline; }
+
+	bool
+	isExpired()					{ return _armed && expired(); }
+
+	bool
+	execute()
+	{
+		if (!_armed || !expired()) return false;
+		disarm();
+		return true;
+	}
+
+	uint32_t
+	remaining() const
+	{
+		const uint32_t now	= replay::engine().now();
+		return (_armed && now < _deadline) ? _deadline - now : 0;
+	}
+
+private:
+	uint32_t		_interval	= 0;
+};
+using Timeout			= ShortTimeout;
+
+/// periodic timer, execute() is true once per period
+class ShortPeriodicTimer : public replay::Timer
+{
+public:
+	explicit
+	ShortPeriodicTimer(uint32_t period) : _period(period)
+	{
+		arm(replay::engine().now() + period);
+	}
+
+	void
+	restart(uint32_t period)
+	{
+		_period		= period;
+		restart();
+	}
+
+	void
+	restart()					{ arm(replay::engine().now() + _period); }
+
+	void
+	stop()						{ disarm(); }
+
+	bool
+	isArmed() const				{ return _armed; }
+
+	bool
+	execute()
+	{
+		if (!_armed || !expired()) return false;
+		const uint32_t now	= replay::engine().now();
+		_deadline	+= _period;
+		if (now >= _deadline) _deadline = now + _period;		// skip missed periods
+		_fired		= false;
+		return true;
+	}
+
+private:
+	uint32_t		_period;
+};
+using PeriodicTimer		= ShortPeriodicTimer;
+// ----------------------------------------------------------------------------
+
+namespace rf
+{
+enum : uint8_t
+{
+	Stop			= 0,
+	NestingError	= (1 << 0),
+	Running			= (1 << 1),
+};
+}	// namespace rf
+
+template < typename T >
+struct ResumableResult
+{
+	ResumableResult(uint8_t state, T result) : state(state), result(result) {}
+	ResumableResult(T result) : state(rf::Stop), result(result) {}
+
+	uint8_t
+	getState() const			{ return state; }
+
+	T
+	getResult() const			{ return result; }
+
+	uint8_t		state;
+	T			result;
+};
+
+template < uint8_t Levels = 1 >
+class NestedResumable {};
+
+template < uint8_t Functions = 1 >
+class Resumable {};
+
+#define RF_BEGIN(...)
+#define RF_END()					return {modm::rf::Stop}
+#define RF_END_RETURN(value)		return {modm::rf::Stop, value}
+#define RF_RETURN(value)			return {modm::rf::Stop, value}
+#define RF_END_RETURN_CALL(res)		return res
+#define RF_RETURN_CALL(res)			return res
+#define RF_CALL(res)				(res).getResult()
+#define RF_CALL_BLOCKING(res)		(res).getResult()
+#define RF_WAIT_UNTIL(cond)			(void)(cond)
+#define RF_WAIT_WHILE(cond)			(void)(cond)
+#define RF_YIELD()
+// ----------------------------------------------------------------------------
+
+namespace pt
+{
+
+class Protothread
+{
+public:
+	Protothread() : ptState(0) {}
+
+	void
+	restart()					{ ptState = 0; }
+
+	void
+	stop()						{ ptState = Invalid; }
+
+	bool
+	isRunning() const			{ return ptState != Invalid; }
+
+protected:
+	typedef uint16_t PtState;
+	static constexpr PtState Invalid	= static_cast<PtState>(-1);
+
+	PtState		ptState;
+};
+
+}	// namespace pt
+}	// namespace modm
+
+#define PT_BEGIN() \
+	bool ptYielded = true; (void) ptYielded; \
+	switch (this->ptState) { \
+		case 0:
+
+#define PT_END() \
+			modm_fallthrough; \
+		default: ; \
+	} \
+	this->stop(); \
+	return false;
+
+#define PT_YIELD() \
+	do { \
+		ptYielded = true; \
+		this->ptState = __LINE__; \
+		return true; \
+		case __LINE__: ; \
+	} while (0)
+
+#define PT_WAIT_UNTIL(condition) \
+	do { \
+		this->ptState = __LINE__; \
+		modm_fallthrough; \
+		case __LINE__: \
+			if (!(condition)) \
+				return true; \
+	} while (0)
+
+#define PT_WAIT_WHILE(condition)	PT_WAIT_UNTIL(!(condition))
+
+#define PT_CALL(resumable) \
+	({ \
+		this->ptState = __LINE__; \
+		modm_fallthrough; \
+		case __LINE__: \
+			auto ptResult = resumable; \
+			if (ptResult.getState() > modm::rf::NestingError) \
+				return true; \
+			ptResult.getResult(); \
+	})
+
+#define PT_RESTART() \
+	do { \
+		this->restart(); \
+		return true; \
+	} while (0)
+
+#define PT_EXIT() \
+	do { \
+		this->stop(); \
+		return false; \
+	} while (0)
+
+#endif	// MODM_REPLAY_PROCESSING_HPP
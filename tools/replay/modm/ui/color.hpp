@@ -0,0 +1,66 @@
+// ----------------------------------------------------------------------------
+// Host replay platform: the colour types of modm/ui/color.hpp
+// ----------------------------------------------------------------------------
+
+#ifndef MODM_REPLAY_COLOR_HPP
+#define MODM_REPLAY_COLOR_HPP
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace modm
+{
+namespace color
+{
+
+template < typename T >
+struct HsvT
+{
+	T		hue;
+	T		saturation;
+	T		value;
+};
+
+template < typename T >
+struct RgbT
+{
+	T		red;
+	T		green;
+	T		blue;
+
+	/// hue in degrees, saturation and value scaled to T
+	template < typename U >
+	void
+	toHsv(HsvT<U>* hsv) const
+	{
+		const float	maxValue	= std::numeric_limits<U>::max();
+		const float	r	= red, g = green, b = blue;
+		const float	hi	= std::max(r, std::max(g, b));
+		const float	lo	= std::min(r, std::min(g, b));
+		const float	d	= hi - lo;
+
+		float	h	= 0;
+		if (d > 0) {
+			if (hi == r)		h = 60 * (0 + (g - b) / d);
+			else if (hi == g)	h = 60 * (2 + (b - r) / d);
+			else				h = 60 * (4 + (r - g) / d);
+			if (h < 0) h += 360;
+		}
+		hsv->hue		= static_cast<U>(h);
+		hsv->saturation	= static_cast<U>(hi > 0 ? d / hi * maxValue : 0);
+		hsv->value		= static_cast<U>(hi);
+	}
+};
+
+template < typename T >
+struct RgbwT : public RgbT<T>
+{
+	T		white;
+};
+
+}	// namespace color
+}	// namespace modm
+
+#endif	// MODM_REPLAY_COLOR_HPP
@@ -0,0 +1,348 @@
+// ----------------------------------------------------------------------------
+// Deterministic replay of a recorded capture through the firmware
+//
+// Usage: replay [-r repeat] [-s script] [-o output] <capture>
+//
+// The sensor samples of <capture> (the text output of the device) are fed
+// through the real protothreads of main.cpp under a virtual clock, as fast
+// as possible (see engine.hpp). Commands can be typed at virtual times with
+// a script of "<ms> <text>" lines, "^C" is Ctrl+C. The firmware output goes
+// to <output> (default: discarded) and its FNV-1a hash is reported, so two
+// revisions can be compared on identical input along with
+//		throughput			samples/s of host time
+//		latency				host time from the sensor read to the end of
+//							that main loop pass, min/p50/p99/max
+// ----------------------------------------------------------------------------
+
+#include <engine.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+// ----------------------------------------------------------------------------
+
+int
+firmwareMain();
+
+namespace replay {
+
+namespace {
+
+const char* const
+names[SENSORS]	= {"tcs", "v6040", "v6070"};
+
+/// virtual time without any sample or input before the replay gives up
+const uint32_t
+IDLE_MS			= 60000;
+
+}	// namespace
+
+Engine&
+engine() {
+	static Engine	e;
+	return e;
+}
+
+Timer::Timer() {
+	Engine&	e	= engine();
+	_prev		= nullptr;
+	_next		= e._timers;
+	if ( _next )	_next->_prev = this;
+	e._timers	= this;
+}
+
+Timer::~Timer() {
+	Engine&	e	= engine();
+	if ( _prev )	_prev->_next = _next;
+	else			e._timers = _next;
+	if ( _next )	_next->_prev = _prev;
+}
+
+bool
+Timer::expired() {
+	Engine&	e	= engine();
+	if ( _polled == e._passes )	e.pass();		// polled again: next main loop pass
+	_polled		= e._passes;
+
+	if ( !_armed || e.now() < _deadline )	return false;
+	if ( !_fired ) {
+		_fired	= true;
+		e.activity();
+	}
+	return true;
+}
+// ----------------------------------------------------------------------------
+
+bool
+Engine::load(const char* path) {
+	std::ifstream
+	in(path, std::ios::binary);
+	if ( !in )	return false;
+
+	// "<header>\n<data>\n", a header may follow an unterminated prompt
+	std::string
+	line;
+	int
+	sensor	= -1;
+	while ( std::getline(in, line) ) {
+		if ( !line.empty() && line.back() == '\r' )	line.pop_back();
+		const size_t
+		n		= line.size();
+		if ( n >= 8 && line.compare(n - 8, 8, "TCS34725") == 0 ) {
+			sensor	= TCS;
+			continue;
+		}
+		if ( n >= 8 && line.compare(n - 8, 8, "VEML6040") == 0 ) {
+			sensor	= V6040;
+			continue;
+		}
+		if ( n >= 8 && line.compare(n - 8, 8, "VEML6070") == 0 ) {
+			sensor	= V6070;
+			continue;
+		}
+
+		unsigned int
+		v[4]	= {};
+		Sample
+		s		= {};
+		const size_t
+		colon	= line.find(':');					// "RGBW[ Hue][ Sat][ Val]:", 'report --fields'
+		if ( (sensor == TCS || sensor == V6040) && line.compare(0, 4, "RGBW") == 0 && colon != std::string::npos &&
+			 sscanf(line.c_str() + colon + 1, "%u %u %u %u", &v[0], &v[1], &v[2], &v[3]) == 4 ) {
+			for (uint8_t i = 0; i < 4; ++i)	s.ch[i] = v[i];
+			_samples[sensor].push_back(s);
+		} else if ( sensor == V6070 && sscanf(line.c_str(), "Uv: %u", &v[0]) == 1 ) {
+			s.ch[0]	= v[0];
+			_samples[sensor].push_back(s);
+		}
+		sensor	= -1;
+	}
+	return true;
+}
+
+bool
+Engine::script(const char* path) {
+	std::ifstream
+	in(path);
+	if ( !in )	return false;
+
+	std::string
+	line;
+	while ( std::getline(in, line) ) {
+		if ( line.empty() || line[0] == '#' )	continue;
+		char*
+		end;
+		const unsigned long
+		ms		= strtoul(line.c_str(), &end, 10);
+		if ( end == line.c_str() )	return false;
+		while ( *end == ' ' || *end == '\t' )	++end;
+
+		Input
+		input{static_cast<uint32_t>(ms), std::string()};
+		for (const char* p = end; *p; ++p) {
+			if ( p[0] == '^' && p[1] == 'C' ) {
+				input.text	+= '\x03';
+				++p;
+			} else {
+				input.text	+= *p;
+			}
+		}
+		if ( input.text.find('\x03') == std::string::npos )	input.text += '\r';
+		_inputs.push_back(input);
+	}
+	std::stable_sort(_inputs.begin(), _inputs.end(),
+			[](const Input& a, const Input& b) { return a.ms < b.ms; });
+	return true;
+}
+// ----------------------------------------------------------------------------
+
+bool
+Engine::read(Sensor s, Sample& out) {
+	++_transactions[s];
+	const std::vector<Sample>&
+	samples	= _samples[s];
+	if ( samples.empty() || _next[s] >= samples.size() * _repeat )	return false;
+
+	out			= samples[_next[s]++ % samples.size()];
+	_lastRead	= _now;
+	_activity	= true;
+	_open.push_back(WallClock::now());
+	return true;
+}
+
+void
+Engine::write(const char* p, size_t n) {
+	for (size_t i = 0; i < n; ++i) {
+		_hash	^= static_cast<uint8_t>(p[i]);
+		_hash	*= 0x100000001b3ULL;
+	}
+	_bytes		+= n;
+	_activity	= true;
+	if ( _out )	fwrite(p, 1, n, _out);
+}
+
+char
+Engine::input() {
+	if ( _input < _inputs.size() && _inputs[_input].ms <= _now ) {
+		const std::string&
+		text	= _inputs[_input].text;
+		const char
+		c		= text[_inputPos++];
+		if ( _inputPos == text.size() ) {
+			++_input;
+			_inputPos	= 0;
+		}
+		_activity	= true;
+		return c;
+	}
+	return 0;
+}
+
+/// start of a main loop pass: close the samples of the last one, move time
+void
+Engine::pass() {
+	++_passes;
+
+	const WallClock::time_point
+	now		= WallClock::now();
+	for (const auto& t : _open)
+		_latency.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(now - t).count());
+	_open.clear();
+
+	bool
+	exhausted	= true;
+	for (uint8_t s = 0; s < SENSORS; ++s)
+		if ( present(Sensor(s)) && _next[s] < _samples[s].size() * _repeat )	exhausted = false;
+	const bool
+	inputDone	= ( _input >= _inputs.size() );
+	if ( inputDone && ( exhausted || _now - _lastRead > IDLE_MS ) )
+		throw End();
+
+	if ( _activity ) {
+		_activity	= false;
+		return;
+	}
+	_now	= nextDeadline();
+}
+
+uint32_t
+Engine::nextDeadline() const {
+	uint32_t
+	next	= UINT32_MAX;
+	for (const Timer* t = _timers; t; t = t->_next)
+		if ( t->_armed && !t->_fired && t->_deadline > _now && t->_deadline < next )
+			next	= t->_deadline;
+	if ( _input < _inputs.size() && _inputs[_input].ms > _now && _inputs[_input].ms < next )
+		next	= _inputs[_input].ms;
+	return ( next == UINT32_MAX ) ? _now + 1 : next;
+}
+// ----------------------------------------------------------------------------
+
+void
+Engine::run(int (*firmwareMain)()) {
+	const WallClock::time_point
+	start	= WallClock::now();
+	try {
+		firmwareMain();
+	} catch (const End&) {
+	}
+	_wall	= std::chrono::duration<double>(WallClock::now() - start).count();
+}
+
+void
+Engine::report(FILE* f) const {
+	uint64_t
+	total	= 0;
+	fprintf(f, "samples     ");
+	for (uint8_t s = 0; s < SENSORS; ++s) {
+		fprintf(f, " %s=%llu", names[s], static_cast<unsigned long long>(_next[s]));
+		total	+= _next[s];
+	}
+	fprintf(f, " total=%llu\n", static_cast<unsigned long long>(total));
+	fprintf(f, "bus         ");
+	for (uint8_t s = 0; s < SENSORS; ++s)
+		fprintf(f, " %s=%llu", names[s], static_cast<unsigned long long>(_transactions[s]));
+	fprintf(f, " transactions\n");
+	fprintf(f, "virtual      %u.%03u s, %llu main loop passes\n", _now / 1000, _now % 1000,
+			static_cast<unsigned long long>(_passes));
+	fprintf(f, "wall         %.3f s, %.0f samples/s\n", _wall, _wall > 0 ? total / _wall : 0.0);
+
+	if ( !_latency.empty() ) {
+		std::vector<uint32_t>
+		l(_latency);
+		std::sort(l.begin(), l.end());
+		double
+		sum		= 0;
+		for (uint32_t v : l)	sum += v;
+		auto
+		pct		= [&l](double p) { return l[static_cast<size_t>(p * (l.size() - 1))] / 1000.0; };
+		fprintf(f, "latency us   min %.2f p50 %.2f p99 %.2f max %.2f mean %.2f\n",
+				pct(0), pct(0.5), pct(0.99), pct(1), sum / l.size() / 1000.0);
+	}
+	fprintf(f, "output       %llu bytes, fnv1a %016llx\n", static_cast<unsigned long long>(_bytes),
+			static_cast<unsigned long long>(_hash));
+}
+
+}	// namespace replay
+// ----------------------------------------------------------------------------
+
+static void
+usage(const char* name) {
+	fprintf(stderr, "usage: %s [-r repeat] [-s script] [-o output] <capture>\n", name);
+	exit(2);
+}
+
+int
+main(int argc, char** argv) {
+	replay::Engine&
+	engine	= replay::engine();
+	FILE*
+	out		= nullptr;
+
+	int	opt;
+	while ( (opt = getopt(argc, argv, "r:s:o:")) != -1 ) {
+		switch ( opt ) {
+		case 'r':
+			engine.setRepeat(strtoul(optarg, nullptr, 10));
+			break;
+		case 's':
+			if ( !engine.script(optarg) ) {
+				fprintf(stderr, "%s: cannot read script\n", optarg);
+				return 1;
+			}
+			break;
+		case 'o':
+			out		= ( strcmp(optarg, "-") == 0 ) ? stdout : fopen(optarg, "wb");
+			if ( out == nullptr ) {
+				perror(optarg);
+				return 1;
+			}
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+	if ( optind + 1 != argc )	usage(argv[0]);
+
+	if ( !engine.load(argv[optind]) ) {
+		fprintf(stderr, "%s: cannot open\n", argv[optind]);
+		return 1;
+	}
+	bool
+	any		= false;
+	for (uint8_t s = 0; s < replay::SENSORS; ++s)
+		any		|= engine.present(replay::Sensor(s));
+	if ( !any ) {
+		fprintf(stderr, "%s: no sensor samples\n", argv[optind]);
+		return 1;
+	}
+
+	engine.setOutput(out);
+	engine.run(firmwareMain);
+	if ( out && out != stdout )	fclose(out);
+	engine.report(stderr);
+	return 0;
+}
@@ -0,0 +1,62 @@
+// ----------------------------------------------------------------------------
+// taskbench: the sensor task as a coroutine (task.hpp)
+// ----------------------------------------------------------------------------
+
+#include "workload.hpp"
+
+#include <task.hpp>
+// ----------------------------------------------------------------------------
+
+namespace bench {
+namespace {
+
+Task
+sensor(const Workload& w, Result& r, Cmd& ctl) {
+	Driver
+	driver(w, r);
+	Timeout
+	timeout;
+	uint8_t
+	setting	= 0;
+
+	// ping the device until it responds
+	do {
+		co_await task::sleep(timeout, 150);
+	} while ( !co_await task::call([&] { return driver.ping(); }) );
+
+	while ( !co_await task::call([&] { return driver.initialize(); }) )
+		co_await task::sleep(timeout, 100);
+
+	while (true) {
+		while ( !co_await task::call([&] { return driver.configure(setting); }) )
+			co_await task::sleep(timeout, 100);
+
+		while ( ctl != Cmd::Command ) {
+			if ( co_await task::call([&] { return driver.read(); }) ) {
+				++r.samples;
+				r.sum	+= driver.value;
+			}
+			co_await task::sleep(timeout, w.period);
+		}
+
+		++setting;
+		ctl = Cmd::None;
+		co_await task::yield();			// configure with the next pass, as PT_CASE_SET()
+	}
+}
+
+}	// namespace
+
+Result
+runCoroutines(const Workload& w) {
+	Result
+	r;
+	Cmd				ctl[Workload::TASKS]	= {};
+	Task			tasks[Workload::TASKS];
+	for (uint8_t i = 0; i < Workload::TASKS; ++i)
+		tasks[i]	= sensor(w, r, ctl[i]);
+	run(w, ctl, [&](uint8_t i) { tasks[i].update(); });
+	return r;
+}
+
+}	// namespace bench
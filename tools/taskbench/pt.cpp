@@ -0,0 +1,103 @@
+// ----------------------------------------------------------------------------
+// taskbench: the sensor task as a protothread, written as in main.cpp
+// ----------------------------------------------------------------------------
+
+#include "workload.hpp"
+// ----------------------------------------------------------------------------
+
+// as in main.cpp
+#define PT_CASE(x)					\
+	this->x			= __LINE__;		\
+	this->ptState	= __LINE__;		\
+	modm_fallthrough;				\
+	case __LINE__:					\
+
+#define PT_CASE_SET(x) ({			\
+	this->ptState	= x;			\
+	return true;					\
+})
+// ----------------------------------------------------------------------------
+
+namespace bench {
+namespace {
+
+class SensorThread : public modm::pt::Protothread
+{
+public:
+	SensorThread(const Workload& w, Result& r) : _w(w), _r(r), driver(w, r)
+	{
+	}
+
+	bool
+	update(Cmd& ctl) {
+		PT_BEGIN();
+
+		// ping the device until it responds
+		while (true) {
+			this->timeout.restart(150);
+			PT_WAIT_UNTIL(this->timeout.isExpired());
+
+			if (PT_CALL(driver.ping())) {
+				break;
+			}
+		}
+
+		while (true) {
+			if (PT_CALL(driver.initialize())) {
+				break;
+			}
+			this->timeout.restart(100);
+			PT_WAIT_UNTIL(this->timeout.isExpired());
+		}
+
+		PT_CASE(PT_CONFIG);
+		while (true) {
+			if (PT_CALL(driver.configure(setting))) {
+				break;
+			}
+			this->timeout.restart(100);
+			PT_WAIT_UNTIL(this->timeout.isExpired());
+		}
+
+		while (true) {
+			if (ctl == Cmd::Command) {
+				break;
+			}
+			if (PT_CALL(driver.read())) {
+				++_r.samples;
+				_r.sum	+= driver.value;
+			}
+			this->timeout.restart(_w.period);
+			PT_WAIT_UNTIL(this->timeout.isExpired());
+		}
+
+		++setting;
+		ctl = Cmd::None;
+		PT_CASE_SET(PT_CONFIG);
+
+		PT_END();
+	}
+
+private:
+	const Workload&	_w;
+	Result&			_r;
+	Driver			driver;
+	Timeout			timeout;
+	uint8_t			setting		= 0;
+	uint16_t		PT_CONFIG;
+};
+
+}	// namespace
+
+Result
+runProtothreads(const Workload& w) {
+	Result
+	r;
+	SensorThread	one(w, r), two(w, r), three(w, r);
+	SensorThread*	threads[Workload::TASKS]	= { &one, &two, &three };
+	Cmd				ctl[Workload::TASKS]		= {};
+	run(w, ctl, [&](uint8_t i) { threads[i]->update(ctl[i]); });
+	return r;
+}
+
+}	// namespace bench
@@ -0,0 +1,95 @@
+// ----------------------------------------------------------------------------
+// Protothread vs coroutine (task.hpp) sensor tasks: resume cost
+//
+// Usage: taskbench [-n passes] [-p period_ms] [-b busy_polls] [-c command_every]
+//
+// Runs the same three sensor tasks (workload.hpp) once as protothreads with
+// the PT_* macros of main.cpp and once as coroutines, checks that both read
+// the same samples and prints the time per task update (best of 5 runs).
+// The two kinds are in their own translation units, so their code size is
+// that of the object files:
+//
+//	size CMakeFiles/taskbench.dir/taskbench/pt.cpp.o CMakeFiles/taskbench.dir/taskbench/coro.cpp.o
+// ----------------------------------------------------------------------------
+
+#include "workload.hpp"
+
+#include <task.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+// ----------------------------------------------------------------------------
+
+using namespace bench;
+
+static void
+usage(const char* name) {
+	fprintf(stderr, "usage: %s [-n passes] [-p period_ms] [-b busy_polls] [-c command_every]\n", name);
+	exit(1);
+}
+
+/// @return ns per task update, best of `runs`
+static double
+measure(Result (*fn)(const Workload&), const Workload& w, Result& r, int runs = 5) {
+	double
+	best	= 0;
+	for (int i = 0; i < runs; ++i) {
+		const auto
+		start	= std::chrono::steady_clock::now();
+		r		= fn(w);
+		const double
+		ns		= std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+		if ( i == 0 || ns < best )	best = ns;
+	}
+	return best / ( static_cast<double>(w.passes) * static_cast<double>(Workload::TASKS) );
+}
+
+static void
+print(const char* name, double ns, const Result& r) {
+	printf("%-12s %7.2f ns/update  samples %u  configs %u  transactions %u\n",
+		   name, ns, r.samples, r.configs, r.transactions);
+}
+
+int
+main(int argc, char** argv) {
+	Workload
+	w;
+	int
+	opt;
+	while ( (opt = getopt(argc, argv, "n:p:b:c:")) != -1 ) {
+		switch (opt) {
+		case 'n':	w.passes	= strtoul(optarg, nullptr, 0);	break;
+		case 'p':	w.period	= strtoul(optarg, nullptr, 0);	break;
+		case 'b':	w.busy		= strtoul(optarg, nullptr, 0);	break;
+		case 'c':	w.commands	= strtoul(optarg, nullptr, 0);	break;
+		default:	usage(argv[0]);
+		}
+	}
+	if ( optind != argc || w.passes == 0 )	usage(argv[0]);
+
+	printf("%u passes x %d tasks, period %u ms, %u polls per transaction, command every %u passes\n",
+		   w.passes, Workload::TASKS, w.period, w.busy, w.commands);
+
+	Result
+	pt, co;
+	const double
+	ptNs	= measure(runProtothreads, w, pt),
+	coNs	= measure(runCoroutines, w, co);
+	print("protothread", ptNs, pt);
+	print("coroutine", coNs, co);
+	printf("coroutine frame %zu bytes (TASK_FRAME_SIZE %d, %u failed)\n",
+		   TaskArena::largest(), TASK_FRAME_SIZE, TaskArena::failed());
+
+	if ( TaskArena::failed() ) {
+		fprintf(stderr, "no coroutine frame, raise TASK_FRAME_SIZE\n");
+		return 1;
+	}
+	if ( pt.samples != co.samples || pt.sum != co.sum || pt.configs != co.configs ) {
+		fprintf(stderr, "protothreads and coroutines disagree\n");
+		return 1;
+	}
+	return 0;
+}
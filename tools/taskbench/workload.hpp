@@ -0,0 +1,137 @@
+// ----------------------------------------------------------------------------
+// Sensor task workload of taskbench, the same for both task kinds
+//
+// A simulated driver whose resumable functions take `busy` polls per I2C
+// transaction (as a modm driver waiting for the I2C master), a 1 ms per
+// pass clock with a timeout of the modm interface, and a main loop that
+// updates `Workload::TASKS` tasks per pass and hands them a CLI command now
+// and then. The task body mirrors ThreadThree of main.cpp: ping until the
+// sensor answers, initialize, configure, read every `period` ms, and
+// configure again on a command.
+// ----------------------------------------------------------------------------
+
+#ifndef TASKBENCH_WORKLOAD_HPP
+#define TASKBENCH_WORKLOAD_HPP
+
+#include <stdint.h>
+
+#include <modm/processing.hpp>
+// ----------------------------------------------------------------------------
+
+namespace bench {
+
+enum class Cmd : uint8_t {
+	None,
+	Command
+};
+
+struct Workload {
+	enum { TASKS = 3 };
+
+	uint32_t		passes		= 1000000;
+	uint16_t		period		= 20;		// ms between reads
+	uint8_t			busy		= 2;		// polls per transaction
+	uint8_t			pings		= 2;		// unanswered pings before the sensor answers
+	uint32_t		commands	= 5000;		// passes between CLI commands
+};
+
+struct Result {
+	uint32_t		samples		= 0;
+	uint32_t		sum			= 0;		// of the values read, both kinds must agree
+	uint32_t		configs		= 0;
+	uint32_t		transactions	= 0;
+};
+
+/// virtual ms, one per main loop pass
+inline uint32_t		now		= 0;
+
+class Timeout {
+public:
+	void
+	restart(uint32_t ms)		{
+		_deadline	= now + ms;
+		_armed		= true;
+	}
+
+	bool
+	isExpired() const			{ return _armed && now >= _deadline; }
+
+private:
+	uint32_t		_deadline	= 0;
+	bool			_armed		= false;
+};
+
+class Driver {
+public:
+	Driver(const Workload& w, Result& r): _w(w), _r(r)	{}
+
+	modm::ResumableResult<bool>
+	ping() {
+		if ( !transfer() )	return {modm::rf::Running, false};
+		return {modm::rf::Stop, ++_pinged > _w.pings};
+	}
+
+	modm::ResumableResult<bool>
+	initialize()				{ return done(); }
+
+	modm::ResumableResult<bool>
+	configure(uint8_t setting) {
+		if ( !transfer() )	return {modm::rf::Running, false};
+		this->setting	= setting;
+		++_r.configs;
+		return {modm::rf::Stop, true};
+	}
+
+	modm::ResumableResult<bool>
+	read() {
+		if ( !transfer() )	return {modm::rf::Running, false};
+		value	= static_cast<uint16_t>( now * 7 + setting );
+		return {modm::rf::Stop, true};
+	}
+
+	uint8_t			setting		= 0;
+	uint16_t		value		= 0;
+
+private:
+	modm::ResumableResult<bool>
+	done()						{ return {transfer() ? modm::rf::Stop : modm::rf::Running, true}; }
+
+	/// @return true once the transaction is complete
+	bool
+	transfer() {
+		if ( _polls == 0 )	_polls = _w.busy + 1;
+		if ( --_polls )		return false;
+		++_r.transactions;
+		return true;
+	}
+
+	const Workload&	_w;
+	Result&			_r;
+	uint8_t			_polls		= 0;
+	uint8_t			_pinged		= 0;
+};
+
+/// @brief main loop: update(i) of every task once per pass, commands go
+/// to the tasks through ctl[i] as from the CLI queue of main.cpp
+template < typename Update >
+void
+run(const Workload& w, Cmd (&ctl)[Workload::TASKS], Update&& update) {
+	now		= 0;
+	for (uint32_t pass = 0; pass < w.passes; ++pass, ++now) {
+		if ( w.commands && pass % w.commands == w.commands - 1 )
+			ctl[pass / w.commands % Workload::TASKS]	= Cmd::Command;
+		for (uint8_t i = 0; i < Workload::TASKS; ++i)
+			update(i);
+	}
+}
+
+Result
+runProtothreads(const Workload& w);
+
+Result
+runCoroutines(const Workload& w);
+
+}	// namespace bench
+// ----------------------------------------------------------------------------
+
+#endif	// TASKBENCH_WORKLOAD_HPP
@@ -0,0 +1,165 @@
+// ----------------------------------------------------------------------------
+// Host decoder of the firmware 'trace dump' output (see trace.hpp)
+//
+// Usage: tracedecode <capture> [<capture> ...]
+//
+// Scans a raw serial capture for "TRACE v1" blocks and prints one line per
+// event: seconds since the first event of the block, event name and its
+// arguments; an i2c-done also shows how long the transaction took. The
+// 32-bit timestamps are unwrapped on the assumption that consecutive
+// events are less than a wrap apart (48 min at 96 MHz). Block statistics
+// (events, dropped, CRC result) go to stderr.
+// ----------------------------------------------------------------------------
+
+#include <trace.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+// ----------------------------------------------------------------------------
+
+static const char	header[]	= "TRACE v1 ";
+
+// main loop sections of the overrun events, as loopNames in main.cpp
+static const char* const	sections[]	= { "cli", "tcs", "v6040", "v6070", "other" };
+static const unsigned int	LOOP		= sizeof(sections) / sizeof(sections[0]);
+
+// Cli::Cmd
+static const char* const	cmds[]		= { "none", "control", "command", "error" };
+
+template < size_t N >
+static const char*
+name(const char* const (&names)[N], unsigned int i) {
+	return ( i < N ) ? names[i] : "?";
+}
+
+static void
+print(const trace::Event& e, double s, double startedAt) {
+	printf("%12.6f %-12s ", s, name(trace::names, e.id));
+	switch (e.id) {
+	case trace::I2cStart:
+		printf("%s %s", name(trace::sensors, e.a), name(trace::ops, e.b & 0xFF));
+		break;
+	case trace::I2cDone:
+		printf("%s %s %s", name(trace::sensors, e.a), name(trace::ops, e.b & 0xFF), ( e.b >> 8 ) ? "ok" : "failed");
+		if ( startedAt >= 0 )	printf(" %.0f us", ( s - startedAt ) * 1e6);
+		break;
+	case trace::Stop:
+	case trace::Restart:
+	case trace::Reconfigure:
+		printf("%s", name(trace::sensors, e.a));
+		break;
+	case trace::CliQueued:
+		printf("%s seq %u pending 0x%02x", name(cmds, e.a), e.b & 0xFF, e.b >> 8);
+		break;
+	case trace::CliDone:
+		printf("subscriber %u seq %u", e.a, e.b);
+		break;
+	case trace::CliRejected:
+		printf("length %u", e.b);
+		break;
+	case trace::Overrun:
+		if ( ( e.a >> 4 ) == LOOP )
+			printf("pass %u us culprit %s", e.b, name(sections, e.a & 0x0F));
+		else
+			printf("%s woke %u ms late culprit %s", name(sections, e.a >> 4), e.b, name(sections, e.a & 0x0F));
+		break;
+	default:
+		printf("a %u b %u", e.a, e.b);
+		break;
+	}
+	printf("\n");
+}
+
+/// @return position after the decoded block, or `pos + 1` if it is not valid
+static size_t
+decodeBlock(const std::vector<uint8_t>& buf, size_t pos) {
+	const void*
+	nl		= memchr(buf.data() + pos, '\n', buf.size() - pos);
+	if ( nl == nullptr )	return pos + 1;
+	const size_t
+	eol		= static_cast<const uint8_t*>(nl) - (buf.data() + pos);
+
+	const std::string
+	line(buf.begin() + pos, buf.begin() + pos + eol);
+	unsigned int	n, hz, dropped;
+	if ( sscanf(line.c_str(), "TRACE v1 n=%u hz=%u dropped=%u", &n, &hz, &dropped) != 3 || hz == 0 ) {
+		fprintf(stderr, "skipping malformed header: %s\n", line.c_str());
+		return pos + 1;
+	}
+
+	uint16_t		crc		= 0xFFFF;
+	size_t			p		= pos + eol + 1;
+	unsigned int	events	= 0;
+	uint64_t		time	= 0;				// unwrapped
+	uint32_t		last	= 0;
+	uint64_t		first	= 0;
+	double			started[trace::SENSORS]	= { -1, -1, -1 };
+
+	for (; events < n && p + 8 <= buf.size(); ++events, p += 8) {
+		const uint8_t*
+		b		= buf.data() + p;
+		for (int i = 0; i < 8; ++i)	crc = codec::crc16(crc, b[i]);
+
+		trace::Event
+		e;
+		e.time	= b[0] | (b[1] << 8) | (b[2] << 16) | (static_cast<uint32_t>(b[3]) << 24);
+		e.id	= static_cast<trace::Id>(b[4]);
+		e.a		= b[5];
+		e.b		= static_cast<uint16_t>(b[6] | (b[7] << 8));
+
+		if ( events == 0 )	time = first = e.time;
+		else				time += static_cast<uint32_t>(e.time - last);
+		last	= e.time;
+
+		const double
+		s		= static_cast<double>(time - first) / hz;
+		const bool
+		sensor	= ( e.a < trace::SENSORS );
+		print(e, s, ( e.id == trace::I2cDone && sensor ) ? started[e.a] : -1);
+		if ( e.id == trace::I2cStart && sensor )	started[e.a] = s;
+		if ( e.id == trace::I2cDone && sensor )		started[e.a] = -1;
+	}
+
+	unsigned int	expected	= 0;
+	const bool
+	trailer	= ( sscanf(std::string(buf.begin() + p, buf.begin() + std::min(buf.size(), p + 16)).c_str(),
+					"\nEND %x", &expected) == 1 );
+
+	fprintf(stderr, "trace: %u/%u events, %u Hz, dropped %u, crc %s\n", events, n, hz, dropped,
+			!trailer ? "missing" : ( expected == crc ) ? "ok" : "MISMATCH");
+	return p;
+}
+
+int
+main(int argc, char** argv) {
+	if ( argc < 2 ) {
+		fprintf(stderr, "usage: %s <capture> [<capture> ...]\n", argv[0]);
+		return 2;
+	}
+
+	for (int f = 1; f < argc; ++f) {
+		std::ifstream
+		in(argv[f], std::ios::binary);
+		if ( !in ) {
+			fprintf(stderr, "%s: cannot open\n", argv[f]);
+			return 1;
+		}
+		const std::vector<uint8_t>
+		buf((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+		size_t
+		pos		= 0;
+		while ( pos + sizeof(header) - 1 <= buf.size() ) {
+			const void*
+			hit		= memmem(buf.data() + pos, buf.size() - pos, header, sizeof(header) - 1);
+			if ( hit == nullptr )	break;
+			pos		= decodeBlock(buf, static_cast<const uint8_t*>(hit) - buf.data());
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,233 @@
+// ----------------------------------------------------------------------------
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <stdint.h>
+
+#include <codec.hpp>
+#include <history.hpp>
+#include <timing.hpp>
+// ----------------------------------------------------------------------------
+
+// Trace points (TRACE(id, a, b)) are compiled in by default, -DTRACE_ENABLED=0
+// removes them together with the evaluation of their arguments.
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED	1
+#endif
+
+// events kept, power of 2, 8 bytes each
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS	256
+#endif
+
+// timestamp = tick counter >> TRACE_SHIFT: 0.67 us and 48 min until it wraps
+// at 96 MHz
+#ifndef TRACE_SHIFT
+#define TRACE_SHIFT		6
+#endif
+// ----------------------------------------------------------------------------
+
+/// @brief Binary event trace
+///
+/// A ring of the last TRACE_EVENTS events, 8 bytes each: timestamp, event
+/// id and two arguments. Recording one is a tick counter read and three
+/// stores, cheap enough to leave the trace points in production builds.
+/// Trace points are for the main loop context only (sensor threads, CLI),
+/// not for interrupt handlers.
+///
+/// 'trace dump' sends the ring as
+///		"TRACE v1 n=<events> hz=<timestamp ticks per s> dropped=<n>\n"
+///		n x { time (4 bytes), id, a, b (2 bytes) }, little endian
+///		"\nEND <crc16 of the binary part, hex>\n"
+/// oldest event first; tools/tracedecode turns it into text. Shared with
+/// the host tools like codec.hpp.
+namespace trace {
+
+enum Id : uint8_t {
+	None,
+	I2cStart,								// a = sensor, b = Op
+	I2cDone,								// a = sensor, b = Op | ok << 8
+	Stop,									// a = sensor (Ctrl+C)
+	Restart,								// a = sensor
+	Reconfigure,							// a = sensor
+	CliQueued,								// a = Cli::Cmd, b = seq & 0xff | pending << 8
+	CliDone,								// a = subscriber, b = seq
+	CliRejected,							// a = 0, b = line length
+	Overrun,								// a = task << 4 | culprit (LoopMonitor), b = us | ms
+	IDS
+};
+
+inline const char* const	names[IDS]	= {
+	"none", "i2c-start", "i2c-done", "stop", "restart", "reconfigure",
+	"cli-queued", "cli-done", "cli-rejected", "overrun"
+};
+
+enum Sensor : uint8_t {
+	Tcs,
+	V6040,
+	V6070,
+	SENSORS
+};
+
+inline const char* const	sensors[SENSORS]	= { "tcs", "v6040", "v6070" };
+
+/// I2C transaction of a sensor driver
+enum Op : uint8_t {
+	Ping,
+	Initialize,
+	Configure,
+	Read,
+	Ara,									// VEML6070 alert response
+	Wake,									// power-up of a gated sensor
+	Sleep,									// and shutdown
+	OPS
+};
+
+inline const char* const	ops[OPS]	= { "ping", "initialize", "configure", "read", "ara", "wake", "sleep" };
+
+struct Event {
+	uint32_t		time;					// timing::ticks() >> TRACE_SHIFT
+	Id				id;
+	uint8_t			a;
+	uint16_t		b;
+};
+static_assert(sizeof(Event) == 8, "trace events are 8 bytes");
+
+/// @brief ring of the last `Capacity` events; while locked (dumped) new
+/// events are dropped and counted
+template < uint16_t Capacity >
+class Ring {
+	static_assert(Capacity && !(Capacity & (Capacity - 1)), "Capacity must be a power of 2");
+
+public:
+	void
+	record(Id id, uint8_t a, uint16_t b) {
+		if ( _locked ) {
+			++_dropped;
+			return;
+		}
+		Event&
+		e		= _ring[_head++ & (Capacity - 1)];
+		e.time	= timing::ticks() >> TRACE_SHIFT;
+		e.id	= id;
+		e.a		= a;
+		e.b		= b;
+	}
+
+	/// events recorded since clear()
+	uint32_t
+	recorded() const			{ return _head; }
+
+	uint16_t
+	size() const				{ return ( _head < Capacity ) ? _head : Capacity; }
+
+	static constexpr uint16_t
+	capacity()					{ return Capacity; }
+
+	/// @param i 0 = oldest
+	const Event&
+	at(uint16_t i) const		{ return _ring[( _head - size() + i ) & (Capacity - 1)]; }
+
+	void
+	clear() {
+		_head		= 0;
+		_dropped	= 0;
+	}
+
+	void
+	lock(bool locked)			{ _locked = locked; }
+
+	uint32_t
+	dropped() const				{ return _dropped; }
+
+	/// timestamp ticks per second
+	static uint32_t
+	hz()						{ return ( timing::ticksPerUs * 1000000u ) >> TRACE_SHIFT; }
+
+private:
+	Event			_ring[Capacity];
+	uint32_t		_head		= 0;
+	uint32_t		_dropped	= 0;
+	bool			_locked		= false;
+};
+
+inline Ring<TRACE_ENABLED ? TRACE_EVENTS : 1>	ring;
+
+/// @brief trace the end of an I2C transaction and pass its result on:
+///		if ( trace::i2c(trace::Tcs, trace::Read, PT_CALL(colorSensor.read())) )
+inline bool
+i2c(Sensor sensor, Op op, bool ok) {
+#if TRACE_ENABLED
+	ring.record(I2cDone, sensor, op | ( ok ? 0x100 : 0 ));
+#else
+	(void) sensor;
+	(void) op;
+#endif
+	return ok;
+}
+// ----------------------------------------------------------------------------
+
+/// @brief Incremental 'trace dump', BLOCK events per step() as the history
+/// dumps, the ring is locked meanwhile
+template < typename R, typename Out >
+class Dump: public HistoryDumpBase {
+public:
+	enum { BLOCK = 16 };
+
+	Dump(R& ring, Out& out):
+		_ring(ring),
+		_out(out)				{
+	}
+
+	void
+	start() override			{
+		_ring.lock(true);
+		_next	= 0;
+		_crc	= 0xFFFF;
+		_out.printf("TRACE v1 n=%u hz=%u dropped=%u\n", static_cast<unsigned int>(_ring.size()),
+				static_cast<unsigned int>(R::hz()), static_cast<unsigned int>(_ring.dropped()));
+	}
+
+	bool
+	step() override				{
+		if ( _next < _ring.size() ) {
+			for (uint8_t i = 0; i < BLOCK && _next < _ring.size(); ++i, ++_next) {
+				const Event&
+				e		= _ring.at(_next);
+				const uint8_t
+				bytes[8]	= {
+					static_cast<uint8_t>(e.time), static_cast<uint8_t>(e.time >> 8),
+					static_cast<uint8_t>(e.time >> 16), static_cast<uint8_t>(e.time >> 24),
+					e.id, e.a, static_cast<uint8_t>(e.b), static_cast<uint8_t>(e.b >> 8)
+				};
+				for (uint8_t b : bytes) {
+					_crc	= codec::crc16(_crc, b);
+					_out.write(static_cast<char>(b));
+				}
+			}
+			return true;
+		}
+		_out.printf("\nEND %04x\n", static_cast<unsigned int>(_crc));
+		_ring.lock(false);
+		return false;
+	}
+
+private:
+	R&				_ring;
+	Out&			_out;
+	uint16_t		_next		= 0;
+	uint16_t		_crc		= 0xFFFF;
+};
+
+}	// namespace trace
+// ----------------------------------------------------------------------------
+
+#if TRACE_ENABLED
+#define TRACE(id, a, b)		trace::ring.record(trace::id, (a), (b))
+#else
+#define TRACE(id, a, b)		((void) 0)
+#endif
+// ----------------------------------------------------------------------------
+
+#endif	// TRACE_HPP
@@ -0,0 +1,323 @@
+// ----------------------------------------------------------------------------
+
+#ifndef UNMIXING_HPP
+#define UNMIXING_HPP
+
+#include <math.h>
+#include <fixed.hpp>
+// ----------------------------------------------------------------------------
+
+/// @brief Multi-wavelength unmixing of several analytes
+///
+/// Feature vector: absorbances of UV (VEML6070) and R, G, B, clear
+/// (TCS3472 or VEML6040) against their blanks. With the absorptivity
+/// matrix E (channels x analytes) the model is A = E * c.
+///
+/// At calibration time the least-squares inverse P = (Es^T Es)^-1 Es^T is
+/// computed for every non-empty subset s of analytes and stored as Q16.16.
+/// Per sample the full solution is one 3x5 matrix-vector product; only if
+/// it has a negative concentration are the subsets tried, and the feasible
+/// one with the least residual is taken (exact NNLS for this size).
+class Unmixing {
+public:
+	enum {
+		CHANNELS		= 5,
+		MAX_ANALYTES	= 3,
+		SUBSETS			= (1 << MAX_ANALYTES) - 1
+	};
+
+	enum Channel: uint8_t {
+		UV, RED, GREEN, BLUE, CLEAR
+	};
+
+	enum class Source: uint8_t {
+		Tcs,
+		V6040
+	};
+
+public:
+
+	Unmixing():
+		_analytes(1),
+		_fresh(0),
+		_columns(0),
+		_solved(false),
+		source(Source::Tcs),
+		enabled(false)			{
+		for (uint8_t i = 0; i < CHANNELS; ++i) {
+			_counts[i]	= 0;
+			_blank[i]	= 0;
+			for (uint8_t j = 0; j < MAX_ANALYTES; ++j)	_e[i][j] = 0;
+		}
+	}
+
+	// ---- acquisition --------------------------------------------------------
+
+	void
+	setUv(uint16_t uv)			{
+		_counts[UV]	= uv;
+		_fresh		|= (1 << UV);
+	}
+
+	void
+	setRgbc(uint16_t r, uint16_t g, uint16_t b, uint16_t c) {
+		_counts[RED]	= r;
+		_counts[GREEN]	= g;
+		_counts[BLUE]	= b;
+		_counts[CLEAR]	= c;
+		_fresh			|= (1 << RED) | (1 << GREEN) | (1 << BLUE) | (1 << CLEAR);
+	}
+
+	/// @brief true once per complete (UV + RGBC) feature vector
+	bool
+	ready()						{
+		if ( _fresh != (1 << CHANNELS) - 1 )	return false;
+		_fresh	= 0;
+		return true;
+	}
+
+	const uint16_t*
+	counts() const				{ return _counts; }
+
+	// ---- calibration --------------------------------------------------------
+
+	bool
+	setAnalytes(uint8_t n)		{
+		if ( n == 0 || n > MAX_ANALYTES )	return false;
+		_analytes	= n;
+		_columns	&= (1 << n) - 1;
+		_solved		= false;
+		return true;
+	}
+
+	uint8_t
+	analytes() const			{ return _analytes; }
+
+	/// @brief current counts become the per-channel blank; the solution
+	/// depends on the absorptivities only and stays
+	void
+	captureBlank()				{
+		for (uint8_t i = 0; i < CHANNELS; ++i)
+			_blank[i]	= _counts[i] ? _counts[i] : 1;
+	}
+
+	/// @brief blank of one channel, taken by its sensor for the setting it
+	/// runs with ('--zero blank'); the absorptivities stay valid
+	void
+	setBlank(Channel i, uint16_t counts) { _blank[i] = counts ? counts : 1; }
+
+	/// @brief the sensor of a channel runs with another setting now, its
+	/// blank does not apply any more
+	void
+	clearBlank(Channel i)		{ _blank[i] = 0; }
+
+	/// @brief every channel has its I0
+	bool
+	hasBlank() const			{
+		for (uint8_t i = 0; i < CHANNELS; ++i)
+			if ( _blank[i] == 0 )	return false;
+		return true;
+	}
+
+	/// @brief current counts are a standard of analyte j at concentration c
+	bool
+	captureStandard(uint8_t j, fixed::q16 c) {
+		if ( j >= _analytes || c <= 0 || !hasBlank() )	return false;
+		fixed::q16	a[CHANNELS];
+		absorbance(a);
+		for (uint8_t i = 0; i < CHANNELS; ++i)
+			_e[i][j]	= fixed::div(a[i], c);
+		_columns	|= (1 << j);
+		_solved		= false;
+		return true;
+	}
+
+	/// @brief absorptivities of analyte j entered directly (e.g. from a lab run)
+	bool
+	setColumn(uint8_t j, const fixed::q16 (&e)[CHANNELS]) {
+		if ( j >= _analytes )	return false;
+		for (uint8_t i = 0; i < CHANNELS; ++i)
+			_e[i][j]	= e[i];
+		_columns	|= (1 << j);
+		_solved		= false;
+		return true;
+	}
+
+	bool
+	isCalibrated() const		{ return _columns == (1 << _analytes) - 1; }
+
+	bool
+	isSolved() const			{ return _solved; }
+
+	/// @brief precompute the inverses of all analyte subsets (once per calibration)
+	/// @return false if the full matrix is singular
+	bool
+	solve() {
+		_solved	= false;
+		if ( !isCalibrated() )	return false;
+
+		for (uint8_t s = 1; s <= SUBSETS; ++s) {
+			_valid[s - 1]	= ( s < (1 << _analytes) ) && pseudoInverse(s, _p[s - 1]);
+		}
+		_solved	= _valid[(1 << _analytes) - 2];
+		return _solved;
+	}
+
+	// ---- per sample ---------------------------------------------------------
+
+	void
+	absorbance(fixed::q16 (&a)[CHANNELS]) const {
+		for (uint8_t i = 0; i < CHANNELS; ++i)
+			a[i]	= fixed::log10(_blank[i]) - fixed::log10(_counts[i]);
+	}
+
+	/// @brief concentrations of all analytes, all >= 0; 0 without a blank
+	void
+	unmix(fixed::q16 (&c)[MAX_ANALYTES]) const {
+		if ( !_solved || !hasBlank() ) {
+			for (uint8_t j = 0; j < MAX_ANALYTES; ++j)	c[j] = 0;
+			return;
+		}
+
+		fixed::q16	a[CHANNELS];
+		absorbance(a);
+
+		const uint8_t
+		full	= (1 << _analytes) - 1;
+
+		apply(full, a, c);
+		if ( nonNegative(c) )	return;
+
+		int64_t		best	= INT64_MAX;
+		fixed::q16	t[MAX_ANALYTES];
+		for (uint8_t s = 1; s < full; ++s) {
+			if ( !_valid[s - 1] )	continue;
+			apply(s, a, t);
+			if ( !nonNegative(t) )	continue;
+			const int64_t
+			r	= residual(a, t);
+			if ( r < best ) {
+				best	= r;
+				for (uint8_t j = 0; j < MAX_ANALYTES; ++j)	c[j] = t[j];
+			}
+		}
+		if ( best == INT64_MAX ) {					// only c = 0 is feasible
+			for (uint8_t j = 0; j < MAX_ANALYTES; ++j)	c[j] = 0;
+		}
+	}
+
+private:
+	/// c = P_s * a, analytes outside of s are zero
+	void
+	apply(uint8_t s, const fixed::q16 (&a)[CHANNELS], fixed::q16 (&c)[MAX_ANALYTES]) const {
+		const fixed::q16
+		(&p)[MAX_ANALYTES][CHANNELS]	= _p[s - 1];
+		for (uint8_t j = 0; j < MAX_ANALYTES; ++j) {
+			int64_t
+			acc		= 0;
+			if ( s & (1 << j) ) {
+				for (uint8_t i = 0; i < CHANNELS; ++i)
+					acc	+= static_cast<int64_t>(p[j][i]) * a[i];
+			}
+			c[j]	= static_cast<fixed::q16>(acc >> 16);
+		}
+	}
+
+	bool
+	nonNegative(const fixed::q16 (&c)[MAX_ANALYTES]) const {
+		for (uint8_t j = 0; j < _analytes; ++j)
+			if ( c[j] < 0 )	return false;
+		return true;
+	}
+
+	/// |a - E*c|^2 (Q32.32, only compared)
+	int64_t
+	residual(const fixed::q16 (&a)[CHANNELS], const fixed::q16 (&c)[MAX_ANALYTES]) const {
+		int64_t
+		sum		= 0;
+		for (uint8_t i = 0; i < CHANNELS; ++i) {
+			int64_t
+			r		= a[i];
+			for (uint8_t j = 0; j < _analytes; ++j)
+				r	-= fixed::mul(_e[i][j], c[j]);
+			sum		+= r * r;
+		}
+		return sum;
+	}
+
+	/// (Es^T Es)^-1 Es^T by Gauss-Jordan; calibration only, so float is fine
+	bool
+	pseudoInverse(uint8_t s, fixed::q16 (&p)[MAX_ANALYTES][CHANNELS]) const {
+		uint8_t		col[MAX_ANALYTES];
+		uint8_t		k	= 0;
+		for (uint8_t j = 0; j < _analytes; ++j)
+			if ( s & (1 << j) )	col[k++] = j;
+
+		// augmented [Es^T Es | Es^T]
+		float		m[MAX_ANALYTES][MAX_ANALYTES + CHANNELS];
+		for (uint8_t r = 0; r < k; ++r) {
+			for (uint8_t c = 0; c < k; ++c) {
+				float	sum	= 0;
+				for (uint8_t i = 0; i < CHANNELS; ++i)
+					sum	+= float(_e[i][col[r]]) * float(_e[i][col[c]]);
+				m[r][c]	= sum / (float(fixed::ONE) * float(fixed::ONE));
+			}
+			for (uint8_t i = 0; i < CHANNELS; ++i)
+				m[r][k + i]	= float(_e[i][col[r]]) / float(fixed::ONE);
+		}
+
+		for (uint8_t c = 0; c < k; ++c) {
+			uint8_t
+			piv		= c;
+			for (uint8_t r = c + 1; r < k; ++r)
+				if ( fabsf(m[r][c]) > fabsf(m[piv][c]) )	piv = r;
+			if ( fabsf(m[piv][c]) < 1e-9f )	return false;
+			if ( piv != c ) {
+				for (uint8_t x = 0; x < k + CHANNELS; ++x) {
+					float	t	= m[c][x];
+					m[c][x]		= m[piv][x];
+					m[piv][x]	= t;
+				}
+			}
+			const float
+			d		= m[c][c];
+			for (uint8_t x = 0; x < k + CHANNELS; ++x)	m[c][x] /= d;
+			for (uint8_t r = 0; r < k; ++r) {
+				if ( r == c )	continue;
+				const float
+				f		= m[r][c];
+				for (uint8_t x = 0; x < k + CHANNELS; ++x)	m[r][x] -= f * m[c][x];
+			}
+		}
+
+		for (uint8_t j = 0; j < MAX_ANALYTES; ++j)
+			for (uint8_t i = 0; i < CHANNELS; ++i)
+				p[j][i]	= 0;
+		for (uint8_t r = 0; r < k; ++r) {
+			for (uint8_t i = 0; i < CHANNELS; ++i) {
+				const float
+				v		= m[r][k + i] * float(fixed::ONE);
+				if ( fabsf(v) >= 2147483520.f )	return false;		// out of Q16.16 range
+				p[col[r]][i]	= static_cast<fixed::q16>(v);
+			}
+		}
+		return true;
+	}
+
+	uint16_t		_counts[CHANNELS];				// latest raw counts
+	uint16_t		_blank[CHANNELS];				// I0 per channel, 0 = not captured
+	fixed::q16		_e[CHANNELS][MAX_ANALYTES];		// absorptivity matrix E
+	fixed::q16		_p[SUBSETS][MAX_ANALYTES][CHANNELS];	// inverses per analyte subset
+	bool			_valid[SUBSETS]	= {};
+	uint8_t			_analytes;
+	uint8_t			_fresh;							// channels updated since last ready()
+	uint8_t			_columns;						// calibrated columns of E
+	bool			_solved;
+
+public:
+	Source			source;							// where R/G/B/C come from
+	bool			enabled;
+};
+// ----------------------------------------------------------------------------
+
+#endif	// UNMIXING_HPP
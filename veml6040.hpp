@@ -24,6 +24,7 @@
 
 #include <modm/ui/color.hpp>
 #include <modm/architecture/interface/i2c_device.hpp>
+#include <shadow.hpp>
 
 namespace modm
 {
@@ -55,6 +56,14 @@ struct veml6040
 	};
 	//! @}
 
+	//! \brief 	Bits of the ENABLE register besides the integration time
+	enum Config : uint8_t
+	{
+		SD					= 0x01,	//!< shut down, keeps the last conversion
+		AF					= 0x02,	//!< force mode, one conversion per TRIG
+		TRIG				= 0x04,	//!< start a conversion in force mode
+	};
+
 
 	//! \brief 	Register addresses
 	enum class RegisterAddress : uint8_t
@@ -110,11 +119,20 @@ public:
 
 	/**
 	 * @name Return already sampled color
+	 *
+	 * Decoded from the buffer of the last complete read, the next read
+	 * goes to the other one (see refreshAllColors()).
 	 * @{
 	 */
-	inline static Veml6040::Rgbw
-	getOldColors()
+	inline Veml6040::Rgbw
+	getOldColors() const
 	{
+		const Data&	data	= buffer[front];
+		Rgbw	color;
+		color.red	= data.red.get();
+		color.green	= data.green.get();
+		color.blue	= data.blue.get();
+		color.white	= data.clear.get();
 		return color;
 	};
 
@@ -124,7 +142,7 @@ public:
 	 * @name Sample and return fresh color values
 	 * @{
 	 */
-	inline static Veml6040::Rgbw
+	inline Veml6040::Rgbw
 	getNewColors()
 	{
 		refreshAllColors();
@@ -134,21 +152,36 @@ public:
 	//!@}
 
 	//! \brief	Read current samples of ADC conversions for all channels.
+	//!
+	//! Into the back buffer, it becomes the front one when all four
+	//! channels are read: a read in progress (or a failed one) leaves the
+	//! last sample intact, getOldColors() can decode it meanwhile.
 	// Non-blocking
 	modm::ResumableResult<bool>
 	refreshAllColors();
 
 	// MARK: - TASKS
+	//! \brief	Power up and start conversions. The content of ENABLE is
+	//!			unknown after a reset, it is written once whatever the shadow says
 	modm::ResumableResult<bool>
 	initialize()
 	{
-				writeRegister(RegisterAddress::ENABLE, 0x21);	// control to power off
+		shadow.lost();
 		return	writeRegister(RegisterAddress::ENABLE, 0x20);	// control to power up and start conversion
 	};
 
 	modm::ResumableResult<bool>
 	configure(const uint8_t int_time    = IntegrationTime::DEFAULT);
 
+	//! \brief 	Shut down (SD) or power up and start conversions again,
+	//!			with the configured integration time
+	modm::ResumableResult<bool>
+	sleep(bool shutdown)
+	{
+		return writeRegister(RegisterAddress::ENABLE,
+				static_cast<uint8_t>(integrationTime) | (shutdown ? SD : 0));
+	}
+
 private:
 	//! \brief Sets the integration time for the ADCs.
 	modm::ResumableResult<bool>
@@ -157,9 +190,27 @@ private:
 		return writeRegister(RegisterAddress::ENABLE, static_cast<uint8_t>(int_time));
 	}
 
+public:
+	//! \brief	Writes to ENABLE issued and skipped (unchanged)
+	const RegisterShadow<1>&
+	writes() const
+	{
+		return shadow;
+	}
+
 private:
 	uint8_t commandBuffer[4];
 	bool success;
+	RegisterShadow<1>	shadow;		//!< ENABLE, the only configuration register
+
+	static constexpr uint8_t	NO_SLOT	= 0xFF;
+
+	//! slot of a register in the shadow, NO_SLOT if it is not shadowed
+	static constexpr uint8_t
+	slot(const RegisterAddress address)
+	{
+		return ( address == RegisterAddress::ENABLE ) ? 0 : NO_SLOT;
+	}
 
 private:
 	//! \brief	Read value of specific register.
@@ -193,7 +244,7 @@ private:
 		inline uint8_t getMSB()	const { return high; }
 	} modm_packed;
 
-	static union Data
+	union Data
 	{
 		uint8_t dataBytes[2*4];
 		struct
@@ -203,9 +254,12 @@ private:
 			uint16_t_LOW_HIGH blue;
             uint16_t_LOW_HIGH clear;
 		} modm_packed;
-	} data;
+	};
 
-	static Rgbw	color;
+	//! double buffer: samples are read into buffer[front ^ 1], a failed or
+	//! unfinished read leaves the last sample in buffer[front]
+	Data	buffer[2];
+	uint8_t	front;
 
 public:
 	IntegrationTime	integrationTime;
@@ -18,17 +18,13 @@
 #	error	"Don't include this file directly, use 'veml6040.hpp' instead!"
 #endif
 
-template<typename I2cMaster>
-typename modm::Veml6040<I2cMaster>::Data modm::Veml6040<I2cMaster>::data;
-
-template<typename I2cMaster>
-typename modm::veml6040::Rgbw modm::Veml6040<I2cMaster>::color;
-
 template < typename I2cMaster >
 modm::Veml6040<I2cMaster>::Veml6040(uint8_t address)
 : I2cDevice<I2cMaster,2>(address),
   commandBuffer{0,0,0,0},
   success(false),
+  buffer{},
+  front(0),
   integrationTime(IntegrationTime::MSEC_320)
 {
 }
@@ -59,28 +55,25 @@ modm::Veml6040<I2cMaster>::refreshAllColors()
         // with the auto-increment mode of the i2c protocol @see Veml6040::readRegisters
 	if ( RF_CALL( readRegisters(
             RegisterAddress::RDATALOW,
-			data.dataBytes,
-			sizeof(data.dataBytes)/4) )		and
+			buffer[front ^ 1].dataBytes,
+			sizeof(Data)/4) )		and
 		 RF_CALL( readRegisters(
 			RegisterAddress::GDATALOW,
-			data.dataBytes + 2,
-			sizeof(data.dataBytes)/4) )		and
+			buffer[front ^ 1].dataBytes + 2,
+			sizeof(Data)/4) )		and
 		 RF_CALL( readRegisters(
 			RegisterAddress::BDATALOW,
-			data.dataBytes + 4,
-			sizeof(data.dataBytes)/4) )		and
+			buffer[front ^ 1].dataBytes + 4,
+			sizeof(Data)/4) )		and
 		 RF_CALL( readRegisters(
 			RegisterAddress::CDATALOW,
-			data.dataBytes + 6,
-			sizeof(data.dataBytes)/4) )
+			buffer[front ^ 1].dataBytes + 6,
+			sizeof(Data)/4) )
 	)
 	{
-		// adapt the values to the overall light intensity
-		// so that R + G + B = C
-		color.red	= data.red.get();
-		color.green	= data.green.get();
-		color.blue	= data.blue.get();
-		color.white	= data.clear.get();
+		// complete: the new sample is the front buffer, decoding
+		// (getOldColors) is left to the consumer
+		front	^= 1;
 
 		{
 			// START --> This part is not really necessary
@@ -114,14 +107,27 @@ modm::Veml6040<I2cMaster>::writeRegister(
 		const RegisterAddress address,
 		const uint8_t value)
 {
+	static_assert(slot(RegisterAddress::ENABLE) < 1, "the shadow holds ENABLE only");
+
 	RF_BEGIN();
 
+	// the register holds the value already
+	if ( slot(address) != NO_SLOT && !shadow.needed(slot(address), value) ) {
+		RF_RETURN(true);
+	}
+
 	commandBuffer[0] = static_cast<uint8_t>(address);	// at this address
 	commandBuffer[1] = value;
 
 	this->transaction.configureWrite(commandBuffer, 3);
 
-	RF_END_RETURN_CALL( this->runTransaction() );
+	if ( RF_CALL( this->runTransaction() ) ) {
+		if ( slot(address) != NO_SLOT )	shadow.written(slot(address), value);
+		RF_RETURN(true);
+	}
+	if ( slot(address) != NO_SLOT )	shadow.lost(slot(address));
+
+	RF_END_RETURN(false);
 }
 
 template<typename I2cMaster>
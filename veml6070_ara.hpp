@@ -0,0 +1,56 @@
+// ----------------------------------------------------------------------------
+
+#ifndef VEML6070_ARA_HPP
+#define VEML6070_ARA_HPP
+
+#include <stdint.h>
+
+#include <modm/architecture/interface/i2c_device.hpp>
+
+namespace modm
+{
+/**
+ * \brief	SMBus Alert Response Address of the VEML6070 ACK feature
+ *
+ * With ACK enabled in the command register (bit 5, threshold 102 or
+ * 145 steps in bit 4) the sensor raises ACK when UV exceeds the
+ * threshold. Reading the ARA (0x0C) returns the sensor address and
+ * clears ACK, without ACK pending the read is not acknowledged.
+ * So one single-byte read tells whether the UV data are worth reading.
+ *
+ * \tparam	I2CMaster	I2C interface which needs an \em initialized
+ * 						modm::i2c::Master
+ */
+template < typename I2cMaster >
+class Veml6070Ara : public modm::I2cDevice< I2cMaster, 1 >
+{
+public:
+	enum : uint8_t
+	{
+		ADDRESS		= 0x0C,
+		ACK			= 0x20,	//!< command register: enable ACK
+		ACK_THD_145	= 0x10,	//!< command register: threshold 145 steps (else 102)
+	};
+
+	Veml6070Ara()
+	: I2cDevice<I2cMaster,1>(ADDRESS), response(0)
+	{
+	}
+
+	//! \brief	true if the VEML6070 had ACK pending (now cleared)
+	modm::ResumableResult<bool>
+	read()
+	{
+		RF_BEGIN();
+
+		this->transaction.configureRead(&response, 1);
+
+		RF_END_RETURN_CALL( this->runTransaction() );
+	}
+
+private:
+	uint8_t response;
+};
+}
+
+#endif // VEML6070_ARA_HPP